@@ -0,0 +1,218 @@
+#include "AdcCapture.h"
+
+AdcCapture capture;
+
+static uint16_t crc16(const uint8_t *data, size_t length)      //CRC-16/CCITT-FALSE, as the settings blob
+{
+    uint16_t crc = 0xFFFF;
+    for(size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for(byte b = 0; b < 8; b++) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+AdcCapture::AdcCapture()
+{
+    for(byte i = 0; i < 2; i++) {
+        this->_frames[i].length = 0;
+        this->_frames[i].sent = 0;
+    }
+}
+
+void AdcCapture::begin(AdsAutoRange &adc, Print &out)
+{
+    this->_adc = &adc;
+    this->_out = &out;
+}
+
+bool AdcCapture::start(unsigned long durationMs)
+{
+    if(this->_active || this->_adc == NULL) {
+        return false;
+    }
+    uint16_t sps = this->_adc->samplesPerSecond();
+    this->_autoRange = this->_adc->autoRange();
+    this->_adc->setAutoRange(false);        //one range for the whole stream, the host scales by it
+    this->_out->print(F("CAPTURE START "));
+    this->_out->print(sps);
+    this->_out->print(' ');
+    this->_out->print(this->_adc->range());
+    this->_out->print(' ');
+    this->_out->println(this->_adc->lsbMillivolts() * 1000, 4);    //uV per count
+    this->_out->flush();
+    this->_periodUs = 1000000UL / sps;
+    this->_durationMs = durationMs;
+    this->_next = 0;
+    this->_samples = 0;
+    this->_missed = 0;
+    this->_dropped = 0;
+    this->_count = 0;
+    this->_filling = 0;
+    for(byte i = 0; i < 2; i++) {
+        this->_frames[i].length = 0;
+        this->_frames[i].sent = 0;
+    }
+    this->_startedAt = micros();
+    this->_active = true;
+    return true;
+}
+
+void AdcCapture::stop()
+{
+    if(!this->_active) {
+        return;
+    }
+    while(!drain()) {}                      //a frame or two at the end, not worth dropping
+    finish();
+    while(!drain()) {}
+    Frame &end = this->_frames[this->_filling];
+    end.length = 0;
+    end.sent = 0;
+    put(CAPTURE_FRAME_END);
+    put32(this->_samples);
+    put32(this->_missed);
+    put32(this->_dropped);
+    this->_count = 1;
+    finish();
+    while(!drain()) {}
+    this->_out->println();
+    this->_out->println(F("CAPTURE END"));
+    this->_adc->setAutoRange(this->_autoRange);
+    this->_active = false;
+}
+
+bool AdcCapture::active() const
+{
+    return this->_active;
+}
+
+void AdcCapture::service()
+{
+    if(!this->_active) {
+        return;
+    }
+    unsigned long elapsed = micros() - this->_startedAt;
+    uint32_t due = elapsed / this->_periodUs;               //conversions completed since the start
+    if(due > this->_next) {
+        if(due > this->_next + 1) {
+            this->_missed += due - this->_next - 1;         //the loop was away longer than a period
+        }
+        add(due - 1, this->_adc->readRaw());
+        this->_next = due;
+    }
+    drain();
+    if(elapsed / 1000 >= this->_durationMs) {
+        stop();
+    }
+}
+
+void AdcCapture::add(uint32_t index, int16_t sample)
+{
+    if(this->_count > 0 && index != this->_next) {
+        finish();                           //a gap, the next frame restarts the index
+    }
+    if(this->_count == 0) {
+        open(index);
+        put16(sample);
+    } else {
+        int32_t delta = (int32_t)sample - this->_last;
+        if(delta > -128 && delta < 128) {
+            put((uint8_t)(int8_t)delta);
+        } else {
+            put(0x80);
+            put16(sample);
+        }
+    }
+    this->_last = sample;
+    this->_samples++;
+    this->_count++;
+    this->_frames[this->_filling].data[1 + 6] = this->_count;
+    if(this->_count == CAPTURE_FRAME_SAMPLES) {
+        finish();
+    }
+}
+
+void AdcCapture::open(uint32_t index)
+{
+    Frame &frame = this->_frames[this->_filling];
+    frame.length = 0;
+    frame.sent = 0;
+    put(CAPTURE_FRAME_DATA);
+    put32(index);
+    put(this->_adc->range());
+    put(0);                                 //count, updated as samples come in
+}
+
+void AdcCapture::finish()
+{
+    if(this->_count == 0) {
+        return;
+    }
+    this->_count = 0;
+    Frame &frame = this->_frames[this->_filling];
+    put16(crc16(frame.data + 1, frame.length));
+    //COBS in place: the payload is shorter than 254 bytes, so every zero is
+    //replaced by the distance to the next one and data[0] points at the first
+    uint8_t *p = frame.data;
+    uint8_t n = frame.length + 1;
+    uint8_t last = 0;
+    for(uint8_t i = 1; i < n; i++) {
+        if(p[i] == 0) {
+            p[last] = i - last;
+            last = i;
+        }
+    }
+    p[last] = n - last;
+    p[n] = 0;
+    frame.length = n + 1;
+    frame.sent = 0;
+
+    Frame &other = this->_frames[this->_filling ^ 1];
+    if(other.sent < other.length) {         //the previous frame is still going out
+        this->_dropped++;
+        frame.length = 0;
+        frame.sent = 0;
+        return;
+    }
+    this->_filling ^= 1;
+    Frame &next = this->_frames[this->_filling];
+    next.length = 0;
+    next.sent = 0;
+}
+
+bool AdcCapture::drain()
+{
+    Frame &frame = this->_frames[this->_filling ^ 1];
+    if(frame.sent >= frame.length) {
+        return true;
+    }
+    int room = this->_out->availableForWrite();
+    if(room <= 0) {
+        return false;
+    }
+    size_t n = min((size_t)room, (size_t)(frame.length - frame.sent));
+    this->_out->write(frame.data + frame.sent, n);
+    frame.sent += n;
+    return frame.sent >= frame.length;
+}
+
+void AdcCapture::put(uint8_t value)
+{
+    Frame &frame = this->_frames[this->_filling];
+    frame.data[1 + frame.length++] = value;
+}
+
+void AdcCapture::put16(uint16_t value)
+{
+    put(value & 0xFF);
+    put(value >> 8);
+}
+
+void AdcCapture::put32(uint32_t value)
+{
+    put16(value & 0xFFFF);
+    put16(value >> 16);
+}
@@ -0,0 +1,70 @@
+#ifndef _ADCCAPTURE_H_
+#define _ADCCAPTURE_H_
+
+#include <Arduino.h>
+#include "AdsAutoRange.h"
+
+#define CAPTURE_FRAME_SAMPLES 32    //conversions per frame
+#define CAPTURE_MAX_PAYLOAD (1 + 4 + 1 + 1 + 2 + (CAPTURE_FRAME_SAMPLES - 1) * 3 + 2)
+#define CAPTURE_FRAME_SIZE (CAPTURE_MAX_PAYLOAD + 2)    //COBS code byte and the 0x00 delimiter
+
+#define CAPTURE_FRAME_DATA 0x01
+#define CAPTURE_FRAME_END 0x02
+
+//Streams raw ADS1115 conversions at the full data rate over serial, for
+//probe and noise studies with tools/capture.py. Every frame is COBS encoded
+//and ends with 0x00:
+//  data: type 0x01, u32 index of the first sample, u8 range, u8 count,
+//        i16 first sample, then per sample an i8 delta, or 0x80 and the i16
+//        sample when the delta does not fit, CRC-16/CCITT
+//  end:  type 0x02, u32 samples read, u32 samples missed, u32 frames dropped, CRC
+//Little-endian. The index counts conversion periods since the start, so a gap
+//shows samples the loop missed. A frame that does not fit the serial buffer
+//is dropped whole, which the host sees as a gap too.
+class AdcCapture
+{
+public:
+    AdcCapture();
+
+    void begin(AdsAutoRange &adc, Print &out);
+    bool start(unsigned long durationMs);   //false when already running, the text header is printed first
+    void stop();                            //flush, send the end frame
+    bool active() const;
+    void service();                         //every loop, reads every conversion that has completed since the last call
+
+private:
+    struct Frame
+    {
+        uint8_t data[CAPTURE_FRAME_SIZE];   //data[0] is kept for the COBS code byte
+        uint8_t length;                     //payload bytes from data[1], then the encoded length
+        uint8_t sent;                       //encoded bytes already written, length when free
+    };
+
+    void add(uint32_t index, int16_t sample);
+    void open(uint32_t index);              //start a data frame with this sample index
+    void finish();                          //CRC, encode in place and queue the filling frame
+    bool drain();                           //write what the serial port takes, true when nothing is pending
+    void put(uint8_t value);
+    void put16(uint16_t value);
+    void put32(uint32_t value);
+
+    AdsAutoRange *_adc = NULL;
+    Print *_out = NULL;
+    bool _active = false;
+    bool _autoRange = true;
+    unsigned long _startedAt = 0;           //micros()
+    unsigned long _durationMs = 0;
+    unsigned long _periodUs = 0;
+    uint32_t _next = 0;                     //index of the next conversion to read
+    uint32_t _samples = 0;
+    uint32_t _missed = 0;
+    uint32_t _dropped = 0;
+    Frame _frames[2];                       //one filling while the other is written out
+    byte _filling = 0;
+    byte _count = 0;                        //samples in the filling frame
+    int16_t _last = 0;
+};
+
+extern AdcCapture capture;
+
+#endif
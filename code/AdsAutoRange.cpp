@@ -0,0 +1,133 @@
+#include "AdsAutoRange.h"
+#include "I2cBus.h"
+
+static const adsGain_t RANGE_GAIN[ADS_RANGE_COUNT] = {
+    GAIN_TWOTHIRDS, GAIN_ONE, GAIN_TWO, GAIN_FOUR, GAIN_EIGHT, GAIN_SIXTEEN
+};
+static const float RANGE_FULL_SCALE[ADS_RANGE_COUNT] = {   //mV
+    6144.0, 4096.0, 2048.0, 1024.0, 512.0, 256.0
+};
+
+AdsAutoRange::AdsAutoRange(Adafruit_ADS1115 &ads) : _ads(ads)
+{
+}
+
+bool AdsAutoRange::begin(uint16_t dataRate, uint16_t mux)
+{
+    this->_mux = mux;
+    this->_dataRate = dataRate;
+    if(!this->_ads.begin()) {
+        return false;
+    }
+    this->_ads.setDataRate(this->_dataRate);
+    applyRange(0);                      //the first conversion runs while the rest of setup() does
+    return true;
+}
+
+float AdsAutoRange::readMillivolts()
+{
+    waitConversion();
+    int16_t adc0 = readConversion();
+    while(this->_autoRange && this->_range > 0 && (adc0 >= 32767 || adc0 <= -32768)) {
+        applyRange(this->_range - 1);   //clipped, the reading is not usable on this range
+        waitConversion();
+        adc0 = readConversion();
+    }
+    float mv = adc0 * lsbMillivolts();
+    if(this->_autoRange) {
+        byte next = pickRange(mv);
+        if(next != this->_range) {
+            applyRange(next);           //takes effect from the next conversion on
+        }
+    }
+    return mv;
+}
+
+void AdsAutoRange::setDataRate(uint16_t dataRate)
+{
+    this->_dataRate = dataRate;
+    this->_ads.setDataRate(dataRate);
+    applyRange(this->_range);
+}
+
+void AdsAutoRange::setAutoRange(bool enable)
+{
+    this->_autoRange = enable;
+}
+
+bool AdsAutoRange::autoRange() const
+{
+    return this->_autoRange;
+}
+
+byte AdsAutoRange::range() const
+{
+    return this->_range;
+}
+
+float AdsAutoRange::lsbMillivolts() const
+{
+    return RANGE_FULL_SCALE[this->_range] / 32768.0;
+}
+
+float AdsAutoRange::fullScaleMillivolts() const
+{
+    return RANGE_FULL_SCALE[this->_range];
+}
+
+void AdsAutoRange::applyRange(byte range)
+{
+    this->_range = range;
+    this->_ads.setGain(RANGE_GAIN[range]);
+    i2cBus.acquire(BUS_ADC);
+    this->_ads.startADCReading(this->_mux, true);   //gain is only latched when the config register is rewritten
+    i2cBus.release(BUS_ADC);
+    this->_rangedAt = millis();
+}
+
+int16_t AdsAutoRange::readConversion()
+{
+    i2cBus.acquire(BUS_ADC);
+    int16_t value = this->_ads.getLastConversionResults();
+    i2cBus.release(BUS_ADC);
+    return value;
+}
+
+byte AdsAutoRange::pickRange(float millivolts) const
+{
+    float level = fabs(millivolts);
+    byte narrowest = 0;
+    for(byte r = 1; r < ADS_RANGE_COUNT; r++) {
+        if(level < RANGE_FULL_SCALE[r] * ADS_RANGE_LOWER) {
+            narrowest = r;
+        }
+    }
+    if(narrowest > this->_range) {
+        return narrowest;
+    }
+    if(level > RANGE_FULL_SCALE[this->_range] * ADS_RANGE_UPPER) {
+        return narrowest;
+    }
+    return this->_range;
+}
+
+uint16_t AdsAutoRange::samplesPerSecond() const
+{
+    static const uint16_t SPS[8] = {8, 16, 32, 64, 128, 250, 475, 860};
+    return SPS[(this->_dataRate >> 5) & 0x07];
+}
+
+int16_t AdsAutoRange::readRaw()
+{
+    return readConversion();
+}
+
+void AdsAutoRange::waitConversion() const
+{
+    uint16_t sps = samplesPerSecond();
+    unsigned long elapsed = millis() - this->_rangedAt;
+    unsigned long needed = 1000 / sps + 2;
+    if(elapsed < needed) {              //only right after a range change, loop readings are far apart
+        delay(needed - elapsed);
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef _ADSAUTORANGE_H_
+#define _ADSAUTORANGE_H_
+
+#include <Arduino.h>
+#include <Adafruit_ADS1X15.h>
+#include "PhAdc.h"
+
+#define ADS_RANGE_COUNT 6       //PGA ranges from +-6.144V down to +-0.256V
+#define ADS_RANGE_UPPER 0.90    //widen the range when the signal passes 90% of full scale
+#define ADS_RANGE_LOWER 0.75    //narrow the range only when the signal fits in 75% of the narrower full scale
+
+class AdsAutoRange : public PhAdc
+{
+public:
+    AdsAutoRange(Adafruit_ADS1115 &ads);
+
+    bool begin(uint16_t dataRate = RATE_ADS1115_128SPS, uint16_t mux = ADS1X15_REG_CONFIG_MUX_SINGLE_0);
+                                            //start continuous conversions on the widest range, does not wait for the first
+    float readMillivolts() override;        //last conversion in mV. Picks the PGA range for the following conversions,
+                                            //a clipped result is re-converted on a wider range before it is returned
+    void setDataRate(uint16_t dataRate);    //RATE_ADS1115_8SPS (lowest noise) to RATE_ADS1115_860SPS (fastest)
+    void setAutoRange(bool enable);         //false keeps the current range
+    bool autoRange() const;
+    byte range() const;                     //0 = +-6.144V ... 5 = +-0.256V
+    float lsbMillivolts() const;            //mV per count of the current range
+    float fullScaleMillivolts() const;
+    uint16_t samplesPerSecond() const;
+    int16_t readRaw();                      //last conversion in counts, no range change, for AdcCapture
+
+private:
+    void applyRange(byte range);
+    byte pickRange(float millivolts) const;
+    void waitConversion() const;            //until a conversion on the current range has completed
+    int16_t readConversion();
+
+    Adafruit_ADS1115 &_ads;
+    uint16_t _mux = ADS1X15_REG_CONFIG_MUX_SINGLE_0;
+    uint16_t _dataRate = RATE_ADS1115_128SPS;
+    byte _range = 0;
+    bool _autoRange = true;
+    unsigned long _rangedAt = 0;            //millis() the config register was last written
+};
+
+#endif
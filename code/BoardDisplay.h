@@ -0,0 +1,100 @@
+#ifndef _BOARDDISPLAY_H_
+#define _BOARDDISPLAY_H_
+
+#include <Adafruit_GFX.h>
+#include <Adafruit_SSD1306.h>
+#include "BoardProfile.h"
+#include "I2cBus.h"
+
+#define DISPLAY_CHUNK 31     //data bytes per I2C write, with the control byte this fits the 32 byte Wire buffer of small cores
+
+//SSD1306 sized and addressed by the board profile. display() only marks the
+//frame dirty, service() sends one page of it per call, so the ADC never
+//waits behind a whole frame on the shared bus, and none at all when it has
+//told i2cBus a reading is due before the page would be sent.
+template <class Profile, bool Fitted = Profile::hasOled>
+class BoardDisplay : public Adafruit_SSD1306
+{
+public:
+    BoardDisplay() : Adafruit_SSD1306(Profile::screenWidth, Profile::screenHeight, &Wire, Profile::oledReset,
+                                      Profile::i2cClock, Profile::i2cClock) {}
+    bool begin() { return Adafruit_SSD1306::begin(SSD1306_SWITCHCAPVCC, Profile::oledAddress); }
+
+    void display() { this->_dirtyPages = (1 << PAGES) - 1; }
+
+    bool service()              //send the next dirty page, true while more are left
+    {
+        if(this->_dirtyPages == 0 || !i2cBus.mayStart(BUS_DISPLAY, PAGE_MICROS)) {
+            return this->_dirtyPages != 0;
+        }
+        for(uint8_t page = 0; page < PAGES; page++) {
+            if(this->_dirtyPages & (1 << page)) {
+                sendPage(page);
+                this->_dirtyPages &= ~(1 << page);
+                break;
+            }
+        }
+        return this->_dirtyPages != 0;
+    }
+
+    void flush()                //the whole frame now, for screens held with a delay()
+    {
+        for(uint8_t page = 0; page < PAGES; page++) {
+            sendPage(page);
+        }
+        this->_dirtyPages = 0;
+    }
+
+private:
+    static constexpr uint8_t PAGES = Profile::screenHeight / 8;
+    //9 clocks a byte: the page and column commands, the data, a control and an address byte per chunk
+    static constexpr uint32_t PAGE_MICROS = (8UL + Profile::screenWidth + 4UL * ((Profile::screenWidth + DISPLAY_CHUNK - 1) / DISPLAY_CHUNK))
+                                            * 9 * 1000000UL / Profile::i2cClock;
+
+    void sendPage(uint8_t page)
+    {
+        const uint8_t *data = getBuffer() + page * Profile::screenWidth;
+        i2cBus.acquire(BUS_DISPLAY);
+        Wire.beginTransmission(Profile::oledAddress);
+        Wire.write((uint8_t)0x00);              //command stream
+        Wire.write((uint8_t)SSD1306_PAGEADDR);
+        Wire.write(page);
+        Wire.write(page);
+        Wire.write((uint8_t)SSD1306_COLUMNADDR);
+        Wire.write((uint8_t)0);
+        Wire.write((uint8_t)(Profile::screenWidth - 1));
+        Wire.endTransmission();
+        for(uint8_t x = 0; x < Profile::screenWidth; x += DISPLAY_CHUNK) {
+            uint8_t n = min((int)DISPLAY_CHUNK, Profile::screenWidth - x);
+            Wire.beginTransmission(Profile::oledAddress);
+            Wire.write((uint8_t)0x40);          //data stream
+            Wire.write(data + x, n);
+            Wire.endTransmission();
+        }
+        i2cBus.release(BUS_DISPLAY);
+    }
+
+    uint8_t _dirtyPages = 0;
+};
+
+//no OLED fitted, every call is an empty inline and nothing refers to the SSD1306 driver
+template <class Profile>
+class BoardDisplay<Profile, false>
+{
+public:
+    bool begin() { return false; }
+    void clearDisplay() {}
+    void display() {}
+    bool service() { return false; }
+    void flush() {}
+    uint8_t *getBuffer() { return NULL; }
+    void setTextSize(uint8_t) {}
+    void setTextColor(uint16_t) {}
+    void setCursor(int16_t, int16_t) {}
+    void drawPixel(int16_t, int16_t, uint16_t) {}
+    void drawFastVLine(int16_t, int16_t, int16_t, uint16_t) {}
+    template <typename... Args> size_t print(Args...) { return 0; }
+    template <typename... Args> size_t println(Args...) { return 0; }
+};
+
+#endif
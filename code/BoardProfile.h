@@ -0,0 +1,71 @@
+#ifndef _BOARDPROFILE_H_
+#define _BOARDPROFILE_H_
+
+#include <Arduino.h>
+
+/*
+ * Board profiles. Every module takes its pins, sensor limits and fitted
+ * subsystems from the selected profile. Code for a subsystem a board does
+ * not have sits behind a constexpr flag or an empty BoardDisplay, so it is
+ * never called; how much flash and RAM that saves has not been measured,
+ * tools/build.py --sizes prints it per profile.
+ *
+ *   BoardRevA - ADS1115, OLED and serial menu commands (the original PCB, PCB/)
+ *   BoardRevB - headless, ADS1115 only, configured over buttons or Modbus
+ *   BoardRevC - low cost, ESP32 internal ADC instead of the ADS1115
+ *
+ * Only RevA has a layout in this repository. RevB and RevC use its pins
+ * until theirs are captured, override them in the profile then.
+ */
+#ifndef BOARD_PROFILE
+#define BOARD_PROFILE BoardRevA
+#endif
+
+struct BoardRevA
+{
+    //pins
+    static constexpr uint8_t oneWireBus = 4;
+    static constexpr uint8_t phPin = 34;
+    static constexpr uint8_t upPin = 19;
+    static constexpr uint8_t setPin = 5;
+    static constexpr uint8_t downPin = 18;
+    static constexpr uint8_t pumpPin = 16;
+    static constexpr uint8_t modbusRxPin = 25;
+    static constexpr uint8_t modbusTxPin = 26;
+    static constexpr int8_t modbusDePin = -1;   //RS485 driver enable, -1 for transceivers with automatic direction
+
+    //fitted subsystems
+    static constexpr bool hasOled = true;
+    static constexpr bool hasAds1115 = true;
+    static constexpr bool hasInternalAdc = false;
+    static constexpr bool hasSerialCalibration = true;
+
+    //display
+    static constexpr uint8_t screenWidth = 128;
+    static constexpr uint8_t screenHeight = 64;
+    static constexpr uint8_t oledAddress = 0x3C;
+    static constexpr int8_t oledReset = -1;     //-1 if sharing the board reset
+    static constexpr uint32_t i2cClock = 400000;    //fast mode, the fastest the SSD1306 is specified for
+
+    //probe voltage bands recognised as buffer solutions during calibration, mV
+    static constexpr float ph7Low = 1322;
+    static constexpr float ph7High = 1678;
+    static constexpr float ph4Low = 1854;
+    static constexpr float ph4High = 2210;
+};
+
+struct BoardRevB : BoardRevA        //pins as RevA
+{
+    static constexpr bool hasOled = false;
+    static constexpr bool hasSerialCalibration = false;
+};
+
+struct BoardRevC : BoardRevA        //pins as RevA, phPin 34 is on ADC1 so it reads with WiFi on
+{
+    static constexpr bool hasAds1115 = false;
+    static constexpr bool hasInternalAdc = true;
+};
+
+typedef BOARD_PROFILE Board;
+
+#endif
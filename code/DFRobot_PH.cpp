@@ -19,79 +19,68 @@
 
 #include "GravityPump.h"
 #include "DFRobot_PH.h"
-#include <EEPROM.h>
-#include <Adafruit_GFX.h>
-#include <Adafruit_SSD1306.h>
+#include "BoardProfile.h"
+#include "BoardDisplay.h"
+#include "HeapMonitor.h"
+#include "AdcCapture.h"
+#include "Stats.h"
+#include "ScreenMirror.h"
+#include "Trace.h"
+#include <strings.h>
 
-#define SCREEN_WIDTH 128    // OLED display width, in pixels
-#define SCREEN_HEIGHT 64    // OLED display height, in pixels
-#define OLED_RESET -1       // Reset pin # (or -1 if sharing Arduino reset pin)
-Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
-
-#define PH_8_VOLTAGE 1122
-#define PH_6_VOLTAGE 1478
-#define PH_5_VOLTAGE 1654
-#define PH_3_VOLTAGE 2010
-
-//#define EEPROM_write(address, p) {int i = 0; byte *pp = (byte*)&(p);for(; i < sizeof(p); i++) EEPROM.write(address+i, pp[i]);}
-//#define EEPROM_read(address, p)  {int i = 0; byte *pp = (byte*)&(p);for(; i < sizeof(p); i++) pp[i]=EEPROM.read(address+i);}
-
-template <typename T>
-void EEPROM_read(int address, T &p) {
-    byte *pp = (byte*)&p;
-    for (int i = 0; i < sizeof(p); i++) {
-        pp[i] = EEPROM.read(address + i);
-    }
-}
+#if __has_include("ScreenTemplates.h")
+#include "ScreenTemplates.h"       //generated by tools/render_screens.py, tools/build.py runs it
+#define SCREEN_TEMPLATES 1
+#define SCREEN(name) SCREEN_TEMPLATE_##name
+#else
+#warning "ScreenTemplates.h missing, build with tools/build.py to blit the static screens"
+#define SCREEN_TEMPLATES 0
+#define SCREEN(name) -1             //no templates, every screen is rasterized
+#endif
 
-template <typename T>
-void EEPROM_write(int address, const T &p) {
-    const byte *pp = (const byte*)&p;
-    for (int i = 0; i < sizeof(p); i++) {
-        EEPROM.write(address + i, pp[i]);
-    }
-    EEPROM.commit(); // Ensure changes are saved
-}
+BoardDisplay<Board> display;
 
-#define PHVALUEADDR 0x00    //the start address of the pH calibration parameters stored in the EEPROM
-#define FLOWRATEADDRESS 0x24    //EEPROM address for flowrate, for more pump need to add more address. 
-#define PUMPSPEEDADDRESS 0x28   //EEPROM address for speed, for more pump need to add more address.
 #define CALIBRATIONTIME 15      //when Calibration pump running time, unit secend
 
 
 char* DFRobot_PH::strupr(char* str) {
     if (str == NULL) return NULL;
     char *ptr = str;
-    while (*ptr != ' ') {
+    while (*ptr != ' ' && *ptr != '\0') {     //only the command word, arguments keep their case
         *ptr = toupper((unsigned char)*ptr);
         ptr++;
     }
     return str;
 }
 
-boolean phCalibrationFinish  = 0;
-boolean enterCalibrationFlag = 0;
-char buffer[10];
+static const char MENU_FLOW_RATE[] PROGMEM = "Flow Rate";
+static const char MENU_AMOUNT[]    PROGMEM = "Amount";
+static const char MENU_WAIT[]      PROGMEM = "Wait time";
+static const char MENU_CALIBRATE[] PROGMEM = "Calibrate";
+static const char MENU_TEST[]      PROGMEM = "Test 2 ml";
+static const char MENU_BUFFER[]    PROGMEM = "Buffer";
+static const char MENU_DIAG[]      PROGMEM = "Diagnostics";
+static const char MENU_TREND[]     PROGMEM = "Trend";
+static const char* const MENU_ITEMS[] PROGMEM = {
+    MENU_FLOW_RATE, MENU_AMOUNT, MENU_WAIT, MENU_CALIBRATE, MENU_TEST, MENU_BUFFER, MENU_DIAG, MENU_TREND
+};
+#define MENU_ITEM_COUNT (sizeof(MENU_ITEMS) / sizeof(MENU_ITEMS[0]))
+#define MENU_ROWS 6         //rows that fit under the title
 
-uint8_t col[2]; // Columns for ADC values.
-uint8_t rows;   // Rows per line.
-bool clearDisplay = true;
 
 DFRobot_PH::DFRobot_PH()
 {
     this->_temperature    = 25.0;
     this->_phValue        = 7.0;
-    this->_acidVoltage    = 2032.44;    //buffer solution 4.0 at 25C
-    this->_neutralVoltage = 1500.0;     //buffer solution 7.0 at 25C
     this->_voltage        = 1500.0;
-    this->_targetPh       = 6.3;
-    this->_isF            = 0.0;
-    this->_flowRate       = 0.6;
-    this->_pumpSpeed      = 160;
-    this->_pumpAmount     = 1.0;
-    this->_pumpWait       = 60.0;
-    this->_flowMl         = 6.0;
-    this->_phBuff         = 0.1;
+    this->_isDosing       = false;
+    this->_uncertainty    = NAN;
+    this->_settings       = NULL;
+    this->_doseModel      = NULL;
+    this->_trendLog       = NULL;
+    this->_pump           = NULL;
+    this->_calibrationFinish    = 0;
+    this->_enterCalibrationFlag = 0;
 }
 
 DFRobot_PH::~DFRobot_PH()
@@ -99,101 +88,139 @@ DFRobot_PH::~DFRobot_PH()
 
 }
 
-void DFRobot_PH::begin()
+void DFRobot_PH::begin(Settings &settings)
 {
-    
-    display.begin(SSD1306_SWITCHCAPVCC, 0x3C);
-    delay(500);
-    display.clearDisplay();
-    display.setCursor(25, 15);
-    display.setTextSize(1);
+    this->_settings = &settings;
+    this->_edit = settings.get();
+    display.begin();
     display.setTextColor(WHITE);
-    display.println(F(" pH Controller"));
-    display.setCursor(25, 35);
-    display.setTextSize(1);
-    display.print(F("Initializing"));
-    display.display();
-    EEPROM.begin(512);
-    EEPROM_read(PHVALUEADDR, this->_neutralVoltage);  //load the neutral (pH = 7.0)voltage of the pH board from the EEPROM
-    if((EEPROM.read(PHVALUEADDR)==0xFF && EEPROM.read(PHVALUEADDR+1)==0xFF && EEPROM.read(PHVALUEADDR+2)==0xFF && EEPROM.read(PHVALUEADDR+3)==0xFF) || isnan(this->_neutralVoltage)){
-        this->_neutralVoltage = 1500.0;  // new EEPROM, write typical voltage
-        EEPROM_write(PHVALUEADDR, this->_neutralVoltage);
-    }
-    EEPROM_read(PHVALUEADDR+4, this->_acidVoltage);//load the acid (pH = 4.0) voltage of the pH board from the EEPROM
-    ////Serial.print("_acidVoltage:");
-    ////Serial.println(this->_acidVoltage);
-    if((EEPROM.read(PHVALUEADDR+4)==0xFF && EEPROM.read(PHVALUEADDR+5)==0xFF && EEPROM.read(PHVALUEADDR+6)==0xFF && EEPROM.read(PHVALUEADDR+7)==0xFF) || isnan(this->_acidVoltage)){
-        this->_acidVoltage = 2032.44;  // new EEPROM, write typical voltage
-        EEPROM_write(PHVALUEADDR+4, this->_acidVoltage);
+    display.clearDisplay();
+    if(!showTemplate(SCREEN(SPLASH))) {
+        display.setCursor(25, 15);
+        display.setTextSize(1);
+        display.println(F(" pH Controller"));
+        display.setCursor(25, 35);
+        display.setTextSize(1);
+        display.print(F("Initializing"));
     }
+    display.flush();
+} 
 
-    //Serial.println(this->_neutralVoltage);
-    //Serial.println(this->_acidVoltage);
-
-    EEPROM_read(PHVALUEADDR+8, this->_targetPh);//load the acid (pH = 4.0) voltage of the pH board from the EEPROM
-    ////Serial.print("_acidVoltage:");
-    ////Serial.println(this->_acidVoltage);
-    if((EEPROM.read(PHVALUEADDR+8)==0xFF && EEPROM.read(PHVALUEADDR+9)==0xFF && EEPROM.read(PHVALUEADDR+10)==0xFF && EEPROM.read(PHVALUEADDR+11)==0xFF) || isnan(this->_targetPh)){
-        this->_targetPh = 6.3;  // new EEPROM, write typical voltage
-        EEPROM_write(PHVALUEADDR+8, this->_targetPh);
-    }
+void DFRobot_PH::setDoseModel(DoseModel &model)
+{
+    this->_doseModel = &model;
+}
 
-    EEPROM_read(PHVALUEADDR+12, this->_isF);//load the acid (pH = 4.0) voltage of the pH board from the EEPROM
-    ////Serial.print("_acidVoltage:");
-    ////Serial.println(this->_acidVoltage);
-    if(EEPROM.read(PHVALUEADDR+12)==0xFF  || isnan(this->_isF)){
-        this->_isF = 0.0;  // new EEPROM, write typical voltage
-        EEPROM_write(PHVALUEADDR+12, this->_isF);
-    }
+void DFRobot_PH::setPump(GravityPump &pump)
+{
+    this->_pump = &pump;
+}
 
-    EEPROM_read(PHVALUEADDR+16, this->_pumpAmount);//load the acid (pH = 4.0) voltage of the pH board from the EEPROM
-    ////Serial.println(this->_acidVoltage);
-    if(EEPROM.read(PHVALUEADDR+16)==0xFF  || isnan(this->_pumpAmount)){
-        this->_pumpAmount = 1.0;  // new EEPROM, write typical voltage
-        EEPROM_write(PHVALUEADDR+16, this->_pumpAmount);
-    }
+bool DFRobot_PH::serviceDisplay()
+{
+    mirror.service(display.getBuffer());    //NULL without an OLED
+    return display.service();
+}
 
+void DFRobot_PH::setTrendLog(TrendLog &trend)
+{
+    this->_trendLog = &trend;
+}
 
-    EEPROM_read(PHVALUEADDR+20, this->_pumpWait);//load the acid (pH = 4.0) voltage of the pH board from the EEPROM
-    ////Serial.println(this->_acidVoltage);
-    if(EEPROM.read(PHVALUEADDR+20)==0xFF || isnan(this->_pumpWait)){
-        this->_pumpWait = 60.0;  // new EEPROM, write typical voltage
-        EEPROM_write(PHVALUEADDR+20, this->_pumpWait);
+void DFRobot_PH::drawPumpMenu(byte selected)
+{
+    this->_enterCalibrationFlag = 1;
+    display.clearDisplay();
+    if(showTemplate(SCREEN(MENU_0) + selected)) {     //one template per selection, in MENU_ITEMS order
+        display.display();
+        return;
     }
+    display.setTextSize(1);
+    display.setCursor(0, 5);
+    display.println(F("Pump Settings"));
+    display.setCursor(0, 15);
+    byte first = selected < MENU_ROWS ? 0 : selected - MENU_ROWS + 1;   //scroll so the selection stays visible
+    for(byte i = first; i < first + MENU_ROWS && i < MENU_ITEM_COUNT; i++) {
+        if(i == selected) {
+            display.print(F("> "));
+        } else {
+            display.print(F("  "));
+        }
+        display.println((const __FlashStringHelper*)pgm_read_ptr(&MENU_ITEMS[i]));
+    }
+    display.display();
+}
 
-    EEPROM_read(PHVALUEADDR+24, this->_flowMl);//load the acid (pH = 4.0) voltage of the pH board from the EEPROM
-    ////Serial.println(this->_acidVoltage);
-    if(EEPROM.read(PHVALUEADDR+24)==0xFF  || isnan(this->_flowMl)){
-        this->_flowMl = 6.0;  // new EEPROM, write typical voltage
-        EEPROM_write(PHVALUEADDR+24, this->_flowMl);
-    }
-   
-    EEPROM_read(PHVALUEADDR+40, this->_phBuff);//load the acid (pH = 4.0) voltage of the pH board from the EEPROM
-    ////Serial.println(this->_acidVoltage);
-    if(EEPROM.read(PHVALUEADDR+40)==0xFF  || isnan(this->_phBuff)){
-        this->_phBuff = 0.1;  // new EEPROM, write typical voltage
-        EEPROM_write(PHVALUEADDR+40, this->_phBuff);
+bool DFRobot_PH::showTemplate(int screen)
+{
+#if SCREEN_TEMPLATES
+    uint8_t *frame = display.getBuffer();
+    if(frame == NULL || screen < 0 || screen >= SCREEN_TEMPLATE_COUNT
+       || Board::screenWidth != SCREEN_TEMPLATE_WIDTH || Board::screenHeight != SCREEN_TEMPLATE_HEIGHT) {
+        return false;
     }
+    memcpy_P(frame, SCREEN_TEMPLATE_DATA[screen], SCREEN_TEMPLATE_SIZE);
+    return true;
+#else
+    return false;
+#endif
+}
 
-    EEPROM_read(FLOWRATEADDRESS, this->_flowRate);
-    if(isnan(this->_flowRate)) {
-      this->_flowRate = 0.6;
+void DFRobot_PH::drawValueScreen(int screen, const __FlashStringHelper *label, float value, int16_t valueY)
+{
+    display.clearDisplay();
+    if(!showTemplate(screen)) {
+        display.setTextSize(1);
+        display.setCursor(0, 5);
+        display.print(label);
     }
-    delay(5);
-    EEPROM_read(PUMPSPEEDADDRESS, this->_pumpSpeed);
-    if(isnan(this->_pumpSpeed)) {
-      this->_pumpSpeed = 160;
+    dtostrf(value, 6, 2, this->_valueText);       //only the number is rasterized
+    display.setTextSize(2);
+    display.setCursor(0, valueY);
+    display.print(this->_valueText);
+    display.display();
+}
+
+void DFRobot_PH::saveSetting(uint16_t field)
+{
+    SettingsData settings = this->_settings->get();
+    if(field == SETTING_NEUTRAL) {
+        settings.neutralVoltage = this->_edit.neutralVoltage;
+    } else if(field == SETTING_ACID) {
+        settings.acidVoltage = this->_edit.acidVoltage;
+    } else if(field == SETTING_TARGET) {
+        settings.targetPh = this->_edit.targetPh;
+    } else if(field == SETTING_ISF) {
+        settings.isF = this->_edit.isF;
+    } else if(field == SETTING_AMOUNT) {
+        settings.pumpAmount = this->_edit.pumpAmount;
+    } else if(field == SETTING_WAIT) {
+        settings.pumpWait = this->_edit.pumpWait;
+    } else if(field == SETTING_FLOWML) {
+        settings.flowMl = this->_edit.flowMl;
+    } else if(field == SETTING_FLOWRATE) {
+        settings.flowRate = this->_edit.flowRate;
+    } else if(field == SETTING_PHBUFF) {
+        settings.phBuff = this->_edit.phBuff;
     }
-} 
+    this->_settings->commit(settings);
+}
 
 float DFRobot_PH::readPH(float voltage, float temperature, bool isDosing)
 {
+    showReading(toPH(voltage, temperature), temperature, isDosing);
+    return this->_phValue;
+}
+
+float DFRobot_PH::toPH(float voltage, float temperature)
+{
+    const SettingsData &settings = this->_settings->get();
     //Serial.println(voltage);
-    //Serial.println(this->_neutralVoltage);
-    //Serial.println(this->_acidVoltage);
-    float slope = (7.0-4.0)/((this->_neutralVoltage-1500.0)/3.0 - (this->_acidVoltage-1500.0)/3.0);  // two point: (_neutralVoltage,7.0),(_acidVoltage,4.0)
+    //Serial.println(settings.neutralVoltage);
+    //Serial.println(settings.acidVoltage);
+    float slope = (7.0-4.0)/((settings.neutralVoltage-1500.0)/3.0 - (settings.acidVoltage-1500.0)/3.0);  // two point: (_neutralVoltage,7.0),(_acidVoltage,4.0)
     //Serial.println(slope);
-    float intercept =  7.0 - slope*(this->_neutralVoltage-1500.0)/3.0;
+    float intercept =  7.0 - slope*(settings.neutralVoltage-1500.0)/3.0;
     //Serial.println(intercept);
     ////Serial.print("slope:");
     ////Serial.print(slope);
@@ -204,51 +231,65 @@ float DFRobot_PH::readPH(float voltage, float temperature, bool isDosing)
     float standardTemperature = 25.0;
     float temperatureCoefficient = -0.003;
     float temperatureC = temperature;
-    if(this->_isF == 1.0){
+    if(settings.isF == 1.0){
       float temperatureC = (temperature - 32) / 1.8;
     }
-    this->_phValue = uncompensatedPhValue + (temperatureC - standardTemperature) * temperatureCoefficient;
+    return uncompensatedPhValue + (temperatureC - standardTemperature) * temperatureCoefficient;
+}
 
-    //Serial.println(this->_phValue);
-    if(enterCalibrationFlag == 0) {
-        display.clearDisplay();
-        display.setTextSize(1);
-        display.setCursor(0, 5);
-        display.print(F("Temperature: "));
-        display.print(temperature,1);
-        if(this->_isF == 1.0) {
-            display.print(F(" F"));
-        } else {
-            display.print(F(" C"));
-        }
-        display.setTextSize(2);
-        display.println();
-        display.print(F("pH: "));
-        display.print(_phValue,2);
-        if(isDosing) {
-          display.setTextSize(1);
-          display.println(F("..v.."));
-        } else {
-          display.println();
-        }
-        display.setTextSize(1);
-        display.println();
-        display.println();
-        display.print(F("Target: "));
-        display.print(_targetPh,2);
-        display.display();
+void DFRobot_PH::showReading(float ph, float temperature, bool isDosing, float uncertainty)
+{
+    this->_phValue = ph;
+    this->_isDosing = isDosing;
+    this->_uncertainty = uncertainty;
+    if(this->_enterCalibrationFlag == 0) {
+        drawReading(temperature, isDosing, uncertainty);
     }
-    return _phValue;
 }
 
+void DFRobot_PH::drawReading(float temperature, bool isDosing, float uncertainty)
+{
+    const SettingsData &settings = this->_settings->get();
+    display.clearDisplay();
+    display.setTextSize(1);
+    display.setCursor(0, 5);
+    display.print(F("Temperature: "));
+    display.print(temperature,1);
+    if(settings.isF == 1.0) {
+        display.print(F(" F"));
+    } else {
+        display.print(F(" C"));
+    }
+    display.setTextSize(2);
+    display.println();
+    display.print(F("pH: "));
+    display.print(_phValue,2);
+    if(isDosing) {
+      display.setTextSize(1);
+      display.println(F("..v.."));
+    } else {
+      display.println();
+    }
+    display.setTextSize(1);
+    display.println();
+    display.println();
+    display.print(F("Target: "));
+    display.print(settings.targetPh,2);
+    if(!isnan(uncertainty)) {
+        display.print(F("  +-"));
+        display.print(uncertainty,2);
+    }
+    display.display();
+}
 
 void DFRobot_PH::calibration(float voltage, float temperature,char* cmd)
 {
     this->_voltage = voltage;
     this->_temperature = temperature;
-    String sCmd = String(cmd);
-    sCmd.toUpperCase();
-    phCalibration(cmdParse(sCmd.c_str()));  // if received Serial CMD from the serial monitor, enter into the calibration mode
+    char upper[ReceivedBufferLength];
+    strncpy(upper, cmd, sizeof(upper) - 1);
+    upper[sizeof(upper) - 1] = '\0';
+    phCalibration(cmdParse(strupr(upper)));  // if received Serial CMD from the serial monitor, enter into the calibration mode
 }
 
 void DFRobot_PH::calibration(float voltage, float temperature)
@@ -256,7 +297,14 @@ void DFRobot_PH::calibration(float voltage, float temperature)
     this->_voltage = voltage;
     this->_temperature = temperature;
     if(cmdSerialDataAvailable() > 0){
-        phCalibration(cmdParse());  // if received Serial CMD from the serial monitor, enter into the calibration mode
+        TRACE_INSTANT(TRACK_MENU, "serial", 0);
+        if(systemCommand()) {               //as typed, an IMPORT blob is base64 and case matters
+            return;
+        }
+        strupr(this->_cmdReceivedBuffer);
+        if(Board::hasSerialCalibration) {
+            phCalibration(cmdParse());  // if received Serial CMD from the serial monitor, enter into the calibration mode
+        }
     }
 
 }
@@ -272,9 +320,12 @@ boolean DFRobot_PH::cmdSerialDataAvailable()
         }
         cmdReceivedTimeOut = millis();
         cmdReceivedChar = Serial.read();
+        if (cmdReceivedChar == '\r'){
+            continue;
+        }
         if (cmdReceivedChar == '\n' || this->_cmdReceivedBufferIndex==ReceivedBufferLength-1){
+            this->_cmdReceivedBuffer[this->_cmdReceivedBufferIndex] = '\0';
             this->_cmdReceivedBufferIndex = 0;
-            strupr(this->_cmdReceivedBuffer);
             return true;
         }else{
             this->_cmdReceivedBuffer[this->_cmdReceivedBufferIndex] = cmdReceivedChar;
@@ -284,6 +335,106 @@ boolean DFRobot_PH::cmdSerialDataAvailable()
     return false;
 }
 
+bool DFRobot_PH::systemCommand()
+{
+    if(strcasecmp(this->_cmdReceivedBuffer, "EXPORT") == 0) {
+        char text[SETTINGS_TEXT_LENGTH];
+        this->_settings->exportText(text, sizeof(text));
+        Serial.print(F("SETTINGS "));
+        Serial.println(text);
+        return true;
+    }
+    if(strcasecmp(this->_cmdReceivedBuffer, "BUS") == 0) {
+        i2cBus.report(Serial);
+        return true;
+    }
+    if(strcasecmp(this->_cmdReceivedBuffer, "STATS") == 0) {
+        stats.report(Serial);
+        return true;
+    }
+    if(strcasecmp(this->_cmdReceivedBuffer, "STATS RESET") == 0) {
+        stats.reset();
+        Serial.println(F("STATS RESET OK"));
+        return true;
+    }
+    if(strcasecmp(this->_cmdReceivedBuffer, "TRACE") == 0) {
+#if TRACE_ENABLE
+        trace.dump(Serial);
+#else
+        Serial.println(F("TRACE ERROR set TRACE_ENABLE 1 in Trace.h"));
+#endif
+        return true;
+    }
+    if(strcasecmp(this->_cmdReceivedBuffer, "HEAP") == 0) {
+        heapMonitor.report(Serial);
+        return true;
+    }
+    if(strncasecmp(this->_cmdReceivedBuffer, "CAPTURE", 7) == 0) {
+        if(strcasecmp(this->_cmdReceivedBuffer + 7, " STOP") == 0) {
+            capture.stop();
+        } else if(!Board::hasAds1115 || !capture.start(strtoul(this->_cmdReceivedBuffer + 7, NULL, 10) * 1000UL)) {
+            Serial.println(F("CAPTURE ERROR"));
+        }
+        return true;
+    }
+    if(strncasecmp(this->_cmdReceivedBuffer, "MIRROR", 6) == 0) {
+        if(strcasecmp(this->_cmdReceivedBuffer + 6, " STOP") == 0) {
+            mirror.stop();
+        } else {
+            unsigned long periodMs = strtoul(this->_cmdReceivedBuffer + 6, NULL, 10);
+            if(!Board::hasOled || !mirror.start(periodMs > 0 ? periodMs : MIRROR_PERIOD_MS)) {
+                Serial.println(F("MIRROR ERROR"));
+            }
+        }
+        return true;
+    }
+    if(this->_pump != NULL && strcasecmp(this->_cmdReceivedBuffer, "FLOW") == 0) {
+        this->_pump->reportFlow(Serial);
+        return true;
+    }
+    if(this->_pump != NULL && strncasecmp(this->_cmdReceivedBuffer, "PUMPCAL ", 8) == 0) {
+        char *end;
+        long speed = strtol(this->_cmdReceivedBuffer + 8, &end, 10);
+        float ml = strtod(end, NULL);
+        if(speed < 0 || speed > 180 || speed == FLOW_SERVO_STOP) {
+            Serial.println(F("PUMPCAL ERROR speed"));
+        } else if(!FlowCurve::sameDirection(speed, this->_settings->get().pumpSpeed)) {
+            Serial.println(F("PUMPCAL ERROR direction, use a speed on the pumpSpeed side of 90"));
+        } else if(ml > 0) {
+            this->_pump->setCalibration(speed, ml);     //PUMPCAL <speed> <ml collected>
+            this->_pump->reportFlow(Serial);
+        } else {
+            this->_pump->calibrateAt(speed);            //PUMPCAL <speed>, runs into a measuring cup
+            Serial.println(F("PUMPCAL running, send PUMPCAL <speed> <ml> when it stops"));
+        }
+        return true;
+    }
+    if(strncasecmp(this->_cmdReceivedBuffer, "SET ", 4) == 0) {
+        byte result = this->_settings->setText(this->_cmdReceivedBuffer + 4);
+        if(result == SETTINGS_IMPORT_OK) {
+            Serial.println(F("SET OK"));
+            if(this->_enterCalibrationFlag == 0) {
+                drawReading(this->_temperature, this->_isDosing, this->_uncertainty);  //one redraw for the whole batch
+            }
+        } else {
+            Serial.print(F("SET ERROR "));
+            Serial.println(result);
+        }
+        return true;
+    }
+    if(strncasecmp(this->_cmdReceivedBuffer, "IMPORT ", 7) == 0) {
+        byte result = this->_settings->importText(this->_cmdReceivedBuffer + 7);
+        if(result == SETTINGS_IMPORT_OK) {
+            Serial.println(F("IMPORT OK"));
+        } else {
+            Serial.print(F("IMPORT ERROR "));
+            Serial.println(result);
+        }
+        return true;
+    }
+    return false;
+}
+
 byte DFRobot_PH::cmdParse(const char* cmd)
 {
     int modeIndex = 0;
@@ -303,7 +454,7 @@ byte DFRobot_PH::cmdParse(const char* cmd)
     else if(strstr(cmd, "MT")  != NULL){
         modeIndex = 6;
     }
-    else if(String(cmd).equals("ST")){
+    else if(strcmp(cmd, "ST") == 0){
         modeIndex = 7;
     }
     else if(strstr(cmd, "TT")  != NULL){
@@ -321,90 +472,111 @@ byte DFRobot_PH::cmdParse(const char* cmd)
     else if(strstr(cmd, "4GP")  != NULL){
         modeIndex = 12;
     } 
-    else if(String(cmd).equals("5GP")){
+    else if(strcmp(cmd, "5GP") == 0){
         modeIndex = 122;
     }
-    else if(String(cmd).equals("6GP")){
+    else if(strcmp(cmd, "6GP") == 0){
         modeIndex = 123;
     } 
+    else if(strcmp(cmd, "7GP") == 0){
+        modeIndex = 124;
+    } 
     else if(strstr(cmd, "LDOSE")  != NULL){
         modeIndex = 13;
     }
     else if(strstr(cmd, "BACK")  != NULL){
         modeIndex = 14;
     }
-    else if(String(cmd).equals("FRATE")){
+    else if(strcmp(cmd, "FRATE") == 0){
         modeIndex = 15;
     }
-    else if(String(cmd).equals("PFRATE")){
+    else if(strcmp(cmd, "PFRATE") == 0){
         modeIndex = 16;
     }
-    else if(String(cmd).equals("MFRATE")){
+    else if(strcmp(cmd, "MFRATE") == 0){
         modeIndex = 17;
     }
-    else if(String(cmd).equals("SFRATE")){
+    else if(strcmp(cmd, "SFRATE") == 0){
         modeIndex = 18;
     }
-    else if(String(cmd).equals("AMNT")){
+    else if(strcmp(cmd, "AMNT") == 0){
         modeIndex = 19;
     }
-    else if(String(cmd).equals("PAMNT")){
+    else if(strcmp(cmd, "PAMNT") == 0){
         modeIndex = 20;
     }
-    else if(String(cmd).equals("MAMNT")){
+    else if(strcmp(cmd, "MAMNT") == 0){
         modeIndex = 21;
     }
-    else if(String(cmd).equals("SAMNT")){
+    else if(strcmp(cmd, "SAMNT") == 0){
         modeIndex = 22;
     }
-    else if(String(cmd).equals("WTIME")){
+    else if(strcmp(cmd, "WTIME") == 0){
         modeIndex = 23;
     }
-    else if(String(cmd).equals("PWTIME")){
+    else if(strcmp(cmd, "PWTIME") == 0){
         modeIndex = 24;
     }
-    else if(String(cmd).equals("MWTIME")){
+    else if(strcmp(cmd, "MWTIME") == 0){
         modeIndex = 25;
     } 
-    else if(String(cmd).equals("SWTIME")){
+    else if(strcmp(cmd, "SWTIME") == 0){
         modeIndex = 26;
     }
-    else if(String(cmd).equals("PCAL")){
+    else if(strcmp(cmd, "PCAL") == 0){
         modeIndex = 27;
     } 
-    else if(String(cmd).equals("PCAL2")){
+    else if(strcmp(cmd, "PCAL2") == 0){
         modeIndex = 28;
     }
-    else if(String(cmd).equals("PSTART")){
+    else if(strcmp(cmd, "PSTART") == 0){
         modeIndex = 29;
     } 
-    else if(String(cmd).equals("PCALW")){
+    else if(strcmp(cmd, "PCALW") == 0){
         modeIndex = 30;
     }
-    else if(String(cmd).equals("PCALP")){
+    else if(strcmp(cmd, "PCALP") == 0){
         modeIndex = 31;
     }
-    else if(String(cmd).equals("PCALM")){
+    else if(strcmp(cmd, "PCALM") == 0){
         modeIndex = 32;
     }
-    else if(String(cmd).equals("PCALS")){
+    else if(strcmp(cmd, "PCALS") == 0){
         modeIndex = 33;
     } 
-    else if(String(cmd).equals("S5GP")){
+    else if(strcmp(cmd, "S5GP") == 0){
         modeIndex = 34;
     }
-    else if(String(cmd).equals("BUFF")){
+    else if(strcmp(cmd, "BUFF") == 0){
         modeIndex = 35;
     }  
-    else if(String(cmd).equals("PBUFF")){
+    else if(strcmp(cmd, "PBUFF") == 0){
         modeIndex = 36;
     }
-    else if(String(cmd).equals("MBUFF")){
+    else if(strcmp(cmd, "MBUFF") == 0){
         modeIndex = 37;
     }
-    else if(String(cmd).equals("SBUFF")){
+    else if(strcmp(cmd, "SBUFF") == 0){
         modeIndex = 38;
     }
+    else if(strcmp(cmd, "DIAG") == 0){
+        modeIndex = 39;
+    }
+    else if(strcmp(cmd, "STATS") == 0){
+        modeIndex = 43;
+    }
+    else if(strcmp(cmd, "8GP") == 0){
+        modeIndex = 125;
+    }
+    else if(strcmp(cmd, "TRENDH") == 0){
+        modeIndex = 40;
+    }
+    else if(strcmp(cmd, "TRENDD") == 0){
+        modeIndex = 41;
+    }
+    else if(strcmp(cmd, "TRENDW") == 0){
+        modeIndex = 42;
+    }
     return modeIndex;
 }
 
@@ -455,283 +627,214 @@ void DFRobot_PH::phCalibration(int mode)
 {
     const float epsilon = 0.0001;
     char *receivedBufferPtr;
+    if(mode != 0) {
+        TRACE_INSTANT(TRACK_MENU, "mode", mode);
+    }
     if(mode == 0) {
-        if(enterCalibrationFlag){
+        if(this->_enterCalibrationFlag){
             //Serial.println(F(">>>Command Error<<<"));
         }
     } else if(mode == 1) {
-        enterCalibrationFlag = 1;
-        phCalibrationFinish  = 0;
+        this->_enterCalibrationFlag = 1;
+        this->_calibrationFinish  = 0;
+        this->_edit = this->_settings->get();
         // //Serial.println();
         // //Serial.println(F(">>>Enter PH Calibration Mode<<<"));
         // //Serial.println(F(">>>Please put the probe into the 4.0 or 7.0 standard buffer solution<<<"));
         // //Serial.println();
         display.clearDisplay();
-        display.setTextSize(1);
-        display.setCursor(0, 5);
-        display.print(F("Calibration Mode"));
-        display.setTextSize(1);
-        display.setCursor(0, 20);
-        display.print(F("Please insert the probe to the 4.0 or 7.0 standard buffer solution, and press 'SET'"));
+        if(!showTemplate(SCREEN(CALIBRATION_MODE))) {
+            display.setTextSize(1);
+            display.setCursor(0, 5);
+            display.print(F("Calibration Mode"));
+            display.setTextSize(1);
+            display.setCursor(0, 20);
+            display.print(F("Please insert the probe to the 4.0 or 7.0 standard buffer solution, and press 'SET'"));
+        }
         display.display();
    } else if(mode == 2) {
-        if(enterCalibrationFlag){
+        if(this->_enterCalibrationFlag){
             display.clearDisplay();
-            if((this->_voltage>1322)&&(this->_voltage<1678)){        // buffer solution:7.0{
+            if((this->_voltage>Board::ph7Low)&&(this->_voltage<Board::ph7High)){        // buffer solution:7.0{
                 // //Serial.println();
                 // //Serial.print(F(">>>Buffer Solution:7.0"));
                 display.clearDisplay();
-                display.setTextSize(1);
-                display.setCursor(0, 5);
-                display.print(F("Buffer Solution"));
-                display.setTextSize(2);
-                display.setCursor(0, 20);
-                display.print(F("7.0"));
-                display.setTextSize(1);
-                display.setCursor(0, 40);
-                display.print(F("Move to the next solution, or save and exit"));
+                if(!showTemplate(SCREEN(BUFFER_7))) {
+                    display.setTextSize(1);
+                    display.setCursor(0, 5);
+                    display.print(F("Buffer Solution"));
+                    display.setTextSize(2);
+                    display.setCursor(0, 20);
+                    display.print(F("7.0"));
+                    display.setTextSize(1);
+                    display.setCursor(0, 40);
+                    display.print(F("Move to the next solution, or save and exit"));
+                }
                 display.display();
-                this->_neutralVoltage =  this->_voltage;
+                this->_edit.neutralVoltage =  this->_voltage;
                 // //Serial.println(F(",Send EXITPH to Save and Exit<<<"));
                 // //Serial.println();
-                phCalibrationFinish = 1;
-            }else if((this->_voltage>1854)&&(this->_voltage<2210)){  //buffer solution:4.0
+                this->_calibrationFinish = 1;
+            }else if((this->_voltage>Board::ph4Low)&&(this->_voltage<Board::ph4High)){  //buffer solution:4.0
                 // //Serial.println();
                 // //Serial.print(F(">>>Buffer Solution:4.0"));
                 display.clearDisplay();
-                display.setTextSize(1);
-                display.setCursor(0, 5);
-                display.print(F("Buffer Solution"));
-                display.setTextSize(2);
-                display.setCursor(0, 20);
-                display.print(F("4.0"));
-                display.setTextSize(1);
-                display.setCursor(0, 40);
-                display.print(F("Move to the next solution, or save and exit"));
+                if(!showTemplate(SCREEN(BUFFER_4))) {
+                    display.setTextSize(1);
+                    display.setCursor(0, 5);
+                    display.print(F("Buffer Solution"));
+                    display.setTextSize(2);
+                    display.setCursor(0, 20);
+                    display.print(F("4.0"));
+                    display.setTextSize(1);
+                    display.setCursor(0, 40);
+                    display.print(F("Move to the next solution, or save and exit"));
+                }
                 display.display();
-                this->_acidVoltage =  this->_voltage;
+                this->_edit.acidVoltage =  this->_voltage;
                 // //Serial.println(F(",Send EXITPH to Save and Exit<<<")); 
                 // //Serial.println();
-                phCalibrationFinish = 1;
+                this->_calibrationFinish = 1;
             }else{
                 //Serial.println();
                 //Serial.print(F(">>>Buffer Solution Error Try Again<<<"));
                 //Serial.println();                                    // not buffer solution or faulty operation
                 display.clearDisplay();
-                display.setTextSize(1);
-                display.setCursor(0, 5);
-                display.print(F("Not a Buffer Solution"));
-                display.setTextSize(1);
-                display.setCursor(0, 25);
-                display.print(F("Try Again"));
+                if(!showTemplate(SCREEN(NOT_BUFFER))) {
+                    display.setTextSize(1);
+                    display.setCursor(0, 5);
+                    display.print(F("Not a Buffer Solution"));
+                    display.setTextSize(1);
+                    display.setCursor(0, 25);
+                    display.print(F("Try Again"));
+                }
                 display.display();
-                phCalibrationFinish = 0;
+                this->_calibrationFinish = 0;
             }
           }
         } else if(mode == 3) {
-        if(enterCalibrationFlag){
+        if(this->_enterCalibrationFlag){
             //Serial.println();
-            if(phCalibrationFinish){
-                if((this->_voltage>1322)&&(this->_voltage<1678)){
-                    EEPROM_write(PHVALUEADDR, this->_neutralVoltage);
-                }else if((this->_voltage>1854)&&(this->_voltage<2210)){
-                    EEPROM_write(PHVALUEADDR+4, this->_acidVoltage);
+            if(this->_calibrationFinish){
+                if((this->_voltage>Board::ph7Low)&&(this->_voltage<Board::ph7High)){
+                    saveSetting(SETTING_NEUTRAL);
+                }else if((this->_voltage>Board::ph4Low)&&(this->_voltage<Board::ph4High)){
+                    saveSetting(SETTING_ACID);
                 }
                 //Serial.print(F(">>>Calibration Successful"));
                 display.clearDisplay();
-                display.setTextSize(1);
-                display.setCursor(0, 25);
-                display.print(F("Calibration "));
-                display.setCursor(10, 35);
-                display.print(F("Successful"));
+                if(!showTemplate(SCREEN(CAL_SUCCESS))) {
+                    display.setTextSize(1);
+                    display.setCursor(0, 25);
+                    display.print(F("Calibration "));
+                    display.setCursor(10, 35);
+                    display.print(F("Successful"));
+                }
                 display.display();
             }else{
                 //Serial.print(F(">>>Exit"));
                 display.clearDisplay();
-                display.setTextSize(1);
-                display.setCursor(0, 25);
-                display.print(F("Exit"));
+                if(!showTemplate(SCREEN(CAL_EXIT))) {
+                    display.setTextSize(1);
+                    display.setCursor(0, 25);
+                    display.print(F("Exit"));
+                }
                 display.display();
             }
             //Serial.println(F(",Exit PH Calibration Mode<<<"));
             //Serial.println();
+            display.flush();        //whole frame now, the loop does not run during the delay
             delay(2000);
-            phCalibrationFinish  = 0;
-            enterCalibrationFlag = 0;
+            this->_calibrationFinish  = 0;
+            this->_enterCalibrationFlag = 0;
           }
         } else if(mode == 4) {
-            if(enterCalibrationFlag == 0){
+            if(this->_enterCalibrationFlag == 0){
                 //Serial.println(F(">>>Set PH Target"));
-                dtostrf(_targetPh, 6, 2, buffer);
-                display.clearDisplay();
-                display.setTextSize(1);
-                display.setCursor(0, 5);
-                display.print(F("Set pH Target: "));
-                display.setTextSize(2);
-                display.setCursor(0, 35);
-                display.print(buffer);
-                display.display();
-                enterCalibrationFlag = 1;
+                this->_edit = this->_settings->get();
+                drawValueScreen(SCREEN(SET_TARGET), F("Set pH Target: "), _edit.targetPh, 35);
+                this->_enterCalibrationFlag = 1;
             }
         } else if(mode == 5) {
-            if(enterCalibrationFlag){
-                this->_targetPh = _targetPh + 0.1;
-                dtostrf(_targetPh, 6, 2, buffer);
-                display.clearDisplay();
-                display.setTextSize(1);
-                display.setCursor(0, 5);
-                display.print(F("Set pH Target: "));
-                display.setTextSize(2);
-                display.setCursor(0, 35);
-                display.print(buffer);
-                display.display();
+            if(this->_enterCalibrationFlag){
+                this->_edit.targetPh = _edit.targetPh + 0.1;
+                drawValueScreen(SCREEN(SET_TARGET), F("Set pH Target: "), _edit.targetPh, 35);
             }
         } else if(mode == 6) {
-            if(enterCalibrationFlag){
-                this->_targetPh = _targetPh - 0.1;
-                dtostrf(_targetPh, 6, 2, buffer);
-                display.clearDisplay();
-                display.setTextSize(1);
-                display.setCursor(0, 5);
-                display.print(F("Set pH Target: "));
-                display.setTextSize(2);
-                display.setCursor(0, 35);
-                display.print(buffer);
-                display.display();
+            if(this->_enterCalibrationFlag){
+                this->_edit.targetPh = _edit.targetPh - 0.1;
+                drawValueScreen(SCREEN(SET_TARGET), F("Set pH Target: "), _edit.targetPh, 35);
             }
         } else if(mode == 7) {
-            if(enterCalibrationFlag) {
-                EEPROM_write(PHVALUEADDR+8, this->_targetPh);
-                enterCalibrationFlag = 0;
+            if(this->_enterCalibrationFlag) {
+                saveSetting(SETTING_TARGET);
+                this->_enterCalibrationFlag = 0;
                 //Serial.println(F(">>>Set Target Successful"));
                 display.clearDisplay();
-                display.setTextSize(1);
-                display.setCursor(0, 25);
-                display.print(F("Set Target "));
-                display.setCursor(10, 35);
-                display.print(F("Successful"));
-                display.display();
+                if(!showTemplate(SCREEN(TARGET_SUCCESS))) {
+                    display.setTextSize(1);
+                    display.setCursor(0, 25);
+                    display.print(F("Set Target "));
+                    display.setCursor(10, 35);
+                    display.print(F("Successful"));
+                }
+                display.flush();
                 delay(2000);
             }       
         } else if(mode == 8) {
-            if(enterCalibrationFlag == 0 && phCalibrationFinish == 0) {
+            if(this->_enterCalibrationFlag == 0 && this->_calibrationFinish == 0) {
                 display.clearDisplay();
-                display.setTextSize(2);
-                display.setCursor(0, 15);
-                if(this->_isF == 0.0) {
-                    this->_isF = 1.0;
-                    EEPROM_write(PHVALUEADDR+12, this->_isF);
+                this->_edit.isF = this->_settings->get().isF;
+                if(this->_edit.isF == 0.0) {
+                    this->_edit.isF = 1.0;
+                    saveSetting(SETTING_ISF);
                     //Serial.println(F(">>>Set Temp to F"));
-                    display.print(F("Fahrenheit"));
+                    if(!showTemplate(SCREEN(FAHRENHEIT))) {
+                        display.setTextSize(2);
+                        display.setCursor(0, 15);
+                        display.print(F("Fahrenheit"));
+                    }
                 } else {
-                    this->_isF = 0.0;
-                    EEPROM_write(PHVALUEADDR+12, this->_isF);
+                    this->_edit.isF = 0.0;
+                    saveSetting(SETTING_ISF);
                     //Serial.println(F(">>>Set Temp to C"));
-                    display.print(F("Celsius"));
+                    if(!showTemplate(SCREEN(CELSIUS))) {
+                        display.setTextSize(2);
+                        display.setCursor(0, 15);
+                        display.print(F("Celsius"));
+                    }
                 } 
                 display.display();
             }       
         } else if(mode == 9) {
-            enterCalibrationFlag = 1;
-            //Serial.println(F(">>>Pump Settings - Flow Rate"));
-            display.clearDisplay();
-            display.setTextSize(1);
-            display.setCursor(0, 5);
-            display.println(F("Pump Settings"));
-            display.setCursor(0, 15);
-            display.println(F("> Flow Rate"));
-            display.println(F("  Amount"));
-            display.println(F("  Wait time"));
-            display.println(F("  Calibrate"));
-            display.println(F("  Test 2 ml"));
-            display.println(F("  Buffer"));
-            display.display();
-      } else if(mode == 10) {
-            enterCalibrationFlag = 1;
-            //Serial.println(F(">>>Pump Settings - Amount"));
-            display.clearDisplay();
-            display.setTextSize(1);
-            display.setCursor(0, 5);
-            display.println(F("Pump Settings"));
-            display.setCursor(0, 15);
-            display.println(F("  Flow Rate"));
-            display.println(F("> Amount"));
-            display.println(F("  Wait time"));
-            display.println(F("  Calibrate"));
-            display.println(F("  Test 2 ml"));
-            display.println(F("  Buffer"));
-            display.display();
+            drawPumpMenu(0);
+       } else if(mode == 10) {
+            drawPumpMenu(1);
        } else if(mode == 11) {
-            enterCalibrationFlag = 1;
-            //Serial.println(F(">>>Pump Settings - Wait time"));
-            display.clearDisplay();
-            display.setTextSize(1);
-            display.setCursor(0, 5);
-            display.println(F("Pump Settings"));
-            display.setCursor(0, 15);
-            display.println(F("  Flow Rate"));
-            display.println(F("  Amount"));
-            display.println(F("> Wait time"));
-            display.println(F("  Calibrate"));
-            display.println(F("  Test 2 ml"));
-            display.println(F("  Buffer"));
-            display.display();
+            drawPumpMenu(2);
        } else if(mode == 12) {
-            enterCalibrationFlag = 1;
-            //Serial.println(F(">>>Pump Settings - Calibrate"));
-            display.clearDisplay();
-            display.setTextSize(1);
-            display.setCursor(0, 5);
-            display.println(F("Pump Settings"));
-            display.setCursor(0, 15);
-            display.println(F("  Flow Rate"));
-            display.println(F("  Amount"));
-            display.println(F("  Wait time"));
-            display.println(F("> Calibrate"));
-            display.println(F("  Test 2 ml"));
-            display.println(F("  Buffer"));
-            display.display();
+            drawPumpMenu(3);
        } else if(mode == 122) {
-            enterCalibrationFlag = 1;
-            //Serial.println(F(">>>Pump Settings - Calibrate"));
-            display.clearDisplay();
-            display.setTextSize(1);
-            display.setCursor(0, 5);
-            display.println(F("Pump Settings"));
-            display.setCursor(0, 15);
-            display.println(F("  Flow Rate"));
-            display.println(F("  Amount"));
-            display.println(F("  Wait time"));
-            display.println(F("  Calibrate"));
-            display.println(F("> Test 2 ml"));
-            display.println(F("  Buffer"));
-            display.display();
+            drawPumpMenu(4);
        } else if(mode == 123) {
-            enterCalibrationFlag = 1;
-            //Serial.println(F(">>>Pump Settings - Calibrate"));
-            display.clearDisplay();
-            display.setTextSize(1);
-            display.setCursor(0, 5);
-            display.println(F("Pump Settings"));
-            display.setCursor(0, 15);
-            display.println(F("  Flow Rate"));
-            display.println(F("  Amount"));
-            display.println(F("  Wait time"));
-            display.println(F("  Calibrate"));
-            display.println(F("  Test 2 ml"));
-            display.println(F("> Buffer"));
-            display.display();
+            drawPumpMenu(5);
+       } else if(mode == 124) {
+            drawPumpMenu(6);
+       } else if(mode == 125) {
+            drawPumpMenu(7);
        } else if(mode == 13) {
           //Serial.println(F(">>>Dosing..."));
           display.clearDisplay();
-          display.setTextSize(2);
-          display.setCursor(0, 5);
-          display.println();
-          display.println(F("Dosing..."));
-          display.println();
+          if(!showTemplate(SCREEN(DOSING))) {
+              display.setTextSize(2);
+              display.setCursor(0, 5);
+              display.println();
+              display.println(F("Dosing..."));
+              display.println();
+          }
           display.display();
        } else if(mode == 14) {
-          enterCalibrationFlag = 1;
+          this->_enterCalibrationFlag = 1;
           display.clearDisplay();
           display.setTextSize(1);
           display.println();
@@ -742,347 +845,354 @@ void DFRobot_PH::phCalibration(int mode)
           display.setTextSize(1);
           display.println();
           display.print(F("Target: "));
-          display.println(_targetPh,2);
+          display.println(this->_settings->get().targetPh,2);
           display.display();
           //display.display();
        } else if(mode == 15) {
           //Serial.println(F(">>>Set Flow Rate"));
-          dtostrf(_flowRate, 6, 2, buffer);
-          display.clearDisplay();
-          display.setTextSize(1);
-          display.setCursor(0, 5);
-          display.println(F("Set Flow Rate: "));
-          display.println();
-          display.setTextSize(2);
-          display.println(buffer);
-          display.display();
-          enterCalibrationFlag = 1;
+          this->_edit = this->_settings->get();
+          drawValueScreen(SCREEN(SET_FLOW_RATE), F("Set Flow Rate: "), _edit.flowRate, 21);
+          this->_enterCalibrationFlag = 1;
        } else if(mode == 16) {
-            if(enterCalibrationFlag){
-                this->_flowRate = _flowRate + 0.05;
-                dtostrf(_flowRate, 6, 2, buffer);
-                display.clearDisplay();
-                display.setTextSize(1);
-                display.setCursor(0, 5);
-                display.println(F("Set Flow Rate: "));
-                display.println();
-                display.setTextSize(2);
-                display.println(buffer);
-                display.display();
+            if(this->_enterCalibrationFlag){
+                this->_edit.flowRate = _edit.flowRate + 0.05;
+                drawValueScreen(SCREEN(SET_FLOW_RATE), F("Set Flow Rate: "), _edit.flowRate, 21);
             }
         } else if(mode == 17) {
-            if(enterCalibrationFlag){
-                if (abs(_flowRate - 0.05) < epsilon) {
+            if(this->_enterCalibrationFlag){
+                if (abs(_edit.flowRate - 0.05) < epsilon) {
                   return;
                 }
-                this->_flowRate = _flowRate - 0.05;
-                dtostrf(_flowRate, 6, 2, buffer);
-                display.clearDisplay();
-                display.setTextSize(1);
-                display.setCursor(0, 5);
-                display.println(F("Set Flow Rate: "));
-                display.println();
-                display.setTextSize(2);
-                display.println(buffer);
-                display.display();
+                this->_edit.flowRate = _edit.flowRate - 0.05;
+                drawValueScreen(SCREEN(SET_FLOW_RATE), F("Set Flow Rate: "), _edit.flowRate, 21);
             }
         } else if(mode == 18) {
-            if(enterCalibrationFlag) {
-                EEPROM_write(FLOWRATEADDRESS, this->_flowRate);
-                enterCalibrationFlag = 0;
+            if(this->_enterCalibrationFlag) {
+                saveSetting(SETTING_FLOWRATE);
+                this->_enterCalibrationFlag = 0;
                 //Serial.println(F(">>>Set flow Rate Successful"));
                 display.clearDisplay();
-                display.setTextSize(1);
-                display.setCursor(0, 5);
-                display.println();
-                display.println(F("Set Flow Rate "));
-                display.println(F("Successful"));
-                display.display();
+                if(!showTemplate(SCREEN(FLOW_RATE_SUCCESS))) {
+                    display.setTextSize(1);
+                    display.setCursor(0, 5);
+                    display.println();
+                    display.println(F("Set Flow Rate "));
+                    display.println(F("Successful"));
+                }
+                display.flush();
                 delay(1000);
             }       
         } else if(mode == 19) {
-          dtostrf(_pumpAmount, 6, 2, buffer);
-          display.clearDisplay();
-          display.setTextSize(1);
-          display.setCursor(0, 5);
-          display.println(F("Set Amount: "));
-          display.println();
-          display.setTextSize(2);
-          display.println(buffer);
-          display.display();
-          enterCalibrationFlag = 1;
+          this->_edit = this->_settings->get();
+          drawValueScreen(SCREEN(SET_AMOUNT), F("Set Amount: "), _edit.pumpAmount, 21);
+          this->_enterCalibrationFlag = 1;
        } else if(mode == 20) {
-            if(enterCalibrationFlag){
-                if(_pumpAmount <= 0.2 ) {
-                  this->_pumpAmount = _pumpAmount + 0.01;
-                } else if(_pumpAmount <= 1.0 ) {
-                  this->_pumpAmount = _pumpAmount + 0.1;
+            if(this->_enterCalibrationFlag){
+                if(_edit.pumpAmount <= 0.2 ) {
+                  this->_edit.pumpAmount = _edit.pumpAmount + 0.01;
+                } else if(_edit.pumpAmount <= 1.0 ) {
+                  this->_edit.pumpAmount = _edit.pumpAmount + 0.1;
                 } else {
-                  this->_pumpAmount = _pumpAmount + 0.5;
+                  this->_edit.pumpAmount = _edit.pumpAmount + 0.5;
                 }
-                dtostrf(_pumpAmount, 6, 2, buffer);
-                display.clearDisplay();
-                display.setTextSize(1);
-                display.setCursor(0, 5);
-                display.println(F("Set Amount: "));
-                display.println();
-                display.setTextSize(2);
-                display.println(buffer);
-                display.display();
+                drawValueScreen(SCREEN(SET_AMOUNT), F("Set Amount: "), _edit.pumpAmount, 21);
             }
         } else if(mode == 21) {
-            if(enterCalibrationFlag){
-                if (abs(_pumpAmount - 0.1) < epsilon) {
+            if(this->_enterCalibrationFlag){
+                if (abs(_edit.pumpAmount - 0.1) < epsilon) {
                   return;
                 }
-                if(_pumpAmount <= 0.2 ) {
-                  this->_pumpAmount = _pumpAmount - 0.01;
-                } else if(_pumpAmount <= 1.0 ) {
-                  this->_pumpAmount = _pumpAmount - 0.1;
+                if(_edit.pumpAmount <= 0.2 ) {
+                  this->_edit.pumpAmount = _edit.pumpAmount - 0.01;
+                } else if(_edit.pumpAmount <= 1.0 ) {
+                  this->_edit.pumpAmount = _edit.pumpAmount - 0.1;
                 } else {
-                  this->_pumpAmount = _pumpAmount - 0.5;
+                  this->_edit.pumpAmount = _edit.pumpAmount - 0.5;
                 }
-                dtostrf(_pumpAmount, 6, 2, buffer);
-                display.clearDisplay();
-                display.setTextSize(1);
-                display.setCursor(0, 5);
-                display.println(F("Set Amount: "));
-                display.println();
-                display.setTextSize(2);
-                display.println(buffer);
-                display.display();
+                drawValueScreen(SCREEN(SET_AMOUNT), F("Set Amount: "), _edit.pumpAmount, 21);
             }
         } else if(mode == 22) {
-            if(enterCalibrationFlag) {
-                EEPROM_write(PHVALUEADDR+16, this->_pumpAmount);
-                enterCalibrationFlag = 0;
+            if(this->_enterCalibrationFlag) {
+                saveSetting(SETTING_AMOUNT);
+                this->_enterCalibrationFlag = 0;
                 //Serial.println(F(">>>Set Amount Successful"));
                 display.clearDisplay();
-                display.setTextSize(1);
-                //display.setCursor(0, 25);
-                display.println();
-                display.println(F("Set Amount "));
-                //display.setCursor(10, 35);
-                display.println(F("Successful"));
-                display.display();
+                if(!showTemplate(SCREEN(AMOUNT_SUCCESS))) {
+                    display.setCursor(0, 0);
+                    display.setTextSize(1);
+                    //display.setCursor(0, 25);
+                    display.println();
+                    display.println(F("Set Amount "));
+                    //display.setCursor(10, 35);
+                    display.println(F("Successful"));
+                }
+                display.flush();
                 delay(1000);
             }       
         } else if(mode == 23) {
-          dtostrf(_pumpWait, 6, 2, buffer);
-          display.clearDisplay();
-          display.setTextSize(1);
-          display.setCursor(0, 5);
-          display.println(F("Set Wait Time: "));
-          display.println();
-          display.setTextSize(2);
-          display.println(buffer);
-          display.display();
-          enterCalibrationFlag = 1;
+          this->_edit = this->_settings->get();
+          drawValueScreen(SCREEN(SET_WAIT), F("Set Wait Time: "), _edit.pumpWait, 21);
+          this->_enterCalibrationFlag = 1;
        } else if(mode == 24) {
-            if(enterCalibrationFlag){
-                if(_pumpWait >= 1.0){
-                  this->_pumpWait = _pumpWait + 1.0;
+            if(this->_enterCalibrationFlag){
+                if(_edit.pumpWait >= 1.0){
+                  this->_edit.pumpWait = _edit.pumpWait + 1.0;
                 } else {
-                  this->_pumpWait = _pumpWait + 0.1;
+                  this->_edit.pumpWait = _edit.pumpWait + 0.1;
                 }
-                dtostrf(_pumpWait, 6, 2, buffer);
-                display.clearDisplay();
-                display.setTextSize(1);
-                display.setCursor(0, 5);
-                display.println(F("Set Wait Time: "));
-                display.println();
-                display.setTextSize(2);
-                display.println(buffer);
-                display.display();
+                drawValueScreen(SCREEN(SET_WAIT), F("Set Wait Time: "), _edit.pumpWait, 21);
             }
         } else if(mode == 25) {
-            if(enterCalibrationFlag){
-                if (abs(_pumpWait - 0.1) < epsilon) {
+            if(this->_enterCalibrationFlag){
+                if (abs(_edit.pumpWait - 0.1) < epsilon) {
                   return;
                 }
-                if(_pumpWait <= 1.0){
-                  this->_pumpWait = _pumpWait - 0.1;
+                if(_edit.pumpWait <= 1.0){
+                  this->_edit.pumpWait = _edit.pumpWait - 0.1;
                 } else {
-                  this->_pumpWait = _pumpWait - 1.0;
+                  this->_edit.pumpWait = _edit.pumpWait - 1.0;
                 }
-                dtostrf(_pumpWait, 6, 2, buffer);
-                display.clearDisplay();
-                display.setTextSize(1);
-                display.setCursor(0, 5);
-                display.println(F("Set Wait Time: "));
-                display.println();
-                display.setTextSize(2);
-                display.println(buffer);
-                display.display();
+                drawValueScreen(SCREEN(SET_WAIT), F("Set Wait Time: "), _edit.pumpWait, 21);
             }
         } else if(mode == 26) {
-            if(enterCalibrationFlag) {
-                EEPROM_write(PHVALUEADDR+20, this->_pumpWait);
-                enterCalibrationFlag = 0;
+            if(this->_enterCalibrationFlag) {
+                saveSetting(SETTING_WAIT);
+                this->_enterCalibrationFlag = 0;
                 //Serial.println(F(">>>Set Wait Time Successful"));
                 display.clearDisplay();
-                display.setTextSize(1);
-                display.println();
-                display.println(F("Set Wait Time "));
-                display.println(F("Successful"));
-                display.display();
+                if(!showTemplate(SCREEN(WAIT_SUCCESS))) {
+                    display.setCursor(0, 0);
+                    display.setTextSize(1);
+                    display.println();
+                    display.println(F("Set Wait Time "));
+                    display.println(F("Successful"));
+                }
+                display.flush();
                 delay(1000);
             }       
         } else if(mode == 27) {
-            enterCalibrationFlag = 1;
+            this->_enterCalibrationFlag = 1;
             //Serial.println(F(">>>Enter Pump Calibration Mode<<<"));
             //Serial.println(F(">>>Please set one end of the pump in a liquid and the other end in a measuring cup<<<"));
             display.clearDisplay();
-            display.setTextSize(1);
-            display.setCursor(0, 5);
-            display.println(F("Pump Calibration"));
-            display.setTextSize(1);
-            display.println();
-            display.println(F("Please set one end of the pump in a liquid and the other end in a measuring cup and press 'SET'"));
+            if(!showTemplate(SCREEN(PUMP_CAL_1))) {
+                display.setTextSize(1);
+                display.setCursor(0, 5);
+                display.println(F("Pump Calibration"));
+                display.setTextSize(1);
+                display.println();
+                display.println(F("Please set one end of the pump in a liquid and the other end in a measuring cup and press 'SET'"));
+            }
             display.display();
         } else if(mode == 28) {
-            enterCalibrationFlag = 1;
+            this->_enterCalibrationFlag = 1;
             display.clearDisplay();
-            display.setTextSize(1);
-            display.setCursor(0, 5);
-            display.println(F("Pump Calibration"));
-            display.println();
-            display.println(F("Make sure that the tube is full of liquid. Press 'DOWN' to fill it and press 'SET' to start calibration"));
+            if(!showTemplate(SCREEN(PUMP_CAL_2))) {
+                display.setTextSize(1);
+                display.setCursor(0, 5);
+                display.println(F("Pump Calibration"));
+                display.println();
+                display.println(F("Make sure that the tube is full of liquid. Press 'DOWN' to fill it and press 'SET' to start calibration"));
+            }
             display.display();
         } else if(mode == 29) {
-            enterCalibrationFlag = 1;
+            this->_enterCalibrationFlag = 1;
             display.clearDisplay();
-            display.setTextSize(1);
-            display.setCursor(0, 5);
-            display.println(F("Calibrating..."));
+            if(!showTemplate(SCREEN(CALIBRATING))) {
+                display.setTextSize(1);
+                display.setCursor(0, 5);
+                display.println(F("Calibrating..."));
+            }
             display.display();
         } else if(mode == 30) {
-          dtostrf(_flowMl, 6, 2, buffer);
-          display.clearDisplay();
-          display.setTextSize(1);
-          display.setCursor(0, 5);
-          display.println(F("Amount in ml: "));
-          display.println();
-          display.setTextSize(2);
-          display.println(buffer);
-          display.display();
-          enterCalibrationFlag = 1;
+          this->_edit = this->_settings->get();
+          drawValueScreen(SCREEN(AMOUNT_ML), F("Amount in ml: "), _edit.flowMl, 21);
+          this->_enterCalibrationFlag = 1;
        } else if(mode == 31) {
-            if(enterCalibrationFlag){
-                this->_flowMl = _flowMl + 0.1;
-                dtostrf(_flowMl, 6, 2, buffer);
-                display.clearDisplay();
-                display.setTextSize(1);
-                display.setCursor(0, 5);
-                display.println(F("Amount in ml: "));
-                display.println();
-                display.setTextSize(2);
-                display.println(buffer);
-                display.display();
+            if(this->_enterCalibrationFlag){
+                this->_edit.flowMl = _edit.flowMl + 0.1;
+                drawValueScreen(SCREEN(AMOUNT_ML), F("Amount in ml: "), _edit.flowMl, 21);
             }
         } else if(mode == 32) {
-            if(enterCalibrationFlag){
-                if(_flowMl == 0.1) {
+            if(this->_enterCalibrationFlag){
+                if(_edit.flowMl == 0.1) {
                   return;
                 }
-                this->_flowMl = _flowMl - 0.1;
-                dtostrf(_flowMl, 6, 2, buffer);
-                display.clearDisplay();
-                display.setTextSize(1);
-                display.setCursor(0, 5);
-                display.println(F("Amount in ml: "));
-                display.println();
-                display.setTextSize(2);
-                display.println(buffer);
-                display.display();
+                this->_edit.flowMl = _edit.flowMl - 0.1;
+                drawValueScreen(SCREEN(AMOUNT_ML), F("Amount in ml: "), _edit.flowMl, 21);
             }
         } else if(mode == 33) {
-            if(enterCalibrationFlag) {
-                EEPROM_write(PHVALUEADDR+24, this->_flowMl);
-                enterCalibrationFlag = 0;
+            if(this->_enterCalibrationFlag) {
+                saveSetting(SETTING_FLOWML);
+                this->_enterCalibrationFlag = 0;
                 //Serial.println(F(">>>Set Wait Time Successful"));
                 display.clearDisplay();
-                display.setTextSize(1);
-                display.println();
-                display.println(F("Calibration "));
-                display.println(F("Successful"));
-                display.display();
+                if(!showTemplate(SCREEN(PUMP_CAL_SUCCESS))) {
+                    display.setCursor(0, 0);
+                    display.setTextSize(1);
+                    display.println();
+                    display.println(F("Calibration "));
+                    display.println(F("Successful"));
+                }
+                display.flush();
                 delay(1000);
             }       
         } else if(mode == 34) {
-            enterCalibrationFlag = 1;
+            this->_enterCalibrationFlag = 1;
             display.clearDisplay();
-            display.setTextSize(1);
-            display.setCursor(0, 5);
-            display.println(F("This will test 2ml"));
-            display.println();
-            display.println(F("Continute?"));
+            if(!showTemplate(SCREEN(TEST_2ML))) {
+                display.setTextSize(1);
+                display.setCursor(0, 5);
+                display.println(F("This will test 2ml"));
+                display.println();
+                display.println(F("Continute?"));
+            }
             display.display();
         } else if(mode == 35) {
-          dtostrf(_phBuff, 6, 2, buffer);
-          display.clearDisplay();
-          display.setTextSize(1);
-          display.setCursor(0, 5);
-          display.println(F("Set Buffer: "));
-          display.println();
-          display.setTextSize(2);
-          display.println(buffer);
-          display.display();
-          enterCalibrationFlag = 1;
+          this->_edit = this->_settings->get();
+          drawValueScreen(SCREEN(SET_BUFFER), F("Set Buffer: "), _edit.phBuff, 21);
+          this->_enterCalibrationFlag = 1;
        } else if(mode == 36) {
-            if(enterCalibrationFlag){
-                if(_phBuff < 0.2 ) {
-                  this->_phBuff = _phBuff + 0.01;
+            if(this->_enterCalibrationFlag){
+                if(_edit.phBuff < 0.2 ) {
+                  this->_edit.phBuff = _edit.phBuff + 0.01;
                 } else {
-                  this->_phBuff = _phBuff + 0.1;
+                  this->_edit.phBuff = _edit.phBuff + 0.1;
                 }
-                dtostrf(_phBuff, 6, 2, buffer);
-                display.clearDisplay();
-                display.setTextSize(1);
-                display.setCursor(0, 5);
-                display.println(F("Set Buffer: "));
-                display.println();
-                display.setTextSize(2);
-                display.println(buffer);
-                display.display();
+                drawValueScreen(SCREEN(SET_BUFFER), F("Set Buffer: "), _edit.phBuff, 21);
             }
         } else if(mode == 37) {
-            if(enterCalibrationFlag){
-                if(_phBuff == 0.01) {
+            if(this->_enterCalibrationFlag){
+                if(_edit.phBuff == 0.01) {
                   return;
                 }
-                if(_phBuff <= 0.2 ) {
-                  this->_phBuff = _phBuff - 0.01;
+                if(_edit.phBuff <= 0.2 ) {
+                  this->_edit.phBuff = _edit.phBuff - 0.01;
                 }  else {
-                  this->_phBuff = _phBuff - 0.1;
+                  this->_edit.phBuff = _edit.phBuff - 0.1;
                 }
-                dtostrf(_phBuff, 6, 2, buffer);
-                display.clearDisplay();
-                display.setTextSize(1);
-                display.setCursor(0, 5);
-                display.println(F("Set Buffer: "));
-                display.println();
-                display.setTextSize(2);
-                display.println(buffer);
-                display.display();
+                drawValueScreen(SCREEN(SET_BUFFER), F("Set Buffer: "), _edit.phBuff, 21);
             }
         } else if(mode == 38) {
-            if(enterCalibrationFlag) {
-                EEPROM_write(PHVALUEADDR+40, this->_phBuff);
-                enterCalibrationFlag = 0;
+            if(this->_enterCalibrationFlag) {
+                saveSetting(SETTING_PHBUFF);
+                this->_enterCalibrationFlag = 0;
                 //Serial.println(F(">>>Set Amount Successful"));
                 display.clearDisplay();
-                display.setTextSize(1);
-                //display.setCursor(0, 25);
-                display.println();
-                display.println(F("Set Buffer "));
-                //display.setCursor(10, 35);
-                display.println(F("Successful"));
-                display.display();
+                if(!showTemplate(SCREEN(BUFFER_SUCCESS))) {
+                    display.setCursor(0, 0);
+                    display.setTextSize(1);
+                    //display.setCursor(0, 25);
+                    display.println();
+                    display.println(F("Set Buffer "));
+                    //display.setCursor(10, 35);
+                    display.println(F("Successful"));
+                }
+                display.flush();
                 delay(1000);
             }       
+        } else if(mode == 39) {
+            this->_enterCalibrationFlag = 1;
+            display.clearDisplay();
+            display.setTextSize(1);
+            display.setCursor(0, 5);
+            display.println(F("Dose Model"));
+            display.println();
+            if(this->_doseModel == NULL) {
+                display.println(F("Not available"));
+            } else {
+                display.print(F("Gain: "));
+                display.print(this->_doseModel->gain(), 3);
+                display.println(F(" pH/ml"));
+                display.print(F("+/-:  "));
+                display.println(this->_doseModel->gainError(), 3);
+                display.print(F("Doses: "));
+                display.println(this->_doseModel->samples());
+                display.print(F("Single shot: "));
+                if(this->_doseModel->confident()) {
+                    display.println(F("ready"));
+                } else {
+                    display.println(F("learning"));
+                }
+            }
+            display.display();
+        } else if(mode >= 40 && mode <= 42) {
+            this->_enterCalibrationFlag = 1;
+            drawTrend(mode - 40);
+        } else if(mode == 43) {
+            this->_enterCalibrationFlag = 1;
+            const StatsData &counted = stats.get();
+            display.clearDisplay();
+            display.setTextSize(1);
+            display.setCursor(0, 5);
+            display.println(F("Statistics"));
+            display.println();
+            display.print(F("Doses: "));
+            display.print(counted.doses);
+            display.print(F(" ("));
+            display.print(counted.aborted);
+            display.println(F(" cut)"));
+            display.print(F("Acid: "));
+            display.print(counted.ml, 1);
+            display.println(F(" ml"));
+            display.print(F("Pump: "));
+            display.print((float)(counted.pumpMs / 1000) / 3600.0, 2);
+            display.println(F(" h"));
+            display.print(F("Samples: "));
+            display.println(counted.samples);
+            display.print(F("Calibrations: "));
+            display.println(counted.calibrations);
+            display.display();
         }
-    clearDisplay = true;
 
 }
 
+void DFRobot_PH::drawTrend(byte tier)
+{
+    const int16_t top = 10;                     //chart below one line of text
+    const int16_t height = Board::screenHeight - top;
+    display.clearDisplay();
+    display.setTextSize(1);
+    display.setCursor(0, 0);
+    display.print(F("pH "));
+    display.print(TrendLog::tierName(tier));
+    int16_t low, high;
+    if(this->_trendLog == NULL) {
+        display.print(F("  not available"));
+        display.display();
+        return;
+    }
+    this->_trendLog->update(millis());
+    if(!this->_trendLog->range(tier, low, high)) {
+        display.print(F("  no data yet"));
+        display.display();
+        return;
+    }
+    int16_t target = round(this->_settings->get().targetPh * 100);
+    low = min(low, target);
+    high = max(high, target);
+    if(high - low < 20) {                       //at least 0.2 pH across the chart
+        low -= (20 - (high - low)) / 2;
+        high = low + 20;
+    }
+    display.print(F("  "));
+    display.print(low / 100.0, 2);
+    display.print(F("-"));
+    display.print(high / 100.0, 2);
+    int16_t span = high - low;
+    int16_t targetY = top + (int32_t)(high - target) * (height - 1) / span;
+    for(int16_t x = 0; x < Board::screenWidth; x += 4) {
+        display.drawPixel(x, targetY, WHITE);   //dotted target line
+    }
+    for(byte i = 0; i < TREND_COLUMNS && i < Board::screenWidth; i++) {
+        TrendColumn c = this->_trendLog->column(tier, i);
+        if(c.min == TREND_EMPTY) {
+            continue;
+        }
+        int16_t yMax = top + (int32_t)(high - c.max) * (height - 1) / span;
+        int16_t yMin = top + (int32_t)(high - c.min) * (height - 1) / span;
+        display.drawFastVLine(i, yMax, yMin - yMax + 1, WHITE);
+    }
+    display.display();
+}
+
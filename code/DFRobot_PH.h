@@ -19,10 +19,12 @@
 #include "WProgram.h"
 #endif
 
-#include <Adafruit_GFX.h>
-#include <Adafruit_SSD1306.h>
+#include "Settings.h"
+#include "DoseModel.h"
+#include "TrendLog.h"
+#include "GravityPump.h"
 
-#define ReceivedBufferLength 10  //length of the Serial CMD buffer
+#define ReceivedBufferLength 104 //length of the Serial CMD buffer, holds IMPORT and a settings blob with a full flow curve
 
 class DFRobot_PH
 {
@@ -51,34 +53,83 @@ public:
    * @return The PH value
    */
   float   readPH(float voltage, float temperature, bool isDosing); 
+  /**
+   * @fn toPH
+   * @brief Convert voltage to PH with temperature compensation, without drawing
+   *
+   * @param voltage     : Voltage value
+   * @param temperature : Ambient temperature
+   * @return The PH value
+   */
+  float   toPH(float voltage, float temperature);
+  /**
+   * @fn showReading
+   * @brief Show a pH on the main screen, a filtered one or one known from before a warm reset
+   *
+   * @param ph          : pH value
+   * @param temperature : Ambient temperature
+   * @param isDosing    : Show the dosing mark
+   * @param uncertainty : Standard deviation of the pH, NAN to leave it out
+   */
+  void    showReading(float ph, float temperature, bool isDosing, float uncertainty = NAN);
   /**
    * @fn begin
    * @brief Initialization The Analog pH Sensor
+   *
+   * @param settings : Loaded settings, read for calibration and target, written when a menu saves
+   */
+  void begin(Settings &settings);
+  /**
+   * @fn setDoseModel
+   * @brief Learned dose response shown on the diagnostics screen
+   */
+  void setDoseModel(DoseModel &model);
+  /**
+   * @fn setTrendLog
+   * @brief pH history drawn on the trend screens
+   */
+  void setTrendLog(TrendLog &trend);
+  /**
+   * @fn setPump
+   * @brief Pump calibrated at several speeds by the PUMPCAL serial command
+   */
+  void setPump(GravityPump &pump);
+  /**
+   * @fn serviceDisplay
+   * @brief Send the next changed part of the screen, call every loop
+   * @return true while more of the frame is waiting
    */
-  void begin();
+  bool serviceDisplay();
   
 
 private:
     float  _phValue;
-    float  _acidVoltage;
-    float  _neutralVoltage;
     float  _voltage;
     float  _temperature;
-    float  _targetPh;
-    float   _isF;
-    float  _flowRate;
-    int    _pumpSpeed;
-    float  _pumpAmount;
-    float   _pumpWait;
-    float  _flowMl;
-    float  _phBuff;
+    bool   _isDosing;           //last reading shown, redrawn when SET changes the target
+    float  _uncertainty;
+    Settings *_settings;
+    SettingsData _edit;     //value being changed in a menu, committed to _settings on save
+    DoseModel *_doseModel;
+    TrendLog *_trendLog;
+    GravityPump *_pump;
+    boolean _calibrationFinish;     //a buffer was recognized since entering pH calibration
+    boolean _enterCalibrationFlag;  //a menu screen is shown, the main screen is not redrawn
+    char   _valueText[10];          //number being edited, as drawn
 
     char   _cmdReceivedBuffer[ReceivedBufferLength];  //store the Serial CMD
     byte   _cmdReceivedBufferIndex;
 
 private:
     boolean cmdSerialDataAvailable();
+    bool    systemCommand();        //EXPORT, IMPORT <blob>, SET, STATS, TRACE, BUS, HEAP, CAPTURE, MIRROR, FLOW and PUMPCAL, handled on every board
     void    phCalibration(int mode); // calibration process, wirte key parameters to EEPROM
+    void    saveSetting(uint16_t field);
+    void    drawReading(float temperature, bool isDosing, float uncertainty);    //main screen
+    void    drawPumpMenu(byte selected);
+    void    drawTrend(byte tier);
+    bool    showTemplate(int screen);   //copy a pre-rendered screen into the frame buffer, false when there is none
+    void    drawValueScreen(int screen, const __FlashStringHelper *label, float value, int16_t valueY);
     byte    cmdParse(const char* cmd);
     byte    cmdParse();
 	char* strupr(char* str);
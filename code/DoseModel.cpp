@@ -0,0 +1,97 @@
+#include "DoseModel.h"
+#include "Settings.h"
+#include <EEPROM.h>
+
+#define DOSEMODEL_MAGIC 0xD05E
+
+DoseModel::DoseModel()
+{
+    reset();
+    this->_dirty = false;
+}
+
+void DoseModel::begin()
+{
+    DoseModelData stored;
+    byte *p = (byte*)&stored;
+    for(byte i = 0; i < sizeof(stored); i++) {
+        p[i] = EEPROM.read(DOSEMODELADDRESS + i);
+    }
+    if(stored.magic == DOSEMODEL_MAGIC && !isnan(stored.gain) && stored.covariance > 0) {
+        this->_data = stored;
+    }
+}
+
+void DoseModel::update(float ml, float deltaPh)
+{
+    if(ml <= 0) {
+        return;
+    }
+    //scalar recursive least squares for deltaPh = gain * ml
+    float error = deltaPh - this->_data.gain * ml;
+    float p = this->_data.covariance;
+    float k = p * ml / (DOSE_FORGETTING + ml * p * ml);
+    this->_data.gain += k * error;
+    this->_data.covariance = (p - k * ml * p) / DOSE_FORGETTING;
+    if(this->_data.samples == 0) {
+        this->_data.residual = error * error;
+    } else {
+        this->_data.residual = DOSE_FORGETTING * this->_data.residual + (1.0 - DOSE_FORGETTING) * error * error;
+    }
+    if(this->_data.samples < 0xFFFF) {
+        this->_data.samples++;
+    }
+    this->_dirty = true;
+}
+
+void DoseModel::save()
+{
+    if(!this->_dirty) {
+        return;
+    }
+    const byte *p = (const byte*)&this->_data;
+    for(byte i = 0; i < sizeof(this->_data); i++) {
+        EEPROM.write(DOSEMODELADDRESS + i, p[i]);
+    }
+    EEPROM.commit();
+    this->_dirty = false;
+}
+
+void DoseModel::reset()
+{
+    this->_data.magic = DOSEMODEL_MAGIC;
+    this->_data.samples = 0;
+    this->_data.gain = 0;
+    this->_data.covariance = DOSE_INITIAL_COVARIANCE;
+    this->_data.residual = 0;
+    this->_dirty = true;
+}
+
+float DoseModel::gain() const
+{
+    return this->_data.gain;
+}
+
+float DoseModel::gainError() const
+{
+    return sqrt(this->_data.covariance * this->_data.residual);
+}
+
+uint16_t DoseModel::samples() const
+{
+    return this->_data.samples;
+}
+
+bool DoseModel::confident() const
+{
+    return this->_data.samples >= DOSE_MIN_SAMPLES && this->_data.gain < 0
+        && gainError() < -this->_data.gain * DOSE_MAX_RELATIVE_ERROR;
+}
+
+float DoseModel::doseFor(float deltaPh) const
+{
+    if(this->_data.gain >= 0 || deltaPh >= 0) {
+        return 0;
+    }
+    return deltaPh / this->_data.gain;
+}
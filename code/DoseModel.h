@@ -0,0 +1,41 @@
+#ifndef _DOSEMODEL_H_
+#define _DOSEMODEL_H_
+
+#include <Arduino.h>
+
+#define DOSE_FORGETTING 0.95        //RLS forgetting factor, lower adapts faster to a changing tank
+#define DOSE_INITIAL_COVARIANCE 1.0 //(pH/ml)^2, prior uncertainty of the gain
+#define DOSE_MIN_SAMPLES 3          //doses needed before the model is trusted
+#define DOSE_MAX_RELATIVE_ERROR 0.3 //trusted when the gain standard error is below 30% of the gain
+
+struct DoseModelData
+{
+    uint16_t magic;
+    uint16_t samples;       //doses learned from
+    float gain;             //pH change per ml, negative for acid
+    float covariance;       //RLS P, gain variance per unit residual variance
+    float residual;         //running mean of the squared prediction error, pH^2
+};
+
+class DoseModel
+{
+public:
+    DoseModel();
+
+    void begin();                           //load the learned model from the EEPROM
+    void update(float ml, float deltaPh);   //one dose and the pH change it caused
+    void save();                            //write to the EEPROM if anything was learned since the last save
+    void reset();
+
+    float gain() const;
+    float gainError() const;                //standard error of the gain, pH/ml
+    uint16_t samples() const;
+    bool confident() const;
+    float doseFor(float deltaPh) const;     //ml expected to move the pH by deltaPh, 0 when the model can't tell
+
+private:
+    DoseModelData _data;
+    bool _dirty = false;
+};
+
+#endif
@@ -0,0 +1,117 @@
+#include "DosingController.h"
+
+DosingController::DosingController()
+{
+}
+
+void DosingController::setDoseModel(DoseModel *model)
+{
+    this->_model = model;
+}
+
+bool DosingController::due(unsigned long now, bool idle, const SettingsData &config) const
+{
+    if(this->_restart) {
+        return true;
+    }
+    float wait = this->_dosing ? this->_doseWait : config.pumpWait;
+    return idle && now - this->_measuredAt > wait * 60000UL;
+}
+
+float DosingController::measured(unsigned long now, float ph, float probePh, const SettingsData &config)
+{
+    this->_restart = false;
+    this->_measuredAt = now;
+    //readings during a dosing run come WAIT_BETWEEN_DOSE after the dose,
+    //before the acid has mixed in, and would teach the model too small a gain
+    this->_settled = !this->_dosed || now - this->_doseEndAt >= config.pumpWait * 60000UL;
+    if(this->_model != NULL && this->_doseMl > 0 && this->_settled) {
+        this->_model->update(this->_doseMl, probePh - this->_dosePh);
+        this->_doseMl = 0;
+    }
+    if(ph - config.phBuff > config.targetPh) {
+        this->_dosing = true;
+        float ml = config.pumpAmount;
+#if SINGLE_SHOT_DOSE
+        //every dose mixes in for pumpWait, so each one is learned from and a
+        //shot is judged on its full effect before the next
+        this->_doseWait = config.pumpWait;
+        if(this->_model != NULL && this->_model->confident()) {
+            ml = this->_model->doseFor((config.targetPh - ph) * SINGLE_SHOT_FRACTION);
+            ml = constrain(ml, config.pumpAmount, config.pumpAmount * SINGLE_SHOT_MAX_DOSES);
+        }
+#else
+        this->_doseWait = WAIT_BETWEEN_DOSE;
+#endif
+        return ml;
+    }
+    if(this->_dosing) {
+        this->_dosing = false;
+        this->_reached = true;
+        this->_restart = true;
+    }
+    return 0;
+}
+
+void DosingController::doseStarted(float ml, float probePh, unsigned long runTimeMs)
+{
+    this->_doseMl = this->_settled ? ml : 0;    //acid still mixing in from the dose before would be counted too
+    this->_dosePh = probePh;
+    this->_dosed = true;
+    this->_doseEndAt = this->_measuredAt + runTimeMs;
+    this->_doseWait += runTimeMs / 60000.0;    //measure once the dose has run and mixed
+}
+
+void DosingController::delivered(float ml)
+{
+    if(this->_doseMl > 0) {
+        this->_doseMl = ml;
+    }
+}
+
+bool DosingController::reachedTarget()
+{
+    bool reached = this->_reached;
+    this->_reached = false;
+    return reached;
+}
+
+void DosingController::restart()
+{
+    this->_restart = true;
+}
+
+void DosingController::stop()
+{
+    this->_dosing = false;
+    this->_doseMl = 0;
+}
+
+bool DosingController::isDosing() const
+{
+    return this->_dosing;
+}
+
+void DosingController::snapshot(unsigned long now, DosingSnapshot &out) const
+{
+    out.dosing = this->_dosing;
+    out.restart = this->_restart;
+    out.sinceMeasuredMs = now - this->_measuredAt;
+    out.dosed = this->_dosed;
+    out.sinceDoseEndMs = now - this->_doseEndAt;
+    out.doseWait = this->_doseWait;
+    out.doseMl = this->_doseMl;
+    out.dosePh = this->_dosePh;
+}
+
+void DosingController::resume(unsigned long now, const DosingSnapshot &in)
+{
+    this->_dosing = in.dosing;
+    this->_restart = in.restart;
+    this->_measuredAt = now - in.sinceMeasuredMs;   //the time the reset itself took is not counted
+    this->_dosed = in.dosed;
+    this->_doseEndAt = now - in.sinceDoseEndMs;
+    this->_doseWait = in.doseWait;
+    this->_doseMl = in.doseMl;
+    this->_dosePh = in.dosePh;
+}
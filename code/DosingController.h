@@ -0,0 +1,62 @@
+#ifndef _DOSINGCONTROLLER_H_
+#define _DOSINGCONTROLLER_H_
+
+#include <Arduino.h>
+#include "Settings.h"
+#include "DoseModel.h"
+
+#define WAIT_BETWEEN_DOSE 0.17      //minutes to mix after a dose has run
+#define SINGLE_SHOT_DOSE 0          //1 = once the dose model is trusted, deliver most of the correction in one dose
+#define SINGLE_SHOT_FRACTION 0.8    //part of the predicted correction given in one shot
+#define SINGLE_SHOT_MAX_DOSES 4     //a single shot is at most this many pumpAmount doses
+
+struct DosingSnapshot                       //what a warm reset needs to carry on, see WarmState
+{
+    bool dosing;
+    bool restart;
+    uint32_t sinceMeasuredMs;
+    bool dosed;
+    uint32_t sinceDoseEndMs;
+    float doseWait;
+    float doseMl;
+    float dosePh;
+};
+
+//When to measure and how much acid to give. No hardware and no globals, so
+//tools/sweep can run many of them side by side.
+class DosingController
+{
+public:
+    DosingController();
+
+    void setDoseModel(DoseModel *model);    //learns from doses with a pumpWait of mixing on both sides, optional
+    bool due(unsigned long now, bool idle, const SettingsData &config) const;
+                                            //measure now, idle = no menu open and no button held
+    float measured(unsigned long now, float ph, float probePh, const SettingsData &config);
+                                            //ml to dose, 0 for none. ph decides, the model learns from
+                                            //probePh, the raw reading, never from an estimate it shaped
+    void doseStarted(float ml, float probePh, unsigned long runTimeMs);
+    void delivered(float ml);               //the dose was cut short, only this much went in
+    bool reachedTarget();                   //true once when a dosing run has brought the pH down
+    void restart();                         //measure at the next due(), whatever the wait
+    void stop();                            //abandon the dosing run
+    bool isDosing() const;
+    void snapshot(unsigned long now, DosingSnapshot &out) const;
+    void resume(unsigned long now, const DosingSnapshot &in);
+                                            //continue the wait and dosing run saved before a reset
+
+private:
+    DoseModel *_model = NULL;
+    bool _dosing = false;
+    bool _restart = true;
+    bool _reached = false;
+    unsigned long _measuredAt = 0;
+    float _doseWait = WAIT_BETWEEN_DOSE;    //minutes until the pH is measured after a dose
+    float _doseMl = 0;                      //last dose, learned from at the next settled measurement, 0 when it can't be
+    float _dosePh = 0;                      //pH when the last dose started
+    bool _dosed = false;                    //a dose has run since the start
+    bool _settled = true;                   //the last measurement came pumpWait or more after a dose
+    unsigned long _doseEndAt = 0;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "EspAdc.h"
+
+volatile uint32_t EspAdc::_framesDone = 0;
+
+EspAdc::EspAdc(uint8_t pin) : _pin(pin)
+{
+}
+
+bool EspAdc::begin()
+{
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+    uint8_t pins[] = {this->_pin};
+    analogContinuousSetAtten(ADC_11db);     //0 to about 3.1 V, the probe board's whole output
+    analogContinuousSetWidth(12);
+    if(!analogContinuous(pins, 1, ESP_ADC_OVERSAMPLE, ESP_ADC_SAMPLE_HZ, frameDone)) {
+        return false;
+    }
+    this->_continuous = analogContinuousStart();
+    return this->_continuous;
+#else
+    analogSetPinAttenuation(this->_pin, ADC_11db);
+    return true;
+#endif
+}
+
+void IRAM_ATTR EspAdc::frameDone()
+{
+    _framesDone = _framesDone + 1;          //from the driver's interrupt, service() reads the frames
+}
+
+void EspAdc::service()
+{
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+    if(this->_continuous) {
+        uint32_t done = _framesDone;
+        adc_continuous_data_t *result = NULL;
+        while(this->_framesRead != done) {  //a slow loop finds several, each one is read
+            if(!analogContinuousRead(&result, 0)) {
+                this->_framesRead = done;   //the driver's ring was full and dropped some
+                break;
+            }
+            this->_framesRead++;
+            add(result[0].avg_read_mvolts);
+        }
+        return;
+    }
+#endif
+    uint32_t sum = 0;
+    for(byte i = 0; i < ESP_ADC_POLLED; i++) {
+        sum += analogReadMilliVolts(this->_pin);
+    }
+    add((float)sum / ESP_ADC_POLLED);
+}
+
+float EspAdc::readMillivolts()
+{
+    if(!isnan(this->_block)) {
+        return this->_block;
+    }
+    if(this->_count > 0) {
+        return this->_sum / this->_count;
+    }
+    return analogReadMilliVolts(this->_pin);    //right after begin(), no frame yet
+}
+
+void EspAdc::add(float millivolts)
+{
+    this->_sum += millivolts;
+    this->_frames++;
+    if(++this->_count >= ESP_ADC_BLOCK) {
+        this->_block = this->_sum / this->_count;
+        this->_blocks++;
+        this->_sum = 0;
+        this->_count = 0;
+    }
+}
+
+uint32_t EspAdc::frames() const
+{
+    return this->_frames;
+}
+
+uint32_t EspAdc::blocks() const
+{
+    return this->_blocks;
+}
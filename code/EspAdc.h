@@ -0,0 +1,46 @@
+#ifndef _ESPADC_H_
+#define _ESPADC_H_
+
+#include <Arduino.h>
+#include "PhAdc.h"
+
+#define ESP_ADC_SAMPLE_HZ 20000     //DMA conversion rate
+#define ESP_ADC_OVERSAMPLE 64       //conversions the driver averages into one frame result
+#define ESP_ADC_BLOCK 32            //frame results averaged into one reading, about 10 readings/s
+#define ESP_ADC_POLLED 8            //cores without analogContinuous(): eFuse calibrated reads per service()
+
+//The ESP32's internal ADC as the probe input for boards without an
+//ADS1115. The ADC runs continuously into DMA at ESP_ADC_SAMPLE_HZ, the
+//driver averages ESP_ADC_OVERSAMPLE conversions per frame and converts
+//them to mV with the eFuse calibration, service() collects the frames and
+//readMillivolts() returns the mean of the last ESP_ADC_BLOCK of them. Each
+//reading averages about 2000 conversions, which brings the few mV of noise
+//of the internal ADC down near the ADS1115's.
+class EspAdc : public PhAdc
+{
+public:
+    EspAdc(uint8_t pin);
+
+    bool begin();                           //start the DMA conversions, false if the driver refused
+    void service() override;                //collect every frame finished since the last call, every loop
+    float readMillivolts() override;        //mean of the last full block, before the first one of what there is
+    void add(float millivolts);             //one frame result, also fed by tools/bench/adc.cpp
+
+    uint32_t frames() const;                //frame results collected
+    uint32_t blocks() const;
+
+private:
+    static void IRAM_ATTR frameDone();
+
+    uint8_t _pin;
+    bool _continuous = false;
+    float _sum = 0;
+    uint16_t _count = 0;
+    float _block = NAN;
+    uint32_t _frames = 0;
+    uint32_t _blocks = 0;
+    uint32_t _framesRead = 0;               //of _framesDone
+    static volatile uint32_t _framesDone;   //counted by the driver's interrupt
+};
+
+#endif
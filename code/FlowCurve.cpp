@@ -0,0 +1,177 @@
+#include "FlowCurve.h"
+#include "Settings.h"
+#include <EEPROM.h>
+
+#define FLOWCURVE_MAGIC 0xF10C
+
+static int offset(int speed)
+{
+    return abs(speed - FLOW_SERVO_STOP);
+}
+
+FlowCurve::FlowCurve()
+{
+    reset();
+    this->_dirty = false;
+}
+
+void FlowCurve::begin()
+{
+    FlowCurveData stored;
+    byte *p = (byte*)&stored;
+    for(byte i = 0; i < sizeof(stored); i++) {
+        p[i] = EEPROM.read(FLOWCURVEADDRESS + i);
+    }
+    if(stored.magic != FLOWCURVE_MAGIC || stored.count > FLOW_CURVE_POINTS) {
+        return;
+    }
+    for(byte i = 0; i < stored.count; i++) {
+        if(isnan(stored.rate[i]) || stored.rate[i] <= 0) {
+            return;
+        }
+    }
+    this->_data = stored;
+}
+
+void FlowCurve::save(bool commit)
+{
+    if(!this->_dirty) {
+        return;
+    }
+    const byte *p = (const byte*)&this->_data;
+    for(byte i = 0; i < sizeof(this->_data); i++) {
+        EEPROM.write(FLOWCURVEADDRESS + i, p[i]);
+    }
+    if(commit) {
+        EEPROM.commit();
+    }
+    this->_dirty = false;
+}
+
+void FlowCurve::reset()
+{
+    memset(&this->_data, 0, sizeof(this->_data));
+    this->_data.magic = FLOWCURVE_MAGIC;
+    this->_dirty = true;
+}
+
+void FlowCurve::replace(byte count, const uint8_t *speed, const float *rate)
+{
+    reset();
+    for(byte i = 0; i < count && i < FLOW_CURVE_POINTS; i++) {
+        setPoint(speed[i], rate[i]);        //keeps them ordered
+    }
+    this->_oldest = 0;
+}
+
+bool FlowCurve::validPoint(int speed, float mlPerSecond)
+{
+    return speed >= 0 && speed <= 180 && speed != FLOW_SERVO_STOP && isfinite(mlPerSecond) && mlPerSecond > 0;
+}
+
+void FlowCurve::setPoint(int speed, float mlPerSecond)
+{
+    if(!validPoint(speed, mlPerSecond)) {
+        return;
+    }
+    byte at = 0;
+    while(at < this->_data.count && this->_data.speed[at] != speed) {
+        at++;
+    }
+    if(at == this->_data.count) {
+        if(this->_data.count < FLOW_CURVE_POINTS) {
+            this->_data.count++;
+        } else {
+            at = this->_oldest;
+            this->_oldest = (this->_oldest + 1) % FLOW_CURVE_POINTS;
+        }
+    }
+    this->_data.speed[at] = speed;
+    this->_data.rate[at] = mlPerSecond;
+    for(byte i = 1; i < this->_data.count; i++) {     //keep them ordered by distance from stop, a handful at most
+        for(byte j = i; j > 0 && offset(this->_data.speed[j]) < offset(this->_data.speed[j - 1]); j--) {
+            uint8_t s = this->_data.speed[j];
+            float r = this->_data.rate[j];
+            this->_data.speed[j] = this->_data.speed[j - 1];
+            this->_data.rate[j] = this->_data.rate[j - 1];
+            this->_data.speed[j - 1] = s;
+            this->_data.rate[j - 1] = r;
+        }
+    }
+    this->_dirty = true;
+}
+
+byte FlowCurve::count() const
+{
+    return this->_data.count;
+}
+
+int FlowCurve::speed(byte index) const
+{
+    return this->_data.speed[index];
+}
+
+float FlowCurve::rate(byte index) const
+{
+    return this->_data.rate[index];
+}
+
+bool FlowCurve::sameDirection(int speed, int pumpSpeed)
+{
+    return (speed - FLOW_SERVO_STOP) * (pumpSpeed - FLOW_SERVO_STOP) > 0;
+}
+
+float FlowCurve::rateAt(int speed) const
+{
+    const FlowCurveData &d = this->_data;
+    int x = offset(speed);
+    int x0 = 0;
+    float r0 = 0;
+    for(byte i = 0; i < d.count; i++) {
+        if(!sameDirection(d.speed[i], speed)) {
+            continue;
+        }
+        int x1 = offset(d.speed[i]);
+        if(x <= x1) {
+            return r0 + (d.rate[i] - r0) * (x - x0) / (x1 - x0);
+        }
+        x0 = x1;
+        r0 = d.rate[i];
+    }
+    return r0;                              //faster than any calibrated point, the pump is near saturation there
+}
+
+bool FlowCurve::plan(float ml, int pumpSpeed, DosePlan &plan) const
+{
+    const FlowCurveData &d = this->_data;
+    int slow = -1;
+    int fast = -1;
+    for(byte i = 0; i < d.count; i++) {     //ordered by distance from stop, the first is the slowest
+        if(sameDirection(d.speed[i], pumpSpeed)) {
+            if(slow < 0) {
+                slow = i;
+            }
+            fast = i;
+        }
+    }
+    if(slow == fast || ml < FLOW_PLAN_MIN_ML) {
+        return false;
+    }
+    float fineMl = min(ml, (float)FLOW_FINE_ML);
+    unsigned long coarseMs = 1000 * (ml - fineMl) / d.rate[fast];
+    if(coarseMs < FLOW_MIN_PHASE_MS) {
+        coarseMs = 0;
+        fineMl = ml;
+    }
+    plan.coarseSpeed = d.speed[fast];
+    plan.coarseMs = coarseMs;
+    plan.fineSpeed = d.speed[slow];
+    plan.fineMs = 1000 * fineMl / d.rate[slow];
+    if(coarseMs > 0) {
+        plan.coarseMs += FLOW_START_MS;     //a 15 s calibration hardly sees the spin-up and run-down, a short phase does
+    } else {
+        plan.fineMs += FLOW_START_MS;
+    }
+    plan.fineMs = plan.fineMs > FLOW_STOP_MS ? plan.fineMs - FLOW_STOP_MS : 1;
+    return true;
+}
@@ -0,0 +1,70 @@
+#ifndef _FLOWCURVE_H_
+#define _FLOWCURVE_H_
+
+#include <Arduino.h>
+
+#define FLOW_CURVE_POINTS 4         //calibrated servo speeds kept
+#define FLOW_SERVO_STOP 90          //servo value that stops the pump, no flow
+#define FLOW_FINE_ML 0.5            //end of a dose given at the slowest calibrated speed
+#define FLOW_MIN_PHASE_MS 400       //shorter runs are mostly servo start and stop, not worth a fast phase
+#define FLOW_PLAN_MIN_ML 0.15       //smaller doses run at the single speed, the spin-up of a slow start outweighs the plan
+//Spin-up and run-down are typical figures for an MG996R style servo pump,
+//not measured on this pump: the 15 s calibration can't separate them from
+//the flow rate. The dose_volume bench shows what an error in them costs.
+#define FLOW_START_MS 120           //servo spin-up with no flow yet, added to the first phase
+#define FLOW_STOP_MS 40             //flow after the stop while the servo runs down, taken off the last phase
+
+struct FlowCurveData
+{
+    uint16_t magic;
+    uint8_t count;
+    uint8_t reserved;
+    uint8_t speed[FLOW_CURVE_POINTS];   //ascending distance from FLOW_SERVO_STOP
+    float rate[FLOW_CURVE_POINTS];      //ml/s
+};
+
+struct DosePlan                     //fast for the bulk, slow for the end
+{
+    int coarseSpeed;
+    unsigned long coarseMs;         //0 = no fast phase
+    int fineSpeed;
+    unsigned long fineMs;
+};
+
+//Flow rate of the pump against the servo speed, linear between the
+//calibrated points and down to no flow at the stop value. Points on the two
+//sides of the stop value are kept apart, they pump in opposite directions.
+//With two or more points on the pumpSpeed side a dose is planned as a fast
+//phase at the fastest calibrated speed and a slow finish at the slowest.
+//The plan is for volume accuracy, not time: the slow finish costs about a
+//second on small doses and the fast phase saves little on large ones when
+//pumpSpeed is already near saturation, see tools/bench/dose_volume.cpp.
+class FlowCurve
+{
+public:
+    FlowCurve();
+
+    void begin();                           //load from the EEPROM
+    void save(bool commit = true);          //false = left for the next EEPROM commit, see Settings::importText()
+    void reset();
+    void replace(byte count, const uint8_t *speed, const float *rate);  //every point at once, from a settings blob
+    void setPoint(int speed, float mlPerSecond);    //replaces a point at the same speed, the oldest beyond FLOW_CURVE_POINTS
+
+    byte count() const;
+    int speed(byte index) const;
+    float rate(byte index) const;
+    float rateAt(int speed) const;          //ml/s, interpolated, 0 with no points on that side
+    bool plan(float ml, int pumpSpeed, DosePlan &plan) const;
+                                            //false with fewer than two points on the pumpSpeed side
+                                            //or below FLOW_PLAN_MIN_ML, dose at pumpSpeed then
+
+    static bool sameDirection(int speed, int pumpSpeed);   //both on one side of FLOW_SERVO_STOP
+    static bool validPoint(int speed, float mlPerSecond);
+
+private:
+    FlowCurveData _data;
+    byte _oldest = 0;                       //point replaced next when full
+    bool _dirty = false;
+};
+
+#endif
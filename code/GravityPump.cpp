@@ -1,30 +1,10 @@
 #include "GravityPump.h"
-#include <EEPROM.h>
+#include "BoardProfile.h"
+#include "Trace.h"
 
-#define FLOWRATEADDRESS 0x24    //EEPROM address for flowrate, for more pump need to add more address. 
-#define PUMPSPEEDADDRESS 0x28   //EEPROM address for speed, for more pump need to add more address.
 #define CALIBRATIONTIME 15      //when Calibration pump running time, unit secend
 #define ReceivedBufferLength 20
-
-template <typename T>
-void EEPROM_read(int address, T &p) {
-    byte *pp = (byte*)&p;
-    for (int i = 0; i < sizeof(p); i++) {
-        pp[i] = EEPROM.read(address + i);
-    }
-}
-
-template <typename T>
-void EEPROM_write(int address, const T &p) {
-    const byte *pp = (const byte*)&p;
-    for (int i = 0; i < sizeof(p); i++) {
-        EEPROM.write(address + i, pp[i]);
-    }
-    EEPROM.commit(); // Ensure changes are saved
-}
-
-#define PHVALUEADDR 0x00    //the start address of the pH calibration parameters stored in the EEPROM
-
+#define BUDGET_REARM 0.1        //share of the hourly budget back before "Dose budget reached" is printed again
 
 GravityPump::GravityPump()
 {
@@ -38,27 +18,89 @@ GravityPump::~GravityPump()
 
 void GravityPump::setPin(int pin)   //pump pin setting
 {
-    EEPROM.begin(512);
     this->_pin = pin;
     this->_pumpServo.attach(this->_pin);
 }
 
-void GravityPump::getFlowRateAndSpeed()      //flowrate and speed reading from EEPROM
+void GravityPump::setSettings(Settings &settings)
+{
+    this->_settings = &settings;
+}
+
+void GravityPump::setFlowCurve(FlowCurve &curve)
 {
-    EEPROM_read(FLOWRATEADDRESS, this->_flowRate);
-    if(isnan(this->_flowRate)  || this->_pumpSpeed < 0.05) {
-      this->_flowRate = 0.6;
+    this->_curve = &curve;
+}
+
+void GravityPump::setStats(Stats &stats)
+{
+    this->_stats = &stats;
+}
+
+void GravityPump::update()      //get the state from system, need to be put in the loop.
+{
+    if(this->_emergency)
+    {
+        this->_emergency = false;
+        stop();                                 //the guard task only stopped the servo, drop the jobs here
     }
-    delay(5);
-    EEPROM_read(PUMPSPEEDADDRESS, this->_pumpSpeed);
-    if(isnan(this->_pumpSpeed) || this->_pumpSpeed < 0) {
-      this->_pumpSpeed = 160;
+    if(this->_runFlag && this->_fineTime > 0 && millis() - this->_startTime >= this->_intervalTime)
+    {
+        count(this->_intervalTime);
+        TRACE_INSTANT(TRACK_PUMP, "fine", this->_fineSpeed);
+        this->_speed = this->_fineSpeed;        //fast phase done, finish slowly
+        this->_intervalTime = this->_fineTime;
+        this->_startTime = millis();
+        this->_fineTime = 0;
+    }
+    if(!this->_runFlag && !this->_stopFlag)
+    {
+        startNext();
     }
+    pumpDriver(this->_speed,this->_intervalTime);
 }
 
-void GravityPump::update()      //get the state from system, need to be put in the loop.
+void GravityPump::start(int speed, unsigned long runTime)
+{
+    TRACE_BEGIN(TRACK_PUMP, "run");
+    TRACE_INSTANT(TRACK_PUMP, "speed", speed);
+    this->_runFlag = true;
+    this->_speed = speed;
+    this->_fineTime = 0;
+    this->_intervalTime = runTime;
+    this->_startTime = millis();
+}
+
+float GravityPump::runningRate()
 {
-    pumpDriver(this->_pumpSpeed,this->_intervalTime);
+    return rateAt(this->_speed);
+}
+
+float GravityPump::rateAt(int speed)
+{
+    if(this->_curve != NULL && this->_curve->count() >= 2 && this->_curve->rateAt(speed) > 0)
+    {
+        return this->_curve->rateAt(speed);
+    }
+    return this->_settings->get().flowRate;
+}
+
+void GravityPump::count(unsigned long ms)
+{
+    float ml = runningRate() * ms / 1000.0;
+    if(this->_running >= 0)
+    {
+        DoseJob &job = this->_jobs[this->_running];
+        job.delivered += ml;
+        if(job.speed >= 0)
+        {
+            job.runMs -= min(ms, job.runMs);
+        }
+    }
+    if(this->_stats != NULL)
+    {
+        this->_stats->pumped(ms, ml);
+    }
 }
 
 void GravityPump::pumpDriver(int speed, unsigned long runTime)      //the basic pump function, have to given speed in number(0 to 180. 90 for stop, 
@@ -66,6 +108,13 @@ void GravityPump::pumpDriver(int speed, unsigned long runTime)      //the basic
 {
     if(this->_stopFlag || millis() - this->_startTime >= runTime)
     {
+        if(this->_runFlag)
+        {
+            count(runTime);                     //ran to the end, stop() counts its own
+            TRACE_END(TRACK_PUMP, "run");
+            this->_runFlag = false;
+            finish(DOSE_DONE);
+        }
         this->_runFlag = false;
         this->_stopFlag = false;
         this->_pumpServo.write(this->_servoStop);
@@ -77,37 +126,481 @@ void GravityPump::pumpDriver(int speed, unsigned long runTime)      //the basic
     }    
 }
 
-float GravityPump::flowPump(float quantitation)     //quantification setting pump function,base on the basic function.the function need to given a quantification. Then the pump will dosing the quantification
+uint16_t GravityPump::queueDose(float ml, byte priority, DoseCallback done)
+{
+    if(priority == DOSE_MANUAL && this->_running >= 0 && this->_runFlag && this->_fineTime == 0)
+    {
+        DoseJob &job = this->_jobs[this->_running];
+        float rate = runningRate();
+        if(job.speed < 0 && job.priority == priority && job.done == done && rate > 0)
+        {
+            //held button: the running top-up runs on, one job and one dose however long it is held
+            unsigned long left = this->_intervalTime - min(millis() - this->_startTime, this->_intervalTime);
+            float extra = takeBudget(max(0.0f, ml - rate * left / 1000));
+            job.ml += extra;
+            this->_intervalTime = 1000 * (job.ml - job.delivered) / rate + 0.5;   //delivered is counted when the phase ends
+            this->_lastDoseMl = extra;
+            return job.id;
+        }
+    }
+    for(byte i = 0; i < DOSE_QUEUE_LENGTH; i++)
+    {
+        DoseJob &job = this->_jobs[i];
+        if(job.id != 0 && job.state == DOSE_QUEUED && job.speed < 0 && job.priority == priority && job.done == done)
+        {
+            float extra = ml;
+            if(priority == DOSE_MANUAL)
+            {
+                extra = max(0.0f, ml - (job.ml - job.delivered));   //holding the button tops up, it does not pile up
+            }
+            extra = takeBudget(extra);
+            job.ml += extra;
+            this->_lastDoseMl = extra;
+            return job.id;
+        }
+    }
+    ml = takeBudget(ml);
+    if(ml <= 0)
+    {
+        return 0;
+    }
+    uint16_t id = add(priority, -1, ml, 0, done);
+    if(id == 0)
+    {
+        refund(ml);
+    }
+    this->_lastDoseMl = ml;
+    return id;
+}
+
+uint16_t GravityPump::queueTimed(int speed, unsigned long ms, byte priority, DoseCallback done)
+{
+    return add(priority, speed, 0, ms, done);
+}
+
+uint16_t GravityPump::add(byte priority, int speed, float ml, unsigned long ms, DoseCallback done)
+{
+    int8_t slot = -1;
+    for(byte i = 0; i < DOSE_QUEUE_LENGTH && slot < 0; i++)
+    {
+        if(this->_jobs[i].id == 0)
+        {
+            slot = i;
+        }
+    }
+    if(slot < 0)
+    {
+        Serial.println(F("Dose queue full"));
+        return 0;
+    }
+    if(++this->_nextId == 0)
+    {
+        this->_nextId = 1;
+    }
+    DoseJob &job = this->_jobs[slot];
+    job.id = this->_nextId;
+    job.priority = priority;
+    job.state = DOSE_QUEUED;
+    job.started = false;
+    job.speed = speed;
+    job.ml = ml;
+    job.delivered = 0;
+    job.runMs = ms;
+    job.done = done;
+    TRACE_INSTANT(TRACK_PUMP, "queued", job.id);
+    if(this->_running >= 0 && this->_runFlag && priority > this->_jobs[this->_running].priority)
+    {
+        suspend();                              //update() starts the more urgent job straight away
+    }
+    return job.id;
+}
+
+void GravityPump::suspend()
+{
+    DoseJob &job = this->_jobs[this->_running];
+    count(min(millis() - this->_startTime, this->_intervalTime));
+    TRACE_INSTANT(TRACK_PUMP, "suspend", job.id);
+    TRACE_END(TRACK_PUMP, "run");
+    job.state = DOSE_QUEUED;                    //runs what is left once the queue gets back to it
+    this->_running = -1;
+    this->_runFlag = false;
+    this->_fineTime = 0;
+}
+
+void GravityPump::startNext()
+{
+    int8_t next = -1;
+    for(byte i = 0; i < DOSE_QUEUE_LENGTH; i++)
+    {
+        const DoseJob &job = this->_jobs[i];
+        if(job.id != 0 && job.state == DOSE_QUEUED && (next < 0 || before(job, this->_jobs[next])))
+        {
+            next = i;
+        }
+    }
+    if(next < 0)
+    {
+        return;
+    }
+    DoseJob &job = this->_jobs[next];
+    this->_running = next;
+    job.state = DOSE_RUNNING;
+    if(!job.started && job.priority != DOSE_CALIBRATION && this->_stats != NULL)
+    {
+        this->_stats->dosed();
+    }
+    job.started = true;
+    if(job.speed >= 0)
+    {
+        start(job.speed, job.runMs);
+        return;
+    }
+    float ml = job.ml - job.delivered;
+    const SettingsData &settings = this->_settings->get();
+    DosePlan plan;
+    if(this->_curve != NULL && this->_curve->plan(ml, settings.pumpSpeed, plan))
+    {
+        start(plan.coarseMs > 0 ? plan.coarseSpeed : plan.fineSpeed, plan.coarseMs > 0 ? plan.coarseMs : plan.fineMs);
+        if(plan.coarseMs > 0)
+        {
+            this->_fineSpeed = plan.fineSpeed;
+            this->_fineTime = plan.fineMs;
+        }
+        return;
+    }
+    start(settings.pumpSpeed, 1000*(ml / rateAt(settings.pumpSpeed)));    //the rate count() and a top-up go by
+}
+
+void GravityPump::finish(byte state)
+{
+    DoseJob &job = this->_jobs[this->_running];
+    this->_running = -1;
+    end(job, state);
+}
+
+void GravityPump::end(DoseJob &job, byte state)
+{
+    if(job.speed < 0)
+    {
+        if(state == DOSE_DONE)
+        {
+            job.delivered = job.ml;             //the plan is made for the volume, the estimate only fills in cut runs
+        }
+        else
+        {
+            job.delivered = min(job.delivered, job.ml);
+            refund(job.ml - job.delivered);
+        }
+    }
+    job.state = state;
+    DoseJob report = job;
+    job.id = 0;                                 //free before the callback, it may queue the next dose
+    if(report.done != NULL)
+    {
+        report.done(report);
+    }
+}
+
+bool GravityPump::before(const DoseJob &a, const DoseJob &b)
+{
+    if(a.priority != b.priority)
+    {
+        return a.priority > b.priority;
+    }
+    return (int16_t)(a.id - b.id) < 0;          //first come first served, ids wrap
+}
+
+unsigned long GravityPump::estimateMs(const DoseJob &job)
+{
+    if(job.speed >= 0)
+    {
+        return job.runMs;
+    }
+    float ml = job.ml - job.delivered;
+    DosePlan plan;
+    if(this->_curve != NULL && this->_curve->plan(ml, this->_settings->get().pumpSpeed, plan))
+    {
+        return plan.coarseMs + plan.fineMs;
+    }
+    return 1000*(ml / rateAt(this->_settings->get().pumpSpeed));
+}
+
+bool GravityPump::cancel(uint16_t id)
+{
+    for(byte i = 0; i < DOSE_QUEUE_LENGTH; i++)
+    {
+        DoseJob &job = this->_jobs[i];
+        if(job.id == 0 || job.id != id)
+        {
+            continue;
+        }
+        if(i == this->_running)
+        {
+            if(this->_runFlag)
+            {
+                count(min(millis() - this->_startTime, this->_intervalTime));
+                TRACE_INSTANT(TRACK_PUMP, "stop", job.id);
+                TRACE_END(TRACK_PUMP, "run");
+            }
+            this->_stopFlag = true;
+            this->_runFlag = false;
+            this->_fineTime = 0;
+            this->_running = -1;
+        }
+        if(job.started && this->_stats != NULL)
+        {
+            this->_stats->aborted();
+        }
+        end(job, DOSE_CANCELLED);
+        return true;
+    }
+    return false;
+}
+
+void GravityPump::release(byte priority)
+{
+    for(byte i = 0; i < DOSE_QUEUE_LENGTH; i++)
+    {
+        DoseJob &job = this->_jobs[i];
+        if(job.id == 0 || job.priority != priority)
+        {
+            continue;
+        }
+        if(i == this->_running)
+        {
+            if(this->_runFlag)
+            {
+                count(min(millis() - this->_startTime, this->_intervalTime));
+                TRACE_INSTANT(TRACK_PUMP, "release", job.id);
+                TRACE_END(TRACK_PUMP, "run");
+            }
+            this->_stopFlag = true;             //servo stops on this update(), the next job starts on the one after
+            this->_runFlag = false;
+            this->_fineTime = 0;
+            this->_running = -1;
+        }
+        if(job.speed < 0)
+        {
+            job.delivered = min(job.delivered, job.ml);
+            refund(job.ml - job.delivered);
+            job.ml = job.delivered;             //done is what ran, end() reports it as the whole job
+        }
+        end(job, DOSE_DONE);
+    }
+}
+
+unsigned long GravityPump::timeUntilDone(uint16_t id)
+{
+    const DoseJob *mine = NULL;
+    for(byte i = 0; i < DOSE_QUEUE_LENGTH; i++)
+    {
+        if(this->_jobs[i].id != 0 && this->_jobs[i].id == id)
+        {
+            mine = &this->_jobs[i];
+        }
+    }
+    if(mine == NULL)
+    {
+        return 0;
+    }
+    unsigned long ms = 0;
+    if(this->_running >= 0 && this->_runFlag)
+    {
+        ms += this->_intervalTime - min(millis() - this->_startTime, this->_intervalTime) + this->_fineTime;
+    }
+    for(byte i = 0; i < DOSE_QUEUE_LENGTH; i++)
+    {
+        const DoseJob &job = this->_jobs[i];
+        if(job.id != 0 && job.state == DOSE_QUEUED && (&job == mine || before(job, *mine)))
+        {
+            ms += estimateMs(job);
+        }
+    }
+    return ms;
+}
+
+byte GravityPump::queued()
+{
+    byte n = 0;
+    for(byte i = 0; i < DOSE_QUEUE_LENGTH; i++)
+    {
+        n += this->_jobs[i].id != 0;
+    }
+    return n;
+}
+
+float GravityPump::flowPump(float quantitation, byte priority, DoseCallback done)     //quantification setting pump function,base on the basic function.the function need to given a quantification. Then the pump will dosing the quantification
                                                     //in given number. if you have Calibration, the number will be close to result.
 {
-    unsigned long runTime = 0;
-    if(!this->_runFlag)
+    uint16_t id = queueDose(quantitation, priority, done);
+    if(id == 0)
     {
-        this->_runFlag = true;
-        this->_intervalTime = 1000*(quantitation / this->_flowRate);
-        this->_startTime = millis();
-        return this->_intervalTime; 
+        return 0;
     }
-    return 0;
+    return max(timeUntilDone(id), 1UL);
+}
+
+float GravityPump::lastDoseMl()
+{
+    return this->_lastDoseMl;
 }
 
 float GravityPump::timerPump(unsigned long runTime) //timer pump function,base on the basic function.the function need to  given the running time then the pump will dosing as long as your have given.
                                                     //and return the quantitation. if you have Calibration,  the number will be close to result.
 {
-    if(!this->_runFlag)
+    //runs into a measuring cup for the flow calibration, not a dose: the budget
+    //is for the tank, and a run it shortened would save a wrong flow rate
+    float quantitation = this->_settings->get().flowRate*runTime;
+    if(queueTimed(this->_settings->get().pumpSpeed, 1000UL*runTime, DOSE_CALIBRATION) == 0)
     {
-        this->_runFlag = true;
-        this->_intervalTime = runTime*1000;
-        this->_startTime = millis();
-        return (this->_flowRate*runTime);
+        return 0;
     }
-    return 0;
+    this->_lastDoseMl = quantitation;
+    return quantitation;
 }
 
 void GravityPump::stop()    //stop function. whenever you use this function the pump will stop immediately.
 {
+    if(this->_running >= 0)
+    {
+        cancel(this->_jobs[this->_running].id);     //the running one first, its callback sees the queue as it was
+    }
+    for(byte i = 0; i < DOSE_QUEUE_LENGTH; i++)
+    {
+        if(this->_jobs[i].id != 0)
+        {
+            cancel(this->_jobs[i].id);
+        }
+    }
     this->_stopFlag = true;
     this->_runFlag = false;
+    this->_fineTime = 0;
+}
+
+void GravityPump::emergencyStop()
+{
+    if(this->_runFlag)
+    {
+        TRACE_INSTANT(TRACK_PUMP, "emergency", 0);
+    }
+    this->_emergency = true;                    //the only flag this task writes, update() does the rest
+    this->_pumpServo.write(this->_servoStop);
+}
+
+void GravityPump::setDoseBudget(float mlPerHour)
+{
+    this->_budgetMlPerHour = mlPerHour;
+    this->_budgetMl = mlPerHour;
+    this->_budgetTime = millis();
+}
+
+float GravityPump::budgetLeft()
+{
+    if(this->_budgetMlPerHour <= 0)
+    {
+        return INFINITY;
+    }
+    unsigned long now = millis();
+    this->_budgetMl += this->_budgetMlPerHour * (now - this->_budgetTime) / 3600000.0;   //refills evenly over the hour
+    this->_budgetMl = min(this->_budgetMl, this->_budgetMlPerHour);
+    this->_budgetTime = now;
+    return this->_budgetMl;
+}
+
+void GravityPump::refund(float ml)
+{
+    if(this->_budgetMlPerHour > 0 && ml > 0)
+    {
+        this->_budgetMl += ml;                  //never pumped, may be dosed again
+    }
+}
+
+float GravityPump::takeBudget(float ml)
+{
+    float left = budgetLeft();
+    if(ml > left)
+    {
+        ml = left < 0.01 ? 0 : left;
+        if(!this->_budgetReached)
+        {
+            Serial.println(F("Dose budget reached"));     //once, not for every refused top-up
+        }
+        this->_budgetReached = true;
+    }
+    else if(left - ml >= BUDGET_REARM * this->_budgetMlPerHour)
+    {
+        this->_budgetReached = false;
+    }
+    if(this->_budgetMlPerHour > 0)
+    {
+        this->_budgetMl -= ml;
+    }
+    return ml;
+}
+
+bool GravityPump::isRunning()
+{
+    return this->_runFlag;
+}
+
+int GravityPump::runningSpeed()
+{
+    return this->_speed;
+}
+
+void GravityPump::reportFlow(Print &out)
+{
+    const SettingsData &settings = this->_settings->get();
+    out.print(F("flow "));
+    out.print(settings.flowRate, 3);
+    out.print(F(" ml/s at "));
+    out.println(settings.pumpSpeed);
+    if(this->_curve == NULL)
+    {
+        return;
+    }
+    for(byte i = 0; i < this->_curve->count(); i++)
+    {
+        out.print(F("curve "));
+        out.print(this->_curve->speed(i));
+        out.print(F(": "));
+        out.print(this->_curve->rate(i), 3);
+        out.println(F(" ml/s"));
+    }
+}
+
+void GravityPump::calibrateAt(int speed)
+{
+    queueTimed(speed, CALIBRATIONTIME*1000UL, DOSE_CALIBRATION);    //not a dose, the budget is for the tank
+}
+
+void GravityPump::setCalibration(int speed, float ml)
+{
+    if(!FlowCurve::sameDirection(speed, this->_settings->get().pumpSpeed))
+    {
+        return;                                 //would run the pump backwards in a dose
+    }
+    float rate = ml / float(CALIBRATIONTIME);
+    if(this->_stats != NULL)
+    {
+        this->_stats->calibrated();
+    }
+    if(this->_curve != NULL)
+    {
+        this->_curve->setPoint(speed, rate);
+        this->_curve->save();
+    }
+    if(speed == this->_settings->get().pumpSpeed)
+    {
+        SettingsData settings = this->_settings->get();
+        settings.flowRate = rate;
+        this->_settings->commit(settings);
+    }
+}
+
+float GravityPump::flowRate()
+{
+    return this->_settings->get().flowRate;
 }
 
 void GravityPump::calFlowRate(int speed) //Calibration function.the speed parameter is running speed what you needed.
@@ -116,8 +609,13 @@ void GravityPump::calFlowRate(int speed) //Calibration function.the speed parame
     //Pump some liquid in some secs
     //please input the actual mumber in serial by "SETCAL:XX"
     //cal end
-    this->_pumpSpeed = speed;
-    if(serialDataAvailable() > 0)
+    if(this->_settings->get().pumpSpeed != speed)
+    {
+        SettingsData settings = this->_settings->get();
+        settings.pumpSpeed = speed;
+        this->_settings->commit(settings);
+    }
+    if(Board::hasSerialCalibration && serialDataAvailable() > 0)
     {
         pumpCalibration(uartParse());
     }
@@ -163,14 +661,13 @@ void GravityPump::pumpCalibration(byte mode)
 {
     char *receivedBufferPtr;
     float quantification = 0;
+    SettingsData settings = this->_settings->get();
     
     switch(mode)
     {
       case 1:
       {
-        this->_stopFlag = false;
-        this->_startTime = millis();
-        this->_intervalTime = (CALIBRATIONTIME*1000);
+        queueTimed(settings.pumpSpeed, CALIBRATIONTIME*1000UL, DOSE_CALIBRATION);
         Serial.println(F("Calibration starting..."));
       }
       break;
@@ -181,30 +678,26 @@ void GravityPump::pumpCalibration(byte mode)
         quantification = strtod(receivedBufferPtr,NULL);
         Serial.print(F("Quantification:"));
         Serial.println(quantification);
-        this->_flowRate = quantification/float(CALIBRATIONTIME);
-        EEPROM_write(FLOWRATEADDRESS, this->_flowRate);
-        delay(10);
-        EEPROM_write(PUMPSPEEDADDRESS, this->_pumpSpeed);
+        setCalibration(settings.pumpSpeed, quantification);
+        settings = this->_settings->get();
         Serial.print(F("PumpSpeed:"));
-        Serial.println(this->_pumpSpeed);
+        Serial.println(settings.pumpSpeed);
         Serial.print(F("FlowRate:"));
-        Serial.print(this->_flowRate);
+        Serial.print(settings.flowRate);
         Serial.println(F("ml/s,\r\nCalibration Finish!"));
       }
       break;
       case 3: 
       {
-        EEPROM_read(PHVALUEADDR+24, quantification);
+        quantification = settings.flowMl;
         Serial.print(F("Quantification:"));
         Serial.println(quantification);
-        this->_flowRate = quantification/float(CALIBRATIONTIME);
-        EEPROM_write(FLOWRATEADDRESS, this->_flowRate);
-        delay(10);
-        EEPROM_write(PUMPSPEEDADDRESS, this->_pumpSpeed);
+        setCalibration(settings.pumpSpeed, quantification);
+        settings = this->_settings->get();
         Serial.print(F("PumpSpeed:"));
-        Serial.println(this->_pumpSpeed);
+        Serial.println(settings.pumpSpeed);
         Serial.print(F("FlowRate:"));
-        Serial.print(this->_flowRate);
+        Serial.print(settings.flowRate);
         Serial.println(F("ml/s,\r\nCalibration Finish!"));
       }
       break;
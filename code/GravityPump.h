@@ -3,8 +3,43 @@
 //#include <Servo.h>
 #include <ESP32Servo.h>
 #include <Arduino.h>
+#include "Settings.h"
+#include "FlowCurve.h"
+#include "Stats.h"
 
 #define RECEIVEDBUFFERLENGTH 20
+#define DOSE_QUEUE_LENGTH 4         //jobs queued and running, more are refused
+
+enum DosePriority                   //a higher one runs first and interrupts a lower one that is running
+{
+    DOSE_CONTROL = 0,               //doses from the control loop
+    DOSE_CALIBRATION,               //calibration and test runs
+    DOSE_MANUAL                     //DOWN held on the main screen
+};
+
+enum DoseState
+{
+    DOSE_QUEUED = 0,
+    DOSE_RUNNING,
+    DOSE_DONE,
+    DOSE_CANCELLED                  //by cancel() or stop(), delivered has what ran before
+};
+
+struct DoseJob;
+typedef void (*DoseCallback)(const DoseJob &job);  //once, when the job is done or cancelled
+
+struct DoseJob
+{
+    uint16_t id;                    //0 = free slot
+    uint8_t priority;
+    uint8_t state;
+    bool started;                   //has run, maybe interrupted since
+    int speed;                      //servo value of a timed job, -1 for a volume
+    float ml;                       //volume asked for, after the budget
+    float delivered;                //ml so far, estimated from the run time, all of ml once done
+    unsigned long runMs;            //timed job, still to run
+    DoseCallback done;
+};
 
 class GravityPump
 {
@@ -14,6 +49,9 @@ public:
 
     void update();                          //get the state from system, need to be put in the loop.
     void setPin(int pin);                   //set the pin for GravityPump.
+    void setSettings(Settings &settings);   //flow rate and speed are read from the shared settings
+    void setFlowCurve(FlowCurve &curve);    //flow at several speeds, flowPump() runs fast then slow with two or more points
+    void setStats(Stats &stats);            //counts doses, running time and ml
     void calFlowRate(int speed = 180);      //Calibration function.the speed parameter is running speed what you needed.
                                             //please input the "STARTCAL" in serial to start cal
                                             //Pump some liquid in some secs
@@ -23,26 +61,75 @@ public:
                                                        //0 and 180 is max speed in each direction.)and runing time in milliseced.
     float timerPump(unsigned long runTime);            //timer pump function,base on the basic function.the function need to  given the running time then the pump will dosing as long as your have given.
                                                        //and return the quantitation. if you have Calibration,  the number will be close to result.
-    float flowPump(float quantitation);                //quantification setting pump function,base on the basic function.the function need to given a quantification. Then the pump will dosing the quantification
+    float flowPump(float quantitation, byte priority = DOSE_CONTROL, DoseCallback done = NULL);
+                                                       //quantification setting pump function,base on the basic function.the function need to given a quantification. Then the pump will dosing the quantification
                                                        //in given number. if you have Calibration, the number will be close to result.
-    void getFlowRateAndSpeed();                        //flowrate and speed reading from EEPROM
+                                                       //returns ms until the dose is done, queue ahead included, 0 when it was refused
+    uint16_t queueDose(float ml, byte priority, DoseCallback done = NULL);
+                                                       //job id, 0 when refused. Merged into a queued job of the same priority and callback,
+                                                       //a manual one only tops up to ml so holding the button does not pile up,
+                                                       //and runs on in the manual job already running, counted as one dose
+    uint16_t queueTimed(int speed, unsigned long ms, byte priority, DoseCallback done = NULL);
+                                                       //run at a servo speed for a time, no budget
+    bool cancel(uint16_t id);                          //the callback gets what was delivered, false for an unknown id
+    void release(byte priority);                       //jobs of this priority end now as done with what they delivered, not aborted,
+                                                       //the others stay queued. DOWN let go ends the manual top-up
+    unsigned long timeUntilDone(uint16_t id);          //ms, with the jobs that run before it
+    byte queued();                                     //jobs queued or running
+    float lastDoseMl();                                //ml the last flowPump() or timerPump() queued, after the budget for flowPump()
+    void calibrateAt(int speed);                       //run CALIBRATIONTIME s at this speed into a measuring cup
+    void setCalibration(int speed, float ml);          //ml collected by calibrateAt(), adds a point to the flow curve
+    void reportFlow(Print &out);                       //the calibrated speeds and flow rates
     void stop();                                       //stop function. whenever you use this function the pump will stop immediately.
+                                                       //cancels every job, each callback gets its partial volume
+    void emergencyStop();                              //stop the servo now, safe to call from another task while the loop is stuck
+    void setDoseBudget(float mlPerHour);               //refuse or shorten doses beyond this volume per hour, 0 = no limit
+    float budgetLeft();                                //ml that may still be dosed right now
     void pumpCalibration(byte mode);
+    bool isRunning();                                  //true while a job is running
+    int runningSpeed();                                //servo value of the running phase
+    float flowRate();                                  //calibrated flow rate in ml/s
     
   private:
     Servo _pumpServo;
     int _pin;
     bool _runFlag = false;
     bool _stopFlag = false;
-    int _pumpSpeed = 160;
-    float _flowRate = 0.6; //default flow rate
+    Settings *_settings = NULL;
+    FlowCurve *_curve = NULL;
+    Stats *_stats = NULL;
+    int _speed = 90;                        //servo value of the running phase
+    int _fineSpeed = 90;
+    unsigned long _fineTime = 0;            //slow finish still to run after the fast phase, ms
+    float _lastDoseMl = 0;
+    DoseJob _jobs[DOSE_QUEUE_LENGTH] = {};
+    int8_t _running = -1;                   //index of the running job
+    uint16_t _nextId = 0;
+    volatile bool _emergency = false;       //set by the guard task, the loop drops the jobs
     unsigned long _startTime = 0;
     unsigned long _intervalTime = 0;
     const int _servoStop = 90;
+    float _budgetMlPerHour = 0;
+    float _budgetMl = 0;
+    unsigned long _budgetTime = 0;
+    bool _budgetReached = false;            //the message was printed, until the budget has refilled
     char _receivedBuffer[RECEIVEDBUFFERLENGTH]; // store the serial command
     byte _receivedBufferIndex = 0;
 
   private:
+    float takeBudget(float ml);
+    void refund(float ml);
+    uint16_t add(byte priority, int speed, float ml, unsigned long ms, DoseCallback done);
+    void suspend();                         //the running job goes back to the queue with what is left
+    void startNext();
+    void finish(byte state);                //the running job
+    void end(DoseJob &job, byte state);
+    static bool before(const DoseJob &a, const DoseJob &b);
+    unsigned long estimateMs(const DoseJob &job);
+    void start(int speed, unsigned long runTime);
+    float runningRate();                    //ml/s at _speed
+    float rateAt(int speed);                //ml/s, the flow curve when it covers that side, else settings.flowRate
+    void count(unsigned long ms);           //a phase ran this long at _speed, adds to the running job and the stats
     byte uartParse();
     bool serialDataAvailable();
     //void pumpCalibration(byte mode);
@@ -0,0 +1,140 @@
+#include "HeapMonitor.h"
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+HeapMonitor heapMonitor;
+
+static size_t allocatedBlocks()
+{
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_DEFAULT);
+    return info.allocated_blocks;
+}
+
+HeapMonitor::HeapMonitor()
+{
+}
+
+void HeapMonitor::seal()
+{
+    this->_loopTask = xTaskGetCurrentTaskHandle();
+    this->_sealedBlocks = allocatedBlocks();
+    this->_loopAllocations = 0;
+    this->_sealed = true;
+}
+
+void HeapMonitor::report(Print &out) const
+{
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_DEFAULT);
+    out.print(F("heap free "));
+    out.print((unsigned long)info.total_free_bytes);
+    out.print(F(", lowest "));
+    out.print((unsigned long)info.minimum_free_bytes);
+    out.print(F(", largest block "));
+    out.print((unsigned long)info.largest_free_block);
+    out.print(F(", blocks "));
+    out.print((unsigned long)info.allocated_blocks);
+    if(this->_sealed) {
+        out.print(F(" ("));
+        out.print((long)info.allocated_blocks - (long)this->_sealedBlocks);
+        out.print(F(" since setup)"));
+    }
+    out.println();
+#if HEAP_TRACK
+    out.print(F("allocations "));
+    out.print(this->_allocations);
+    out.print(F(", frees "));
+    out.print(this->_frees);
+    out.print(F(", in use "));
+    out.print(this->_inUse);
+    out.print(F(", peak "));
+    out.println(this->_peak);
+    out.print(F("loop allocations after setup "));
+    out.print(this->_loopAllocations);
+    if(this->_loopAllocations > 0) {
+        out.print(F(", last "));
+        out.print(this->_lastSize);
+        out.print(F(" bytes from 0x"));
+        out.print((uint32_t)(uintptr_t)this->_lastCaller, HEX);
+    }
+    out.println();
+#endif
+}
+
+uint32_t HeapMonitor::loopAllocations() const
+{
+    return this->_loopAllocations;
+}
+
+void HeapMonitor::counted(void *ptr, size_t size, void *caller)
+{
+    if(ptr == NULL) {
+        return;
+    }
+    __atomic_fetch_add(&this->_allocations, 1, __ATOMIC_RELAXED);
+    uint32_t inUse = __atomic_add_fetch(&this->_inUse, heap_caps_get_allocated_size(ptr), __ATOMIC_RELAXED);
+    if(inUse > this->_peak) {
+        this->_peak = inUse;                //a race here only loses a little of the peak
+    }
+    if(this->_sealed && xTaskGetCurrentTaskHandle() == this->_loopTask) {
+        this->_loopAllocations++;
+        this->_lastSize = size;
+        this->_lastCaller = caller;
+#if HEAP_ASSERT
+        abort();                            //the backtrace shows who allocated
+#endif
+    }
+}
+
+void HeapMonitor::released(size_t bytes)
+{
+    __atomic_fetch_add(&this->_frees, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&this->_inUse, bytes, __ATOMIC_RELAXED);
+}
+
+#if HEAP_TRACK
+extern "C" {
+void *__real_malloc(size_t size);
+void __real_free(void *ptr);
+void *__real_realloc(void *ptr, size_t size);
+void *__real_calloc(size_t count, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    void *ptr = __real_malloc(size);
+    heapMonitor.counted(ptr, size, __builtin_return_address(0));
+    return ptr;
+}
+
+void __wrap_free(void *ptr)
+{
+    if(ptr != NULL) {
+        heapMonitor.released(heap_caps_get_allocated_size(ptr));
+    }
+    __real_free(ptr);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    size_t before = ptr != NULL ? heap_caps_get_allocated_size(ptr) : 0;
+    void *moved = __real_realloc(ptr, size);
+    if(moved == NULL && size > 0) {
+        return NULL;                        //failed, the old block is still there
+    }
+    if(ptr != NULL) {
+        heapMonitor.released(before);
+    }
+    heapMonitor.counted(moved, size, __builtin_return_address(0));
+    return moved;
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    void *ptr = __real_calloc(count, size);
+    heapMonitor.counted(ptr, count * size, __builtin_return_address(0));
+    return ptr;
+}
+}
+#endif
@@ -0,0 +1,40 @@
+#ifndef _HEAPMONITOR_H_
+#define _HEAPMONITOR_H_
+
+#include <Arduino.h>
+
+#define HEAP_TRACK 0        //1 = count every allocation. Needs the allocator wrapped at link time, in platform.local.txt:
+                            //compiler.c.elf.extra_flags=-Wl,--wrap=malloc,--wrap=free,--wrap=realloc,--wrap=calloc
+#define HEAP_ASSERT 0       //1 = abort when the loop task allocates after setup(), with HEAP_TRACK
+
+//Heap use after setup(). The runtime paths are meant to be allocation
+//free, so a controller running for months never fragments the heap. The
+//HEAP serial command prints the state, HEAP_TRACK adds exact counters.
+class HeapMonitor
+{
+public:
+    HeapMonitor();
+
+    void seal();                            //last call in setup(), from here on the loop should not allocate
+    void report(Print &out) const;
+
+    uint32_t loopAllocations() const;       //by the loop task since seal(), HEAP_TRACK only
+    void counted(void *ptr, size_t size, void *caller);     //from the allocator wrappers
+    void released(size_t bytes);
+
+private:
+    void *_loopTask = NULL;
+    bool _sealed = false;
+    size_t _sealedBlocks = 0;               //allocated blocks when sealed, seen without HEAP_TRACK too
+    volatile uint32_t _allocations = 0;
+    volatile uint32_t _frees = 0;
+    volatile uint32_t _loopAllocations = 0;
+    volatile uint32_t _inUse = 0;           //bytes
+    volatile uint32_t _peak = 0;
+    volatile uint32_t _lastSize = 0;        //last allocation by the loop after seal()
+    void *volatile _lastCaller = NULL;
+};
+
+extern HeapMonitor heapMonitor;
+
+#endif
@@ -0,0 +1,99 @@
+#include "I2cBus.h"
+#include <Wire.h>
+
+I2cBus i2cBus;
+
+static const char *const DEVICE_NAMES[BUS_DEVICES] = {"adc", "display"};
+
+I2cBus::I2cBus()
+{
+    memset(this->_counters, 0, sizeof(this->_counters));
+    memset(this->_dueAt, 0, sizeof(this->_dueAt));
+}
+
+void I2cBus::begin(uint32_t clockHz)
+{
+    this->_clockHz = clockHz;
+    Wire.setClock(clockHz);
+    this->_sinceMs = millis();
+}
+
+void I2cBus::acquire(byte device)
+{
+    this->_startedAt = micros();
+}
+
+void I2cBus::release(byte device)
+{
+    uint32_t busy = micros() - this->_startedAt;
+    Counter &counter = this->_counters[device];
+    counter.transactions++;
+    counter.busyMicros += busy;
+    counter.longestMicros = max(counter.longestMicros, busy);
+}
+
+void I2cBus::due(byte device, unsigned long atMs)
+{
+    this->_dueAt[device] = atMs;
+}
+
+bool I2cBus::mayStart(byte device, uint32_t holdMicros)
+{
+    unsigned long now = millis();
+    unsigned long endsAt = now + (holdMicros + 999) / 1000;
+    for(byte d = 0; d < device; d++) {
+        //due from now until the transaction would end; one already past is not coming this pass
+        if((long)(this->_dueAt[d] - now) >= 0 && (long)(this->_dueAt[d] - endsAt) <= 0) {
+            this->_counters[device].deferred++;
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t I2cBus::transactions(byte device) const
+{
+    return this->_counters[device].transactions;
+}
+
+uint64_t I2cBus::busyMicros(byte device) const
+{
+    return this->_counters[device].busyMicros;
+}
+
+uint32_t I2cBus::longestMicros(byte device) const
+{
+    return this->_counters[device].longestMicros;
+}
+
+uint32_t I2cBus::deferred(byte device) const
+{
+    return this->_counters[device].deferred;
+}
+
+void I2cBus::report(Print &out) const
+{
+    unsigned long elapsedMs = millis() - this->_sinceMs;
+    out.print(F("I2C "));
+    out.print(this->_clockHz / 1000);
+    out.println(F(" kHz"));
+    for(byte d = 0; d < BUS_DEVICES; d++) {
+        const Counter &counter = this->_counters[d];
+        out.print(deviceName(d));
+        out.print(F(": "));
+        out.print(counter.transactions);
+        out.print(F(" transactions, busy "));
+        out.print((unsigned long)(counter.busyMicros / 1000));
+        out.print(F(" ms ("));
+        out.print(elapsedMs > 0 ? counter.busyMicros / (10.0 * elapsedMs) : 0.0, 2);
+        out.print(F("%), longest "));
+        out.print(counter.longestMicros);
+        out.print(F(" us, deferred "));
+        out.println(counter.deferred);
+    }
+}
+
+const char *I2cBus::deviceName(byte device)
+{
+    return DEVICE_NAMES[device];
+}
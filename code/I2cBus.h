@@ -0,0 +1,56 @@
+#ifndef _I2CBUS_H_
+#define _I2CBUS_H_
+
+#include <Arduino.h>
+
+enum BusDevice
+{
+    BUS_ADC = 0,
+    BUS_DISPLAY,
+    BUS_DEVICES
+};
+
+//Who holds the shared Wire bus, for how long, and who goes first. Devices
+//earlier in BusDevice come first: a device that has said when it will next
+//need the bus (due()) keeps the later ones off it when their transaction
+//would still be running then. The ADC says when the next reading is, the
+//display asks before each page (mayStart()) and sends it on a later pass
+//when it would hold up that reading. Everything runs in the loop, so a
+//transaction is never cut short, only a later one started after it.
+class I2cBus
+{
+public:
+    I2cBus();
+
+    void begin(uint32_t clockHz);           //after every device on the bus has been started
+    void acquire(byte device);              //a transaction starts
+    void release(byte device);              //and is done
+    void due(byte device, unsigned long atMs);              //its next transaction is expected at this millis(), a time gone by holds nothing back
+    bool mayStart(byte device, uint32_t holdMicros);        //false while a device before it is due within holdMicros, counted as deferred
+
+    uint32_t transactions(byte device) const;
+    uint64_t busyMicros(byte device) const; //total
+    uint32_t longestMicros(byte device) const;
+    uint32_t deferred(byte device) const;   //transactions mayStart() held back
+    void report(Print &out) const;          //per device counters and occupancy since begin()
+    static const char *deviceName(byte device);
+
+private:
+    struct Counter
+    {
+        uint32_t transactions;
+        uint64_t busyMicros;
+        uint32_t longestMicros;
+        uint32_t deferred;
+    };
+
+    Counter _counters[BUS_DEVICES];
+    unsigned long _dueAt[BUS_DEVICES];
+    uint32_t _startedAt = 0;
+    unsigned long _sinceMs = 0;
+    uint32_t _clockHz = 0;
+};
+
+extern I2cBus i2cBus;
+
+#endif
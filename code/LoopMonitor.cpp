@@ -0,0 +1,136 @@
+#include "LoopMonitor.h"
+#include "Trace.h"
+#include <esp_task_wdt.h>
+#include <esp_system.h>
+#include <esp_idf_version.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define LOOPMONITOR_MAGIC 0x4C4F4F50
+
+struct LoopOverrunRecord   //kept in RTC memory so the stage survives a watchdog reset
+{
+    uint32_t magic;
+    uint32_t overruns;
+    uint8_t stage;
+};
+
+RTC_NOINIT_ATTR static LoopOverrunRecord overrunRecord;
+
+static const char *const STAGE_NAMES[STAGE_COUNT] = {
+    "idle", "pump", "buttons", "temperature", "adc", "display", "serial", "modbus"
+};
+
+LoopMonitor::LoopMonitor()
+{
+}
+
+void LoopMonitor::begin(unsigned long deadlineMs, LoopFailsafe failsafe)
+{
+    this->_deadlineMs = deadlineMs;
+    this->_failsafe = failsafe;
+    if(overrunRecord.magic != LOOPMONITOR_MAGIC || esp_reset_reason() == ESP_RST_POWERON) {
+        overrunRecord.magic = LOOPMONITOR_MAGIC;
+        overrunRecord.overruns = 0;
+        overrunRecord.stage = STAGE_IDLE;
+    }
+#if ESP_IDF_VERSION_MAJOR >= 5
+    esp_task_wdt_config_t config = {LOOP_WDT_TIMEOUT_MS, 0, true};
+    if(esp_task_wdt_reconfigure(&config) != ESP_OK) {
+        esp_task_wdt_init(&config);
+    }
+#else
+    esp_task_wdt_init(LOOP_WDT_TIMEOUT_MS / 1000, true);
+#endif
+    esp_task_wdt_add(NULL);     //the task running loop()
+    xTaskCreatePinnedToCore(guardTask, "loopGuard", 2048, this, configMAX_PRIORITIES - 1, NULL, 0);
+}
+
+void LoopMonitor::beginLoop()
+{
+    esp_task_wdt_reset();
+    TRACE_BEGIN(TRACK_LOOP, "loop");
+    this->_stage = STAGE_IDLE;
+    this->_loopStart = millis();
+    this->_running = true;
+}
+
+void LoopMonitor::stage(byte stage)
+{
+    if(this->_stage != STAGE_IDLE) {
+        TRACE_END(TRACK_LOOP, stageName(this->_stage));
+    }
+    TRACE_BEGIN(TRACK_LOOP, stageName(stage));
+    this->_stage = stage;
+}
+
+void LoopMonitor::endLoop()
+{
+    this->_running = false;
+    if(this->_stage != STAGE_IDLE) {
+        TRACE_END(TRACK_LOOP, stageName(this->_stage));
+    }
+    TRACE_END(TRACK_LOOP, "loop");
+    unsigned long took = millis() - this->_loopStart;
+    if(took > this->_worstMs) {
+        this->_worstMs = took;
+        this->_worstStage = this->_stage;
+    }
+    this->_tripped = false;
+}
+
+void LoopMonitor::report(Print &out)
+{
+    out.print(F("Loop overruns: "));
+    out.print(overrunRecord.overruns);
+    if(overrunRecord.overruns > 0) {
+        out.print(F(", last in "));
+        out.print(stageName(overrunRecord.stage));
+    }
+    out.print(F(", worst pass "));
+    out.print(this->_worstMs);
+    out.println(F(" ms"));
+}
+
+uint32_t LoopMonitor::overruns() const
+{
+    return overrunRecord.overruns;
+}
+
+byte LoopMonitor::lastOverrunStage() const
+{
+    return overrunRecord.stage;
+}
+
+const char *LoopMonitor::stageName(byte stage)
+{
+    if(stage >= STAGE_COUNT) {
+        return "?";
+    }
+    return STAGE_NAMES[stage];
+}
+
+void LoopMonitor::guardTask(void *arg)
+{
+    LoopMonitor *monitor = (LoopMonitor*)arg;
+    for(;;) {
+        vTaskDelay(pdMS_TO_TICKS(LOOP_GUARD_PERIOD_MS));
+        monitor->check();
+    }
+}
+
+void LoopMonitor::check()
+{
+    if(!this->_running || this->_tripped) {
+        return;
+    }
+    if(millis() - this->_loopStart <= this->_deadlineMs) {
+        return;
+    }
+    this->_tripped = true;          //once per stuck pass
+    overrunRecord.overruns++;
+    overrunRecord.stage = this->_stage;
+    if(this->_failsafe != NULL) {
+        this->_failsafe();
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef _LOOPMONITOR_H_
+#define _LOOPMONITOR_H_
+
+#include <Arduino.h>
+
+#define LOOP_DEADLINE_MS 3000       //longest a loop() pass may take, menu screens hold for up to 2 s
+#define LOOP_WDT_TIMEOUT_MS 10000   //task watchdog resets the board if the loop stays stuck this long
+#define LOOP_GUARD_PERIOD_MS 100    //how often the guard task checks the loop
+
+enum LoopStage
+{
+    STAGE_IDLE = 0,
+    STAGE_PUMP,
+    STAGE_BUTTONS,
+    STAGE_TEMPERATURE,
+    STAGE_ADC,
+    STAGE_DISPLAY,
+    STAGE_SERIAL,
+    STAGE_MODBUS,
+    STAGE_COUNT
+};
+
+typedef void (*LoopFailsafe)();     //called from the guard task, must not touch I2C
+
+class LoopMonitor
+{
+public:
+    LoopMonitor();
+
+    void begin(unsigned long deadlineMs, LoopFailsafe failsafe);    //start the guard task and watch the loop task
+    void beginLoop();                       //first call in loop(), feeds the task watchdog
+    void stage(byte stage);                 //stage about to run
+    void endLoop();                         //last call in loop()
+    void report(Print &out);                //overruns of this and the previous boot
+
+    uint32_t overruns() const;
+    byte lastOverrunStage() const;
+    static const char *stageName(byte stage);
+
+private:
+    static void guardTask(void *arg);
+    void check();
+
+    unsigned long _deadlineMs = LOOP_DEADLINE_MS;
+    LoopFailsafe _failsafe = NULL;
+    volatile unsigned long _loopStart = 0;
+    volatile byte _stage = STAGE_IDLE;
+    volatile bool _running = false;
+    volatile bool _tripped = false;
+    unsigned long _worstMs = 0;
+    byte _worstStage = STAGE_IDLE;
+};
+
+#endif
@@ -0,0 +1,246 @@
+#include "ModbusSlave.h"
+
+#define MB_READ_HOLDING   0x03
+#define MB_READ_INPUT     0x04
+#define MB_WRITE_SINGLE   0x06
+#define MB_WRITE_MULTIPLE 0x10
+
+#define MB_EX_ILLEGAL_FUNCTION 0x01
+#define MB_EX_ILLEGAL_ADDRESS  0x02
+#define MB_EX_ILLEGAL_VALUE    0x03
+
+#define MB_MAX_READ 125
+#define MB_MAX_WRITE 123
+
+static const uint16_t CRC_TABLE[256] PROGMEM = {
+    0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+    0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+    0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+    0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+    0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+    0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+    0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+    0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+    0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+    0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+    0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+    0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+    0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+    0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+    0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+    0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+    0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+    0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+    0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+    0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+    0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+    0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+    0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+    0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+    0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+    0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+    0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+    0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+    0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+    0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+    0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+    0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040
+};
+
+ModbusSlave::ModbusSlave()
+{
+    memset(this->_input, 0, sizeof(this->_input));
+    memset(this->_holding, 0, sizeof(this->_holding));
+}
+
+void ModbusSlave::begin(Stream &port, byte address, unsigned long baud, int dePin)
+{
+    this->_port = &port;
+    this->_address = address;
+    this->_dePin = dePin;
+    if(baud > 19200) {
+        this->_frameGapUs = 1750;                       //fixed t3.5 above 19200 baud
+    } else {
+        this->_frameGapUs = 38500000UL / baud;          //3.5 characters of 11 bits
+    }
+    if(this->_dePin >= 0) {
+        pinMode(this->_dePin, OUTPUT);
+        digitalWrite(this->_dePin, LOW);
+    }
+    this->_requestLength = 0;
+    this->_lastByteUs = micros();
+}
+
+void ModbusSlave::setWriteHandler(ModbusWriteHandler handler)
+{
+    this->_writeHandler = handler;
+}
+
+void ModbusSlave::setInput(uint16_t reg, int16_t value)
+{
+    if(reg < MB_INPUT_COUNT) {
+        this->_input[reg] = value;
+    }
+}
+
+void ModbusSlave::setHolding(uint16_t reg, int16_t value)
+{
+    if(reg < MB_HOLDING_COUNT) {
+        this->_holding[reg] = value;
+    }
+}
+
+void ModbusSlave::poll()
+{
+    if(this->_port == NULL) {
+        return;
+    }
+    while(this->_port->available() > 0) {
+        int c = this->_port->read();
+        if(this->_requestLength < MODBUS_FRAME_LENGTH) {
+            this->_request[this->_requestLength++] = (uint8_t)c;
+        } else {
+            this->_overflow = true;
+        }
+        this->_lastByteUs = micros();
+    }
+    if(this->_requestLength == 0 || micros() - this->_lastByteUs < this->_frameGapUs) {
+        return;
+    }
+    size_t length = 0;
+    if(!this->_overflow) {
+        length = processFrame(this->_request, this->_requestLength, this->_response);
+    }
+    this->_requestLength = 0;
+    this->_overflow = false;
+    if(length > 0) {
+        if(this->_dePin >= 0) {
+            digitalWrite(this->_dePin, HIGH);
+        }
+        this->_port->write(this->_response, length);
+        this->_port->flush();
+        if(this->_dePin >= 0) {
+            digitalWrite(this->_dePin, LOW);
+        }
+    }
+}
+
+size_t ModbusSlave::processFrame(const uint8_t *request, size_t length, uint8_t *response)
+{
+    if(length < 4) {
+        return 0;
+    }
+    uint16_t crc = request[length - 2] | (request[length - 1] << 8);
+    if(crc != crc16(request, length - 2)) {
+        return 0;                                       //corrupted frames are silently dropped
+    }
+    byte address = request[0];
+    if(address != this->_address && address != 0) {
+        return 0;
+    }
+    size_t result = 0;
+    byte function = request[1];
+    if(function == MB_READ_HOLDING && length == 8) {
+        result = readRegisters(request, this->_holding, MB_HOLDING_COUNT, response);
+    } else if(function == MB_READ_INPUT && length == 8) {
+        result = readRegisters(request, this->_input, MB_INPUT_COUNT, response);
+    } else if(function == MB_WRITE_SINGLE && length == 8) {
+        result = writeSingle(request, response);
+    } else if(function == MB_WRITE_MULTIPLE && length >= 11) {
+        result = writeMultiple(request, length, response);
+    } else {
+        result = exception(function, MB_EX_ILLEGAL_FUNCTION, response);
+    }
+    if(address == 0) {
+        return 0;                                       //broadcast, never answered
+    }
+    return result;
+}
+
+size_t ModbusSlave::readRegisters(const uint8_t *request, const int16_t *table, uint16_t count, uint8_t *response)
+{
+    uint16_t start = (request[2] << 8) | request[3];
+    uint16_t quantity = (request[4] << 8) | request[5];
+    if(quantity == 0 || quantity > MB_MAX_READ) {
+        return exception(request[1], MB_EX_ILLEGAL_VALUE, response);
+    }
+    if(start >= count || quantity > count - start) {
+        return exception(request[1], MB_EX_ILLEGAL_ADDRESS, response);
+    }
+    response[0] = this->_address;
+    response[1] = request[1];
+    response[2] = quantity * 2;
+    for(uint16_t i = 0; i < quantity; i++) {
+        uint16_t value = (uint16_t)table[start + i];
+        response[3 + i * 2] = value >> 8;
+        response[4 + i * 2] = value & 0xFF;
+    }
+    return finish(response, 3 + quantity * 2);
+}
+
+size_t ModbusSlave::writeSingle(const uint8_t *request, uint8_t *response)
+{
+    uint16_t reg = (request[2] << 8) | request[3];
+    uint16_t value = (request[4] << 8) | request[5];
+    if(reg >= MB_HOLDING_COUNT) {
+        return exception(request[1], MB_EX_ILLEGAL_ADDRESS, response);
+    }
+    if(this->_writeHandler != NULL && !this->_writeHandler(reg, &value, 1)) {
+        return exception(request[1], MB_EX_ILLEGAL_VALUE, response);
+    }
+    this->_holding[reg] = (int16_t)value;
+    memcpy(response, request, 6);                       //the reply echoes the request
+    response[0] = this->_address;
+    return finish(response, 6);
+}
+
+size_t ModbusSlave::writeMultiple(const uint8_t *request, size_t length, uint8_t *response)
+{
+    uint16_t start = (request[2] << 8) | request[3];
+    uint16_t quantity = (request[4] << 8) | request[5];
+    byte bytes = request[6];
+    if(quantity == 0 || quantity > MB_MAX_WRITE || bytes != quantity * 2 || length != 9 + (size_t)bytes) {
+        return exception(request[1], MB_EX_ILLEGAL_VALUE, response);
+    }
+    if(start >= MB_HOLDING_COUNT || quantity > MB_HOLDING_COUNT - start) {
+        return exception(request[1], MB_EX_ILLEGAL_ADDRESS, response);
+    }
+    uint16_t values[MB_HOLDING_COUNT];
+    for(uint16_t i = 0; i < quantity; i++) {
+        values[i] = (request[7 + i * 2] << 8) | request[8 + i * 2];
+    }
+    if(this->_writeHandler != NULL && !this->_writeHandler(start, values, quantity)) {
+        return exception(request[1], MB_EX_ILLEGAL_VALUE, response);    //nothing was applied
+    }
+    for(uint16_t i = 0; i < quantity; i++) {
+        this->_holding[start + i] = (int16_t)values[i];
+    }
+    response[0] = this->_address;
+    memcpy(response + 1, request + 1, 5);
+    return finish(response, 6);
+}
+
+size_t ModbusSlave::exception(byte function, byte code, uint8_t *response)
+{
+    response[0] = this->_address;
+    response[1] = function | 0x80;
+    response[2] = code;
+    return finish(response, 3);
+}
+
+size_t ModbusSlave::finish(uint8_t *response, size_t length)
+{
+    uint16_t crc = crc16(response, length);
+    response[length] = crc & 0xFF;                      //CRC goes out low byte first
+    response[length + 1] = crc >> 8;
+    return length + 2;
+}
+
+uint16_t ModbusSlave::crc16(const uint8_t *data, size_t length)
+{
+    uint16_t crc = 0xFFFF;
+    for(size_t i = 0; i < length; i++) {
+        crc = (crc >> 8) ^ pgm_read_word(&CRC_TABLE[(crc ^ data[i]) & 0xFF]);
+    }
+    return crc;
+}
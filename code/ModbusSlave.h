@@ -0,0 +1,73 @@
+#ifndef _MODBUSSLAVE_H_
+#define _MODBUSSLAVE_H_
+
+#include <Arduino.h>
+
+#define MODBUS_FRAME_LENGTH 256
+
+//Input registers (function 04), read only
+#define MB_IN_PH           0    //pH x100
+#define MB_IN_TEMPERATURE  1    //temperature x10, unit follows MB_HOLD_TEMP_UNIT
+#define MB_IN_VOLTAGE      2    //probe voltage in mV
+#define MB_IN_DOSING       3    //1 while the controller is dosing towards the target
+#define MB_IN_PUMP_RUNNING 4    //1 while the pump motor is on
+#define MB_IN_MENU         5    //current menu state, 0 = main screen
+#define MB_INPUT_COUNT     6
+
+//Holding registers (functions 03, 06, 16)
+#define MB_HOLD_TARGET     0    //target pH x100
+#define MB_HOLD_AMOUNT     1    //dose amount in ml x100
+#define MB_HOLD_WAIT       2    //wait time between doses in minutes x10
+#define MB_HOLD_BUFFER     3    //pH buffer x100
+#define MB_HOLD_FLOW_RATE  4    //pump flow rate in ml/s x100
+#define MB_HOLD_TEMP_UNIT  5    //0 = Celsius, 1 = Fahrenheit
+#define MB_HOLD_CALIBRATE  6    //write 1 = enter pH calibration, 2 = calibrate on the current buffer, 3 = save and exit
+#define MB_HOLDING_COUNT   7
+
+#define MB_CAL_ENTER 1
+#define MB_CAL_CALIBRATE 2
+#define MB_CAL_EXIT 3
+
+typedef bool (*ModbusWriteHandler)(uint16_t start, const uint16_t *values, uint16_t count);
+                                            //one call per write request, all registers or none: return false
+                                            //to reject the request before anything is applied
+
+class ModbusSlave
+{
+public:
+    ModbusSlave();
+
+    void begin(Stream &port, byte address, unsigned long baud, int dePin = -1);
+    void setWriteHandler(ModbusWriteHandler handler);
+    void poll();                                        //need to be put in the loop, answers at most one request per call
+
+    void setInput(uint16_t reg, int16_t value);         //snapshot values answered to the master
+    void setHolding(uint16_t reg, int16_t value);
+
+    size_t processFrame(const uint8_t *request, size_t length, uint8_t *response);
+                                                        //returns the response length, 0 when nothing must be sent
+
+    static uint16_t crc16(const uint8_t *data, size_t length);
+
+private:
+    size_t readRegisters(const uint8_t *request, const int16_t *table, uint16_t count, uint8_t *response);
+    size_t writeSingle(const uint8_t *request, uint8_t *response);
+    size_t writeMultiple(const uint8_t *request, size_t length, uint8_t *response);
+    size_t exception(byte function, byte code, uint8_t *response);
+    size_t finish(uint8_t *response, size_t length);
+
+    Stream *_port = NULL;
+    byte _address = 1;
+    int _dePin = -1;
+    unsigned long _frameGapUs = 1750;
+    unsigned long _lastByteUs = 0;
+    ModbusWriteHandler _writeHandler = NULL;
+    int16_t _input[MB_INPUT_COUNT];
+    int16_t _holding[MB_HOLDING_COUNT];
+    uint8_t _request[MODBUS_FRAME_LENGTH];
+    uint8_t _response[MODBUS_FRAME_LENGTH];
+    size_t _requestLength = 0;
+    bool _overflow = false;
+};
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef _PHADC_H_
+#define _PHADC_H_
+
+#include <Arduino.h>
+
+//Where the probe voltage comes from: the ADS1115 (AdsAutoRange) or the
+//ESP32's own ADC (EspAdc). The loop and the pH conversion only see this.
+class PhAdc
+{
+public:
+    virtual ~PhAdc() {}
+
+    virtual float readMillivolts() = 0;     //probe voltage, mV
+    virtual void service() {}               //every loop, for backends that sample in the background
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "PhEstimator.h"
+
+PhEstimator::PhEstimator()
+{
+    reset();
+}
+
+void PhEstimator::setDoseModel(const DoseModel *model)
+{
+    this->_model = model;
+}
+
+void PhEstimator::reset()
+{
+    this->_ready = false;
+    this->_pendingMl = 0;
+    this->_x[0] = this->_x[1] = 0;
+    this->_p[0][0] = this->_p[0][1] = this->_p[1][0] = this->_p[1][1] = 0;
+}
+
+void PhEstimator::dose(float ml)
+{
+    this->_pendingMl += ml;
+}
+
+void PhEstimator::update(unsigned long now, float ph, float temperature)
+{
+    if(isnan(ph)) {
+        return;
+    }
+    float r = PH_EST_PROBE_NOISE * PH_EST_PROBE_NOISE;
+    if(!this->_ready) {
+        this->_x[0] = ph;
+        this->_x[1] = 0;
+        this->_p[0][0] = r;
+        this->_p[0][1] = this->_p[1][0] = 0;
+        this->_p[1][1] = PH_EST_INITIAL_RATE * PH_EST_INITIAL_RATE;
+        this->_updatedAt = now;
+        this->_temperature = temperature;
+        this->_pendingMl = 0;
+        this->_ready = true;
+        return;
+    }
+
+    //predict: constant drift rate plus the doses since the last reading
+    float dt = (now - this->_updatedAt) / 60000.0;
+    float q = PH_EST_DRIFT * PH_EST_DRIFT;
+    float p00 = this->_p[0][0] + dt * (this->_p[0][1] + this->_p[1][0]) + dt * dt * this->_p[1][1] + q * dt * dt * dt / 3;
+    float p01 = this->_p[0][1] + dt * this->_p[1][1] + q * dt * dt / 2;
+    float p11 = this->_p[1][1] + q * dt;
+    this->_x[0] += this->_x[1] * dt;
+    if(this->_pendingMl > 0) {
+        float gain = 0;
+        float error = 0;
+        if(this->_model != NULL && this->_model->samples() > 0) {
+            gain = this->_model->gain();
+            error = this->_model->confident() ? this->_model->gainError() : fabs(gain) * PH_EST_DOSE_ERROR;
+        }
+        this->_x[0] += gain * this->_pendingMl;
+        p00 += (error * this->_pendingMl) * (error * this->_pendingMl);
+        if(gain == 0) {
+            p00 += 1.0;                     //no idea what the dose did, let the reading decide
+        }
+        this->_pendingMl = 0;
+    }
+
+    //correct with the reading, noisier when the temperature moved
+    float moved = (temperature - this->_temperature) * PH_EST_TEMP_NOISE;
+    r += moved * moved;
+    float s = p00 + r;
+    float k0 = p00 / s;
+    float k1 = p01 / s;
+    float innovation = ph - this->_x[0];
+    this->_x[0] += k0 * innovation;
+    this->_x[1] += k1 * innovation;
+    this->_p[0][0] = (1 - k0) * p00;
+    this->_p[0][1] = this->_p[1][0] = (1 - k0) * p01;
+    this->_p[1][1] = p11 - k1 * p01;
+    this->_updatedAt = now;
+    this->_temperature = temperature;
+}
+
+bool PhEstimator::ready() const
+{
+    return this->_ready;
+}
+
+float PhEstimator::ph() const
+{
+    return this->_x[0];
+}
+
+float PhEstimator::rate() const
+{
+    return this->_x[1];
+}
+
+float PhEstimator::uncertainty() const
+{
+    return sqrt(this->_p[0][0]);
+}
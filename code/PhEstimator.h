@@ -0,0 +1,42 @@
+#ifndef _PHESTIMATOR_H_
+#define _PHESTIMATOR_H_
+
+#include <Arduino.h>
+#include "DoseModel.h"
+
+#define PH_EST_PROBE_NOISE 0.03     //pH, standard deviation of one probe reading
+#define PH_EST_TEMP_NOISE 0.01      //pH per degree the temperature moved since the last reading, probe lag
+#define PH_EST_DRIFT 0.0005         //(pH/min)/sqrt(min), how fast the drift rate itself wanders
+#define PH_EST_INITIAL_RATE 0.01    //pH/min, prior uncertainty of the drift rate
+#define PH_EST_DOSE_ERROR 0.5       //relative error of a dose effect while the dose model is not trusted
+
+//Two state Kalman filter, pH and its drift rate. Doses are the control
+//input, through the learned gain of the DoseModel, and a temperature change
+//between readings widens the measurement noise. Fixed size, no allocation,
+//no hardware, so tools/bench can time it on a PC.
+class PhEstimator
+{
+public:
+    PhEstimator();
+
+    void setDoseModel(const DoseModel *model);
+    void reset();
+    void dose(float ml);                    //acid delivered to the tank, applied at the next update
+    void update(unsigned long now, float ph, float temperature);    //one probe reading
+
+    bool ready() const;                     //at least one reading
+    float ph() const;                       //filtered pH
+    float rate() const;                     //pH per minute
+    float uncertainty() const;              //standard deviation of ph()
+
+private:
+    const DoseModel *_model = NULL;
+    bool _ready = false;
+    unsigned long _updatedAt = 0;
+    float _temperature = 0;
+    float _pendingMl = 0;
+    float _x[2];                            //pH, pH/min
+    float _p[2][2];                         //covariance
+};
+
+#endif
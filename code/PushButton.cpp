@@ -0,0 +1,115 @@
+#include "PushButton.h"
+
+PushButton::PushButton(int pin)
+{
+    this->_pin = pin;
+}
+
+void PushButton::begin()
+{
+    pinMode(this->_pin, INPUT_PULLUP);
+    this->_state = digitalRead(this->_pin);
+    attachInterruptArg(digitalPinToInterrupt(this->_pin), onEdge, this, CHANGE);
+}
+
+void PushButton::setDebounceTime(unsigned long ms)
+{
+    this->_debounceMs = ms;
+}
+
+void IRAM_ATTR PushButton::onEdge(void *arg)
+{
+    PushButton *button = (PushButton*)arg;
+    byte head = button->_head;
+    byte next = (head + 1) & (BUTTON_QUEUE_LENGTH - 1);
+    if(next == button->_tail) {
+        return;                 //full, loop() resyncs from the pin level
+    }
+    button->_queue[head].time = millis();
+    button->_queue[head].level = digitalRead(button->_pin);
+    button->_head = next;
+}
+
+void PushButton::loop()
+{
+    this->_pressed = false;
+    this->_released = false;
+    while(this->_tail != this->_head && !this->_released) {
+        byte tail = this->_tail;
+        unsigned long time = this->_queue[tail].time;
+        byte level = this->_queue[tail].level;
+        this->_tail = (tail + 1) & (BUTTON_QUEUE_LENGTH - 1);
+        if(time - this->_lastEdge >= this->_debounceMs) {  //edges inside the window are contact bounce
+            accept(level, time);
+        }
+    }
+    if(this->_tail == this->_head && !this->_released) {
+        //the bounce can settle on the other level inside the window, or the queue overflowed
+        unsigned long now = millis();
+        byte level = digitalRead(this->_pin);
+        if(level != this->_state && now - this->_lastEdge >= this->_debounceMs) {
+            accept(level, now);
+        }
+    }
+}
+
+void PushButton::accept(byte level, unsigned long time)
+{
+    if(level == this->_state) {
+        return;
+    }
+    this->_state = level;
+    this->_lastEdge = time;
+    if(level == LOW) {
+        this->_pressed = true;
+        this->_pressedAt = time;
+        this->_repeats = 0;
+        this->_repeatInterval = BUTTON_REPEAT_START_MS;
+        this->_nextRepeat = time + BUTTON_REPEAT_DELAY_MS;
+    } else {
+        this->_released = true;
+        this->_releasedAt = time;
+    }
+}
+
+bool PushButton::isPressed()
+{
+    return this->_pressed;
+}
+
+bool PushButton::isReleased()
+{
+    return this->_released;
+}
+
+int PushButton::getState()
+{
+    return this->_state;
+}
+
+unsigned long PushButton::pressedAt()
+{
+    return this->_pressedAt;
+}
+
+unsigned long PushButton::releasedAt()
+{
+    return this->_releasedAt;
+}
+
+bool PushButton::isRepeat()
+{
+    unsigned long now = millis();
+    if(this->_state != LOW || (long)(now - this->_nextRepeat) < 0) {
+        return false;
+    }
+    this->_repeats++;
+    this->_nextRepeat = now + this->_repeatInterval;
+    this->_repeatInterval = max((unsigned int)BUTTON_REPEAT_MIN_MS, this->_repeatInterval - this->_repeatInterval / 8);
+    return true;
+}
+
+unsigned int PushButton::repeatCount()
+{
+    return this->_repeats;
+}
@@ -0,0 +1,58 @@
+#ifndef _PUSHBUTTON_H_
+#define _PUSHBUTTON_H_
+
+#include <Arduino.h>
+
+#define BUTTON_QUEUE_LENGTH 16          //edges kept while loop() is blocked, power of two
+#define BUTTON_REPEAT_DELAY_MS 500      //hold this long before the first repeat
+#define BUTTON_REPEAT_START_MS 200      //first repeat interval
+#define BUTTON_REPEAT_MIN_MS 30         //the interval shrinks by 1/8 per repeat down to this
+
+//Push button to GND with the internal pull-up. Edges are timestamped in an
+//interrupt and debounced in loop(), so a press made while loop() is blocked
+//keeps its real press and release time. Same use as ezButton.
+class PushButton
+{
+public:
+    PushButton(int pin);
+
+    void begin();                           //attach the interrupt, call from setup()
+    void setDebounceTime(unsigned long ms);
+    void loop();                            //handles the queued edges up to the next release
+
+    bool isPressed();                       //pressed/released during the last loop()
+    bool isReleased();
+    int getState();                         //LOW while pressed
+    unsigned long pressedAt();              //millis() of the last accepted edges
+    unsigned long releasedAt();
+
+    bool isRepeat();                        //true once per repeat interval while held, poll it every loop()
+    unsigned int repeatCount();             //repeats of the current or last press
+
+private:
+    static void IRAM_ATTR onEdge(void *arg);
+    void accept(byte level, unsigned long time);
+
+    struct Edge
+    {
+        unsigned long time;
+        byte level;
+    };
+
+    int _pin;
+    unsigned long _debounceMs = 50;
+    volatile Edge _queue[BUTTON_QUEUE_LENGTH];
+    volatile byte _head = 0;                //written by the interrupt only
+    volatile byte _tail = 0;                //written by loop() only
+    byte _state = HIGH;
+    unsigned long _lastEdge = 0;
+    bool _pressed = false;
+    bool _released = false;
+    unsigned long _pressedAt = 0;
+    unsigned long _releasedAt = 0;
+    unsigned long _nextRepeat = 0;
+    unsigned int _repeatInterval = BUTTON_REPEAT_START_MS;
+    unsigned int _repeats = 0;
+};
+
+#endif
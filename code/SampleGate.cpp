@@ -0,0 +1,88 @@
+#include "SampleGate.h"
+
+SampleGate::SampleGate()
+{
+}
+
+void SampleGate::setBlanking(unsigned long ms)
+{
+    this->_blankingMs = ms;
+}
+
+void SampleGate::update(unsigned long now, bool pumpRunning)
+{
+    if(pumpRunning && !this->_running) {
+        if(!this->_blanking) {              //a dose restarted inside the window still counts as the same one
+            this->_rejected = 0;
+            this->_doses++;
+        }
+        this->_blanking = true;
+    }
+    if(!pumpRunning && this->_running) {
+        this->_stoppedAt = now;
+    }
+    this->_running = pumpRunning;
+    if(this->_blanking && !pumpRunning && now - this->_stoppedAt >= this->_blankingMs) {
+        this->_blanking = false;
+        this->_lastRejected = this->_rejected;
+        this->_lastHeldMs = this->_rejected > 0 ? this->_lastRejectAt - this->_firstRejectAt : 0;
+        this->_report = true;
+    }
+}
+
+bool SampleGate::accept(unsigned long now)
+{
+    if(!this->_blanking) {
+        return true;
+    }
+    if(this->_rejected == 0) {
+        this->_firstRejectAt = now;
+    }
+    this->_lastRejectAt = now;
+    if(this->_rejected < 0xFFFF) {
+        this->_rejected++;
+    }
+    this->_totalRejected++;
+    return false;
+}
+
+bool SampleGate::open() const
+{
+    return !this->_blanking;
+}
+
+void SampleGate::resume(unsigned long now)
+{
+    this->_blanking = true;
+    this->_running = false;
+    this->_stoppedAt = now;
+    this->_rejected = 0;
+    this->_doses++;
+}
+
+bool SampleGate::takeReport()
+{
+    bool report = this->_report;
+    this->_report = false;
+    return report;
+}
+
+uint16_t SampleGate::rejectedLastDose() const
+{
+    return this->_lastRejected;
+}
+
+unsigned long SampleGate::heldLastDoseMs() const
+{
+    return this->_lastHeldMs;
+}
+
+uint32_t SampleGate::rejectedTotal() const
+{
+    return this->_totalRejected;
+}
+
+uint32_t SampleGate::doses() const
+{
+    return this->_doses;
+}
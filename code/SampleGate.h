@@ -0,0 +1,44 @@
+#ifndef _SAMPLEGATE_H_
+#define _SAMPLEGATE_H_
+
+#include <Arduino.h>
+
+#define SAMPLE_BLANKING_MS 3000     //default quiet time after the pump stops before the pH is read again
+
+//Keeps pH samples away from the pump. The servo PWM and motor current couple
+//into the probe signal, so a reading is held off while the pump runs and for
+//a blanking window after it stops. Every held off sample is counted against
+//the dose that caused it, to tune the window.
+class SampleGate
+{
+public:
+    SampleGate();
+
+    void setBlanking(unsigned long ms);
+    void update(unsigned long now, bool pumpRunning);   //every loop, after the pump has been updated
+    bool accept(unsigned long now);         //false = do not sample now, counted as rejected
+    bool open() const;                      //the same answer without counting, for readings that only refresh the screen
+    void resume(unsigned long now);         //the pump was running at a reset, blank as if it just stopped
+    bool takeReport();                      //true once when the window after a dose has closed
+
+    uint16_t rejectedLastDose() const;
+    unsigned long heldLastDoseMs() const;   //how long a wanted sample waited for the window
+    uint32_t rejectedTotal() const;
+    uint32_t doses() const;
+
+private:
+    unsigned long _blankingMs = SAMPLE_BLANKING_MS;
+    bool _running = false;
+    bool _blanking = false;                 //pump running or inside the window
+    bool _report = false;
+    unsigned long _stoppedAt = 0;
+    unsigned long _firstRejectAt = 0;
+    unsigned long _lastRejectAt = 0;
+    uint16_t _rejected = 0;
+    uint16_t _lastRejected = 0;
+    unsigned long _lastHeldMs = 0;
+    uint32_t _totalRejected = 0;
+    uint32_t _doses = 0;
+};
+
+#endif
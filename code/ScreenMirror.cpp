@@ -0,0 +1,185 @@
+#include "ScreenMirror.h"
+
+ScreenMirror mirror;
+
+static uint16_t crc16(const uint8_t *data, size_t length)      //CRC-16/CCITT-FALSE, as the settings blob
+{
+    uint16_t crc = 0xFFFF;
+    for(size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for(byte b = 0; b < 8; b++) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+void ScreenMirror::begin(Print &out, uint8_t width, uint8_t height)
+{
+    this->_out = &out;
+    this->_width = min(width, (uint8_t)MIRROR_MAX_WIDTH);
+    this->_pages = min(height / 8, MIRROR_MAX_PAGES);
+}
+
+bool ScreenMirror::start(unsigned long periodMs)
+{
+    if(this->_out == NULL || this->_pages == 0) {
+        return false;
+    }
+    while(!drain()) {}                      //finish a frame from before a restart
+    this->_periodMs = periodMs;
+    this->_out->print(F("MIRROR START "));
+    this->_out->print(this->_width);
+    this->_out->print(' ');
+    this->_out->print(this->_pages * 8);
+    this->_out->print(' ');
+    this->_out->println(periodMs);
+    this->_wholePages = (1 << this->_pages) - 1;
+    this->_refreshAt = millis();
+    this->_sentAt = this->_refreshAt - periodMs;
+    this->_sequence = 0;
+    this->_length = 0;
+    this->_sent = 0;
+    this->_active = true;
+    return true;
+}
+
+void ScreenMirror::stop()
+{
+    if(!this->_active) {
+        return;
+    }
+    while(!drain()) {}
+    this->_out->println();
+    this->_out->println(F("MIRROR END"));
+    this->_active = false;
+}
+
+bool ScreenMirror::active() const
+{
+    return this->_active;
+}
+
+void ScreenMirror::service(const uint8_t *frame)
+{
+    if(!this->_active || frame == NULL || !drain()) {
+        return;
+    }
+    unsigned long now = millis();
+    if(now - this->_sentAt < this->_periodMs) {
+        return;
+    }
+    if(now - this->_refreshAt >= MIRROR_REFRESH_MS) {
+        this->_wholePages |= 1 << this->_refreshPage;
+        this->_refreshPage = (this->_refreshPage + 1) % this->_pages;
+        this->_refreshAt = now;
+    }
+    int page = nextPage(frame);
+    if(page < 0) {
+        return;
+    }
+    const uint8_t *data = frame + page * this->_width;
+    encode(page, data, this->_wholePages & (1 << page));
+    memcpy(this->_shadow + page * this->_width, data, this->_width);
+    this->_wholePages &= ~(1 << page);
+    this->_lastPage = page;
+    this->_sentAt = now;
+    drain();
+}
+
+int ScreenMirror::nextPage(const uint8_t *frame)
+{
+    //whole pages first, then changed ones, each round-robin from the last page sent
+    for(uint8_t i = 1; i <= this->_pages; i++) {
+        uint8_t page = (this->_lastPage + i) % this->_pages;
+        if(this->_wholePages & (1 << page)) {
+            return page;
+        }
+    }
+    for(uint8_t i = 1; i <= this->_pages; i++) {
+        uint8_t page = (this->_lastPage + i) % this->_pages;
+        size_t at = page * this->_width;
+        if(memcmp(frame + at, this->_shadow + at, this->_width) != 0) {
+            return page;
+        }
+    }
+    return -1;
+}
+
+void ScreenMirror::encode(uint8_t page, const uint8_t *data, bool whole)
+{
+    uint8_t row[MIRROR_MAX_WIDTH];
+    const uint8_t *shadow = this->_shadow + page * this->_width;
+    uint8_t n = this->_width;
+    for(uint8_t x = 0; x < n; x++) {
+        row[x] = whole ? data[x] : data[x] ^ shadow[x];    //unchanged columns are zero runs
+    }
+
+    this->_length = 0;
+    this->_sent = 0;
+    put(whole ? MIRROR_FRAME_PAGE : MIRROR_FRAME_DIFF);
+    put(this->_sequence & 0xFF);
+    put(this->_sequence >> 8);
+    put(page);
+    this->_sequence++;
+    uint8_t i = 0;
+    while(i < n) {
+        uint8_t run = 1;
+        while(i + run < n && row[i + run] == row[i]) {
+            run++;                          //n is at most 128, so is a run
+        }
+        if(run >= 3) {
+            put(0x80 | (run - 1));
+            put(row[i]);
+            i += run;
+            continue;
+        }
+        uint8_t start = i;                  //literals up to the next run of three
+        while(i < n && !(i + 2 < n && row[i] == row[i + 1] && row[i] == row[i + 2])) {
+            i++;
+        }
+        put(i - start - 1);
+        for(uint8_t k = start; k < i; k++) {
+            put(row[k]);
+        }
+    }
+    uint16_t crc = crc16(this->_frame + 2, this->_length);
+    put(crc & 0xFF);
+    put(crc >> 8);
+
+    //COBS in place as in AdcCapture, _frame[1] points at the first zero and
+    //_frame[0] is a delimiter that ends whatever text came before
+    uint8_t *p = this->_frame + 1;
+    uint8_t m = this->_length + 1;
+    uint8_t last = 0;
+    for(uint8_t k = 1; k < m; k++) {
+        if(p[k] == 0) {
+            p[last] = k - last;
+            last = k;
+        }
+    }
+    p[last] = m - last;
+    p[m] = 0;
+    this->_frame[0] = 0;
+    this->_length = m + 2;
+}
+
+bool ScreenMirror::drain()
+{
+    if(this->_sent >= this->_length) {
+        return true;
+    }
+    int room = this->_out->availableForWrite();
+    if(room <= 0) {
+        return false;
+    }
+    size_t n = min((size_t)room, (size_t)(this->_length - this->_sent));
+    this->_out->write(this->_frame + this->_sent, n);
+    this->_sent += n;
+    return this->_sent >= this->_length;
+}
+
+void ScreenMirror::put(uint8_t value)
+{
+    this->_frame[2 + this->_length++] = value;
+}
@@ -0,0 +1,60 @@
+#ifndef _SCREENMIRROR_H_
+#define _SCREENMIRROR_H_
+
+#include <Arduino.h>
+
+#define MIRROR_MAX_WIDTH 128
+#define MIRROR_MAX_PAGES 8          //64 rows
+#define MIRROR_PERIOD_MS 50         //default gap between pages, about a quarter of 115200 baud at worst
+#define MIRROR_REFRESH_MS 2000      //one page is sent whole this often, so a viewer that lost a frame catches up
+#define MIRROR_MAX_PAYLOAD (1 + 2 + 1 + MIRROR_MAX_WIDTH + 1 + 2)
+#define MIRROR_FRAME_SIZE (MIRROR_MAX_PAYLOAD + 3)  //leading 0x00, COBS code byte and the trailing 0x00
+
+#define MIRROR_FRAME_DIFF 0x11
+#define MIRROR_FRAME_PAGE 0x12
+
+//Mirrors the OLED to a host, tools/mirror.py rebuilds it. Only pages that
+//changed since they were last sent go out, one per period, each as the XOR
+//with what the host already has, run-length encoded. Frames are COBS encoded
+//between two 0x00, so the text the controller prints in between is skipped:
+//  diff: type 0x11, u16 sequence, u8 page, RLE of the page XOR the last sent page, CRC-16/CCITT
+//  page: type 0x12, u16 sequence, u8 page, RLE of the page itself, CRC
+//RLE control byte c: bit 7 set, the next byte (c & 0x7F) + 1 times, else
+//c + 1 bytes as they are. Little-endian. After MIRROR START every page is
+//sent whole, later one page every MIRROR_REFRESH_MS. A sequence gap tells
+//the host its copy is off until those refreshes have gone round.
+class ScreenMirror
+{
+public:
+    void begin(Print &out, uint8_t width, uint8_t height);
+    bool start(unsigned long periodMs);     //false without a screen, restarts with whole pages when running
+    void stop();
+    bool active() const;
+    void service(const uint8_t *frame);     //every loop with the display buffer, sends at most one page per period
+
+private:
+    int nextPage(const uint8_t *frame);     //-1 when nothing is due
+    void encode(uint8_t page, const uint8_t *data, bool whole);
+    bool drain();                           //write what the port takes, true when nothing is pending
+    void put(uint8_t value);
+
+    Print *_out = NULL;
+    uint8_t _width = 0;
+    uint8_t _pages = 0;
+    bool _active = false;
+    unsigned long _periodMs = MIRROR_PERIOD_MS;
+    unsigned long _sentAt = 0;
+    unsigned long _refreshAt = 0;
+    uint8_t _wholePages = 0;                //bit per page still to be sent whole
+    uint8_t _refreshPage = 0;
+    uint8_t _lastPage = 0;
+    uint16_t _sequence = 0;
+    uint8_t _shadow[MIRROR_MAX_WIDTH * MIRROR_MAX_PAGES];   //what the host has
+    uint8_t _frame[MIRROR_FRAME_SIZE];
+    uint8_t _length = 0;                    //payload bytes from _frame[2], then the encoded length
+    uint8_t _sent = 0;
+};
+
+extern ScreenMirror mirror;
+
+#endif
@@ -0,0 +1,366 @@
+#include "Settings.h"
+#include <EEPROM.h>
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+
+struct SettingsField
+{
+    uint16_t bit;
+    int address;
+    size_t offset;
+    const char *name;       //key in SET, NULL when only calibration writes it
+    float low;              //smallest value SET accepts, the same as the menus stop at
+    float high;             //largest value SET accepts, well past any real tank so a typo is caught
+};
+
+static const SettingsField FIELDS[] = {
+    {SETTING_NEUTRAL,   NEUTRALADDRESS,   offsetof(SettingsData, neutralVoltage), NULL,     0,    0},
+    {SETTING_ACID,      ACIDADDRESS,      offsetof(SettingsData, acidVoltage),    NULL,     0,    0},
+    {SETTING_TARGET,    TARGETADDRESS,    offsetof(SettingsData, targetPh),       "TARGET", 0.01, 14},
+    {SETTING_ISF,       ISFADDRESS,       offsetof(SettingsData, isF),            "ISF",    0,    1},
+    {SETTING_AMOUNT,    AMOUNTADDRESS,    offsetof(SettingsData, pumpAmount),     "AMNT",   0.1,  50},      //ml
+    {SETTING_WAIT,      WAITADDRESS,      offsetof(SettingsData, pumpWait),       "WAIT",   0.1,  1440},    //minutes, a day
+    {SETTING_FLOWML,    FLOWMLADDRESS,    offsetof(SettingsData, flowMl),         NULL,     0,    0},
+    {SETTING_FLOWRATE,  FLOWRATEADDRESS,  offsetof(SettingsData, flowRate),       "FRATE",  0.05, 10},      //ml/s
+    {SETTING_PUMPSPEED, PUMPSPEEDADDRESS, offsetof(SettingsData, pumpSpeed),      "SPEED",  0,    180},     //and on the side of 90 it is on now
+    {SETTING_PHBUFF,    PHBUFFADDRESS,    offsetof(SettingsData, phBuff),         "BUFF",   0.01, 2},
+};
+#define FIELD_COUNT (sizeof(FIELDS) / sizeof(FIELDS[0]))
+#define FIELD_SIZE 4
+static_assert(FIELD_COUNT == SETTINGS_FIELD_COUNT, "update SETTINGS_FIELD_COUNT and the blob version");
+
+static const char BASE64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const SettingsData DEFAULTS = {
+    1500.0,     //neutralVoltage, buffer solution 7.0 at 25C
+    2032.44,    //acidVoltage, buffer solution 4.0 at 25C
+    6.3,        //targetPh
+    0.0,        //isF
+    1.0,        //pumpAmount
+    60.0,       //pumpWait
+    6.0,        //flowMl
+    0.6,        //flowRate
+    160,        //pumpSpeed
+    0.1         //phBuff
+};
+
+Settings::Settings()
+{
+    this->_data = DEFAULTS;
+}
+
+void Settings::begin()
+{
+    EEPROM.begin(EEPROM_SIZE);
+    uint16_t blank = 0;
+    for(byte i = 0; i < FIELD_COUNT; i++) {
+        byte *p = (byte*)&this->_data + FIELDS[i].offset;
+        bool erased = true;
+        for(byte b = 0; b < FIELD_SIZE; b++) {
+            p[b] = EEPROM.read(FIELDS[i].address + b);
+            erased = erased && p[b] == 0xFF;
+        }
+        if(FIELDS[i].bit == SETTING_PUMPSPEED) {
+            if(this->_data.pumpSpeed < 0 || this->_data.pumpSpeed > 180) {
+                blank |= FIELDS[i].bit;
+            }
+        } else if(erased || isnan(*(float*)p)) {
+            blank |= FIELDS[i].bit;
+        }
+    }
+    if(this->_data.flowRate <= 0) {
+        blank |= SETTING_FLOWRATE;
+    }
+    if(blank) {
+        for(byte i = 0; i < FIELD_COUNT; i++) {
+            if(blank & FIELDS[i].bit) {         //new EEPROM, write typical values
+                memcpy((byte*)&this->_data + FIELDS[i].offset, (const byte*)&DEFAULTS + FIELDS[i].offset, FIELD_SIZE);
+            }
+        }
+        write(this->_data, blank);
+    }
+}
+
+const SettingsData &Settings::get() const
+{
+    return this->_data;
+}
+
+void Settings::commit(const SettingsData &settings)
+{
+    uint16_t changed = diff(this->_data, settings);
+    if(!changed) {
+        return;
+    }
+    this->_data = settings;
+    write(this->_data, changed);
+    for(byte i = 0; i < this->_listenerCount; i++) {
+        this->_listeners[i](this->_data, changed);
+    }
+}
+
+bool Settings::subscribe(SettingsListener listener)
+{
+    if(this->_listenerCount >= SETTINGS_MAX_LISTENERS) {
+        return false;
+    }
+    this->_listeners[this->_listenerCount++] = listener;
+    return true;
+}
+
+uint16_t Settings::diff(const SettingsData &a, const SettingsData &b) const
+{
+    uint16_t changed = 0;
+    for(byte i = 0; i < FIELD_COUNT; i++) {
+        if(memcmp((const byte*)&a + FIELDS[i].offset, (const byte*)&b + FIELDS[i].offset, FIELD_SIZE) != 0) {
+            changed |= FIELDS[i].bit;
+        }
+    }
+    return changed;
+}
+
+void Settings::write(const SettingsData &settings, uint16_t fields)
+{
+    for(byte i = 0; i < FIELD_COUNT; i++) {
+        if(fields & FIELDS[i].bit) {
+            const byte *p = (const byte*)&settings + FIELDS[i].offset;
+            for(byte b = 0; b < FIELD_SIZE; b++) {
+                EEPROM.write(FIELDS[i].address + b, p[b]);
+            }
+        }
+    }
+    EEPROM.commit();    //one commit for all fields
+}
+
+void Settings::setFlowCurve(FlowCurve *curve)
+{
+    this->_curve = curve;
+}
+
+size_t Settings::exportText(char *text, size_t size) const
+{
+    if(size < SETTINGS_TEXT_LENGTH) {
+        return 0;
+    }
+    uint8_t blob[SETTINGS_BLOB_LENGTH];
+    uint16_t fields = 0;
+    blob[0] = SETTINGS_BLOB_MAGIC;
+    blob[1] = SETTINGS_BLOB_VERSION;
+    for(byte i = 0; i < FIELD_COUNT; i++) {
+        fields |= FIELDS[i].bit;
+        memcpy(blob + 4 + i * FIELD_SIZE, (const byte*)&this->_data + FIELDS[i].offset, FIELD_SIZE);
+    }
+    size_t length = 4 + FIELD_COUNT * FIELD_SIZE;
+    if(this->_curve != NULL) {
+        fields |= SETTINGS_BLOB_CURVE;
+        blob[length++] = this->_curve->count();
+        for(byte i = 0; i < this->_curve->count(); i++) {
+            float rate = this->_curve->rate(i);
+            blob[length++] = this->_curve->speed(i);
+            memcpy(blob + length, &rate, 4);
+            length += 4;
+        }
+    }
+    blob[2] = fields & 0xFF;
+    blob[3] = fields >> 8;
+    uint16_t crc = crc16(blob, length);
+    blob[length++] = crc & 0xFF;
+    blob[length++] = crc >> 8;
+    return encode(blob, length, text);
+}
+
+byte Settings::importText(const char *text)
+{
+    uint8_t blob[SETTINGS_BLOB_LENGTH + 2];    //room for the padding of a longer blob
+    size_t length = decode(text, blob, sizeof(blob));
+    if(length < 6 || blob[0] != SETTINGS_BLOB_MAGIC) {
+        return SETTINGS_IMPORT_FORMAT;
+    }
+    if(blob[1] > SETTINGS_BLOB_VERSION) {
+        return SETTINGS_IMPORT_VERSION;
+    }
+    uint16_t fields = blob[2] | (blob[3] << 8);
+    size_t expected = 4 + 2;
+    for(byte i = 0; i < FIELD_COUNT; i++) {
+        if(fields & FIELDS[i].bit) {
+            expected += FIELD_SIZE;
+        }
+    }
+    const uint8_t *curve = NULL;
+    byte points = 0;
+    if(fields & SETTINGS_BLOB_CURVE) {
+        curve = blob + expected - 2;
+        if(length < expected + 1 || *curve > FLOW_CURVE_POINTS) {
+            return SETTINGS_IMPORT_FORMAT;
+        }
+        points = *curve++;
+        expected += 1 + points * 5;
+    }
+    if(length != expected || (fields & ~(((1 << FIELD_COUNT) - 1) | SETTINGS_BLOB_CURVE))) {
+        return SETTINGS_IMPORT_FORMAT;
+    }
+    if(crc16(blob, length - 2) != (blob[length - 2] | (blob[length - 1] << 8))) {
+        return SETTINGS_IMPORT_CRC;
+    }
+    SettingsData settings = this->_data;       //fields left out of the blob keep their value
+    const uint8_t *p = blob + 4;
+    for(byte i = 0; i < FIELD_COUNT; i++) {
+        if(fields & FIELDS[i].bit) {
+            memcpy((byte*)&settings + FIELDS[i].offset, p, FIELD_SIZE);
+            p += FIELD_SIZE;
+        }
+    }
+    if(!valid(settings)) {
+        return SETTINGS_IMPORT_RANGE;
+    }
+    uint8_t speeds[FLOW_CURVE_POINTS];
+    float rates[FLOW_CURVE_POINTS];
+    for(byte i = 0; i < points; i++) {
+        speeds[i] = curve[i * 5];
+        memcpy(&rates[i], curve + i * 5 + 1, 4);
+        if(!FlowCurve::validPoint(speeds[i], rates[i])) {
+            return SETTINGS_IMPORT_RANGE;
+        }
+    }
+    if(curve != NULL && this->_curve != NULL) {
+        this->_curve->replace(points, speeds, rates);
+        this->_curve->save(false);              //goes out with the commit of the fields
+        if(diff(this->_data, settings) == 0) {
+            EEPROM.commit();                    //only the curve changed
+        }
+    }
+    commit(settings);
+    return SETTINGS_IMPORT_OK;
+}
+
+byte Settings::setText(char *text)
+{
+    SettingsData settings = this->_data;       //fields not named keep their value
+    char *next = text;
+    while(next != NULL && *next != '\0') {
+        char *item = next;
+        next = strchr(item, ';');
+        if(next != NULL) {
+            *next++ = '\0';
+        }
+        char *value = strchr(item, '=');
+        if(value == NULL) {
+            return SETTINGS_IMPORT_FORMAT;
+        }
+        *value++ = '\0';
+        char *end;
+        float number = strtod(value, &end);
+        if(end == value || *end != '\0') {
+            return SETTINGS_IMPORT_FORMAT;
+        }
+        byte i = 0;
+        while(i < FIELD_COUNT && (FIELDS[i].name == NULL || strcasecmp(FIELDS[i].name, item) != 0)) {
+            i++;
+        }
+        if(i == FIELD_COUNT) {
+            return SETTINGS_SET_KEY;
+        }
+        if(!setField(settings, FIELDS[i].bit, number)) {
+            return SETTINGS_IMPORT_RANGE;
+        }
+    }
+    if(!valid(settings)) {
+        return SETTINGS_IMPORT_RANGE;
+    }
+    commit(settings);                           //one EEPROM commit and one round of listeners for all of them
+    return SETTINGS_IMPORT_OK;
+}
+
+bool Settings::setField(SettingsData &settings, uint16_t field, float value) const
+{
+    byte i = 0;
+    while(i < FIELD_COUNT && FIELDS[i].bit != field) {
+        i++;
+    }
+    if(i == FIELD_COUNT || FIELDS[i].name == NULL) {
+        return false;                           //not settable, calibration writes it
+    }
+    if(!(value >= FIELDS[i].low && value <= FIELDS[i].high)) {
+        return false;                           //NaN too
+    }
+    if(field == SETTING_PUMPSPEED) {
+        if(!FlowCurve::sameDirection((int)value, this->_data.pumpSpeed)) {
+            return false;                       //90 stops the pump, the other side runs it backwards out of the tank
+        }
+        settings.pumpSpeed = (int)value;
+    } else {
+        *(float*)((byte*)&settings + FIELDS[i].offset) = value;
+    }
+    return true;
+}
+
+bool Settings::valid(const SettingsData &settings)
+{
+    const float *values[] = {
+        &settings.neutralVoltage, &settings.acidVoltage, &settings.targetPh, &settings.isF, &settings.pumpAmount,
+        &settings.pumpWait, &settings.flowMl, &settings.flowRate, &settings.phBuff
+    };
+    for(byte i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        if(!isfinite(*values[i])) {
+            return false;
+        }
+    }
+    return settings.neutralVoltage != settings.acidVoltage
+        && settings.targetPh > 0 && settings.targetPh < 14
+        && (settings.isF == 0.0 || settings.isF == 1.0)
+        && settings.pumpAmount > 0 && settings.pumpWait > 0 && settings.flowMl > 0
+        && settings.flowRate > 0 && settings.phBuff >= 0
+        && settings.pumpSpeed >= 0 && settings.pumpSpeed <= 180 && settings.pumpSpeed != FLOW_SERVO_STOP;
+}
+
+uint16_t Settings::crc16(const uint8_t *data, size_t length)
+{
+    uint16_t crc = 0xFFFF;      //CRC-16/CCITT-FALSE
+    for(size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for(byte b = 0; b < 8; b++) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+size_t Settings::encode(const uint8_t *data, size_t length, char *text)
+{
+    size_t n = 0;
+    for(size_t i = 0; i < length; i += 3) {
+        uint32_t v = (uint32_t)data[i] << 16;
+        if(i + 1 < length) v |= (uint32_t)data[i + 1] << 8;
+        if(i + 2 < length) v |= data[i + 2];
+        text[n++] = BASE64[(v >> 18) & 0x3F];
+        text[n++] = BASE64[(v >> 12) & 0x3F];
+        text[n++] = i + 1 < length ? BASE64[(v >> 6) & 0x3F] : '=';
+        text[n++] = i + 2 < length ? BASE64[v & 0x3F] : '=';
+    }
+    text[n] = '\0';
+    return n;
+}
+
+size_t Settings::decode(const char *text, uint8_t *data, size_t size)
+{
+    size_t n = 0;
+    uint32_t v = 0;
+    byte bits = 0;
+    for(; *text != '\0' && *text != '='; text++) {
+        const char *c = strchr(BASE64, *text);
+        if(c == NULL) {
+            return 0;
+        }
+        v = (v << 6) | (c - BASE64);
+        bits += 6;
+        if(bits >= 8) {
+            bits -= 8;
+            if(n >= size) {
+                return 0;
+            }
+            data[n++] = v >> bits;
+        }
+    }
+    return n;
+}
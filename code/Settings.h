@@ -0,0 +1,103 @@
+#ifndef _SETTINGS_H_
+#define _SETTINGS_H_
+
+#include <Arduino.h>
+#include "FlowCurve.h"
+
+#define EEPROM_SIZE 512
+
+//EEPROM layout of the persisted settings
+#define PHVALUEADDR 0x00        //the start address of the pH calibration parameters stored in the EEPROM
+#define NEUTRALADDRESS (PHVALUEADDR+0)
+#define ACIDADDRESS    (PHVALUEADDR+4)
+#define TARGETADDRESS  (PHVALUEADDR+8)
+#define ISFADDRESS     (PHVALUEADDR+12)
+#define AMOUNTADDRESS  (PHVALUEADDR+16)
+#define WAITADDRESS    (PHVALUEADDR+20)
+#define FLOWMLADDRESS  (PHVALUEADDR+24)
+#define FLOWRATEADDRESS 0x24    //EEPROM address for flowrate, for more pump need to add more address.
+#define PHBUFFADDRESS  (PHVALUEADDR+40)
+#define PUMPSPEEDADDRESS 0x2C   //EEPROM address for speed, was 0x28 and overlapped the pH buffer
+#define DOSEMODELADDRESS 0x30   //learned dose response, owned by DoseModel
+#define FLOWCURVEADDRESS 0x40   //flow rate at several servo speeds, owned by FlowCurve
+#define STATSADDRESS 0x60       //lifetime dosing counters, STATS_SLOTS copies, owned by Stats
+
+//bits passed to the listeners for the fields that changed
+#define SETTING_NEUTRAL    0x0001
+#define SETTING_ACID       0x0002
+#define SETTING_TARGET     0x0004
+#define SETTING_ISF        0x0008
+#define SETTING_AMOUNT     0x0010
+#define SETTING_WAIT       0x0020
+#define SETTING_FLOWML     0x0040
+#define SETTING_FLOWRATE   0x0080
+#define SETTING_PUMPSPEED  0x0100
+#define SETTING_PHBUFF     0x0200
+
+#define SETTINGS_MAX_LISTENERS 4
+
+//provisioning blob: magic, version, field bits, the fields in SETTING_* order as
+//little-endian 4 byte values, with SETTINGS_BLOB_CURVE the flow curve (u8 count,
+//then per point u8 servo speed and f32 ml/s), CRC-16/CCITT of everything before it.
+//Version 1 blobs have no curve and are still imported.
+#define SETTINGS_BLOB_MAGIC 0x53
+#define SETTINGS_BLOB_VERSION 2
+#define SETTINGS_BLOB_CURVE 0x8000  //in the field bits
+#define SETTINGS_FIELD_COUNT 10
+#define SETTINGS_BLOB_LENGTH (4 + SETTINGS_FIELD_COUNT * 4 + 1 + FLOW_CURVE_POINTS * 5 + 2)    //the longest, a full curve
+#define SETTINGS_TEXT_LENGTH ((SETTINGS_BLOB_LENGTH + 2) / 3 * 4 + 1)    //base64 with the terminator
+
+#define SETTINGS_IMPORT_OK      0
+#define SETTINGS_IMPORT_FORMAT  1   //not base64, wrong length or magic
+#define SETTINGS_IMPORT_VERSION 2   //written by a newer firmware
+#define SETTINGS_IMPORT_CRC     3
+#define SETTINGS_IMPORT_RANGE   4   //a value the controller would not accept from the menus
+#define SETTINGS_SET_KEY        5   //SET named a setting it does not know
+
+struct SettingsData
+{
+    float neutralVoltage;   //probe voltage in pH 7.0 buffer, mV
+    float acidVoltage;      //probe voltage in pH 4.0 buffer, mV
+    float targetPh;
+    float isF;              //1.0 shows the temperature in Fahrenheit
+    float pumpAmount;       //ml per dose
+    float pumpWait;         //minutes between measurements
+    float flowMl;           //ml collected during the pump calibration run
+    float flowRate;         //ml/s
+    int   pumpSpeed;        //servo speed, 90 is stop
+    float phBuff;           //dose only when pH is above target + phBuff
+};
+
+typedef void (*SettingsListener)(const SettingsData &settings, uint16_t changed);
+
+class Settings
+{
+public:
+    Settings();
+
+    void begin();                                   //load everything from the EEPROM once, blank fields get their defaults
+    const SettingsData &get() const;                //the live values, never read back from flash
+    void commit(const SettingsData &settings);      //persist the changed fields with one EEPROM commit, then notify
+    bool subscribe(SettingsListener listener);      //called after every commit that changed something
+
+    void setFlowCurve(FlowCurve *curve);                //exported and imported with the fields
+    size_t exportText(char *text, size_t size) const;   //every field and the flow curve as base64, returns the length or 0 if it does not fit
+    byte importText(const char *text);                  //check the whole blob, then one commit, SETTINGS_IMPORT_*
+    byte setText(char *text);                           //TARGET=6.1;AMNT=0.5;WAIT=30, keys in any case, parsed in place, one commit, SETTINGS_IMPORT_*
+    bool setField(SettingsData &settings, uint16_t field, float value) const;  //one SETTING_* field within the bounds SET uses, false leaves it
+    static bool valid(const SettingsData &settings);
+
+private:
+    uint16_t diff(const SettingsData &a, const SettingsData &b) const;
+    void write(const SettingsData &settings, uint16_t fields);
+    static uint16_t crc16(const uint8_t *data, size_t length);
+    static size_t encode(const uint8_t *data, size_t length, char *text);
+    static size_t decode(const char *text, uint8_t *data, size_t size);
+
+    SettingsData _data;
+    FlowCurve *_curve = NULL;
+    SettingsListener _listeners[SETTINGS_MAX_LISTENERS];
+    byte _listenerCount = 0;
+};
+
+#endif
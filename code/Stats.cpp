@@ -0,0 +1,140 @@
+#include "Stats.h"
+#include "Settings.h"
+#include <EEPROM.h>
+#include <stddef.h>
+#include <string.h>
+
+#define STATS_MAGIC 0x57A7
+
+Stats stats;
+
+Stats::Stats()
+{
+    memset(&this->_data, 0, sizeof(this->_data));
+    this->_data.magic = STATS_MAGIC;
+}
+
+void Stats::begin()
+{
+    bool found = false;
+    for(byte s = 0; s < STATS_SLOTS; s++) {
+        StatsData stored;
+        byte *p = (byte*)&stored;
+        for(byte i = 0; i < sizeof(stored); i++) {
+            p[i] = EEPROM.read(STATSADDRESS + s * sizeof(StatsData) + i);
+        }
+        if(stored.magic != STATS_MAGIC || stored.crc != crc16(stored)) {
+            continue;
+        }
+        if(!found || (int16_t)(stored.sequence - this->_data.sequence) > 0) {
+            this->_data = stored;
+            this->_slot = s;
+            found = true;
+        }
+    }
+    this->_flushedAt = millis();
+}
+
+void Stats::service(unsigned long now)
+{
+    if(this->_dirty && now - this->_flushedAt >= STATS_FLUSH_MS) {
+        flush();
+    }
+}
+
+void Stats::flush()
+{
+    this->_flushedAt = millis();
+    if(!this->_dirty) {
+        return;
+    }
+    this->_slot = (this->_slot + 1) % STATS_SLOTS;
+    this->_data.sequence++;
+    this->_data.crc = crc16(this->_data);
+    const byte *p = (const byte*)&this->_data;
+    for(byte i = 0; i < sizeof(this->_data); i++) {
+        EEPROM.write(STATSADDRESS + this->_slot * sizeof(StatsData) + i, p[i]);
+    }
+    EEPROM.commit();
+    this->_dirty = false;
+}
+
+void Stats::reset()
+{
+    uint16_t sequence = this->_data.sequence;
+    memset(&this->_data, 0, sizeof(this->_data));
+    this->_data.magic = STATS_MAGIC;
+    this->_data.sequence = sequence;        //stays ahead of the older slot
+    this->_dirty = true;
+    flush();
+}
+
+void Stats::pumped(unsigned long ms, float ml)
+{
+    this->_data.pumpMs += ms;
+    this->_data.ml += ml;
+    this->_dirty = true;
+}
+
+void Stats::dosed()
+{
+    this->_data.doses++;
+    this->_dirty = true;
+}
+
+void Stats::aborted()
+{
+    this->_data.aborted++;
+    this->_dirty = true;
+}
+
+void Stats::sampled()
+{
+    this->_data.samples++;
+    this->_dirty = true;
+}
+
+void Stats::calibrated()
+{
+    this->_data.calibrations++;
+    this->_dirty = true;
+}
+
+const StatsData &Stats::get() const
+{
+    return this->_data;
+}
+
+void Stats::report(Print &out) const
+{
+    out.print(F("doses "));
+    out.print(this->_data.doses);
+    out.print(F(", aborted "));
+    out.println(this->_data.aborted);
+    out.print(F("acid "));
+    out.print(this->_data.ml, 1);
+    out.print(F(" ml, pump "));
+    out.print((unsigned long)(this->_data.pumpMs / 1000));
+    out.println(F(" s"));
+    out.print(F("samples "));
+    out.print(this->_data.samples);
+    out.print(F(", calibrations "));
+    out.println(this->_data.calibrations);
+    out.print(F("flash "));
+    out.print(this->_dirty ? F("pending") : F("saved"));
+    out.print(F(", write "));
+    out.println(this->_data.sequence);
+}
+
+uint16_t Stats::crc16(const StatsData &data)
+{
+    const byte *p = (const byte*)&data;
+    uint16_t crc = 0xFFFF;      //CRC-16/CCITT-FALSE over everything before the crc
+    for(size_t i = 0; i < offsetof(StatsData, crc); i++) {
+        crc ^= (uint16_t)p[i] << 8;
+        for(byte b = 0; b < 8; b++) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
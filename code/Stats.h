@@ -0,0 +1,55 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <Arduino.h>
+
+#define STATS_SLOTS 2                   //copies written in turn, a reset during a write keeps the other one
+#define STATS_FLUSH_MS 3600000UL        //counters reach the EEPROM at most once an hour
+
+struct StatsData
+{
+    uint16_t magic;
+    uint16_t sequence;              //highest valid sequence is the newest slot
+    uint32_t doses;
+    uint32_t aborted;               //doses cut short by stop()
+    uint32_t samples;               //pH readings for a dosing decision, the live view is not counted
+    uint32_t calibrations;          //probe and pump calibrations saved
+    uint64_t pumpMs;                //pump running time
+    float ml;                       //flow rate x running time
+    uint16_t crc;
+};
+
+//Lifetime counters for reagent use and pump tube wear. They count in RAM
+//and reach the EEPROM on a slow schedule, each write going to the next of
+//STATS_SLOTS slots, so a day of dosing costs a few commits, not one per dose.
+class Stats
+{
+public:
+    Stats();
+
+    void begin();                           //load the newest valid slot
+    void service(unsigned long now);        //flush when STATS_FLUSH_MS has passed with something counted, call every loop
+    void flush();                           //write now if anything changed
+    void reset();                           //zero everything and write it
+
+    void pumped(unsigned long ms, float ml);
+    void dosed();
+    void aborted();
+    void sampled();
+    void calibrated();
+
+    const StatsData &get() const;
+    void report(Print &out) const;
+
+private:
+    static uint16_t crc16(const StatsData &data);
+
+    StatsData _data;
+    byte _slot = 0;                         //slot written last
+    bool _dirty = false;
+    unsigned long _flushedAt = 0;
+};
+
+extern Stats stats;
+
+#endif
@@ -0,0 +1,52 @@
+#include "Trace.h"
+
+static const char *const TRACK_NAMES[TRACK_COUNT] = {"loop", "pump", "menu"};
+
+#if TRACE_ENABLE
+Trace trace;              //no ring in RAM unless tracing is compiled in
+#endif
+
+Trace::Trace() : _head(0), _paused(false)
+{
+}
+
+void Trace::record(char phase, uint8_t track, const char *name, int16_t arg)
+{
+    if(this->_paused.load(std::memory_order_relaxed)) {
+        return;
+    }
+    uint32_t slot = this->_head.fetch_add(1, std::memory_order_relaxed);
+    TraceEvent &event = this->_ring[slot % TRACE_EVENTS];
+    event.micros = micros();
+    event.name = name;
+    event.arg = arg;
+    event.phase = phase;
+    event.track = track;
+}
+
+void Trace::dump(Print &out)
+{
+    this->_paused.store(true);
+    uint32_t head = this->_head.load();
+    uint32_t first = head > TRACE_EVENTS ? head - TRACE_EVENTS : 0;
+    out.print(F("TRACE "));
+    out.print(head - first);
+    out.print(F(" events, "));
+    out.print(first);
+    out.println(F(" overwritten"));
+    for(uint32_t i = first; i < head; i++) {
+        const TraceEvent &event = this->_ring[i % TRACE_EVENTS];
+        out.print(event.micros);        //us, wraps after 71 minutes
+        out.print(' ');
+        out.print(event.phase);
+        out.print(' ');
+        out.print(event.track < TRACK_COUNT ? TRACK_NAMES[event.track] : "?");
+        out.print(' ');
+        out.print(event.name);
+        out.print(' ');
+        out.println(event.arg);
+    }
+    out.println(F("TRACE END"));
+    this->_head.store(0);
+    this->_paused.store(false);
+}
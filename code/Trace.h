@@ -0,0 +1,59 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <Arduino.h>
+#include <atomic>
+
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE 0      //1 = record trace points, TRACE dumps them, tools/trace.py makes Chrome trace JSON, or -DTRACE_ENABLE=1
+#endif
+#define TRACE_EVENTS 256    //ring size, 12 bytes each
+
+enum TraceTrack             //one row each in the trace viewer, spans on a row must nest
+{
+    TRACK_LOOP = 0,         //loop() and its stages
+    TRACK_PUMP,             //dose runs and their phases
+    TRACK_MENU,             //phCalibration() modes and serial commands
+    TRACK_COUNT
+};
+
+#if TRACE_ENABLE
+#define TRACE_BEGIN(track, name)        trace.record('B', track, name, 0)
+#define TRACE_END(track, name)          trace.record('E', track, name, 0)
+#define TRACE_INSTANT(track, name, arg) trace.record('i', track, name, arg)
+#else
+#define TRACE_BEGIN(track, name)        do {} while(0)
+#define TRACE_END(track, name)          do {} while(0)
+#define TRACE_INSTANT(track, name, arg) do {} while(0)
+#endif
+
+struct TraceEvent
+{
+    uint32_t micros;
+    const char *name;       //string literal, never copied
+    int16_t arg;
+    char phase;             //'B', 'E' or 'i', as in the Chrome trace format
+    uint8_t track;
+};
+
+//Begin/end spans and instant events in a ring in RAM. Writers claim a slot
+//with one atomic add, so the loop, the guard task and interrupts can all
+//record without a lock. dump() pauses recording while it prints; an event
+//being written at that moment may come out torn.
+class Trace
+{
+public:
+    Trace();
+
+    void record(char phase, uint8_t track, const char *name, int16_t arg = 0);
+    void dump(Print &out);                  //oldest first, then empties the ring
+
+private:
+    TraceEvent _ring[TRACE_EVENTS];
+    std::atomic<uint32_t> _head;            //events ever recorded, the next slot is _head % TRACE_EVENTS
+    std::atomic<bool> _paused;
+};
+
+extern Trace trace;
+
+#endif
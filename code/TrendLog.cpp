@@ -0,0 +1,118 @@
+#include "TrendLog.h"
+
+static const unsigned long COLUMN_MS[TREND_TIERS] = {
+    3600000UL / TREND_COLUMNS,          //28 s
+    86400000UL / TREND_COLUMNS,         //11 min
+    604800000UL / TREND_COLUMNS         //79 min
+};
+static const char *const TIER_NAMES[TREND_TIERS] = {"1h", "24h", "7d"};
+
+TrendLog::TrendLog()
+{
+    for(byte t = 0; t < TREND_TIERS; t++) {
+        Tier &tier = this->_tiers[t];
+        for(byte i = 0; i < TREND_COLUMNS - 1; i++) {
+            tier.ring[i].min = tier.ring[i].max = tier.ring[i].avg = TREND_EMPTY;
+        }
+        tier.head = 0;
+        tier.start = 0;
+        tier.count = 0;
+    }
+}
+
+void TrendLog::add(unsigned long now, float ph)
+{
+    if(isnan(ph)) {
+        return;
+    }
+    update(now);
+    int16_t value = round(constrain(ph, 0.0, 14.0) * 100);
+    for(byte t = 0; t < TREND_TIERS; t++) {
+        Tier &tier = this->_tiers[t];
+        if(tier.count == 0) {
+            tier.min = tier.max = value;
+            tier.sum = 0;
+        }
+        tier.min = min(tier.min, value);
+        tier.max = max(tier.max, value);
+        tier.sum += value;
+        if(tier.count < 0xFFFF) {
+            tier.count++;
+        }
+    }
+}
+
+void TrendLog::update(unsigned long now)
+{
+    if(!this->_started) {
+        for(byte t = 0; t < TREND_TIERS; t++) {
+            this->_tiers[t].start = now;
+        }
+        this->_started = true;
+        return;
+    }
+    for(byte t = 0; t < TREND_TIERS; t++) {
+        Tier &tier = this->_tiers[t];
+        for(byte n = 0; now - tier.start >= COLUMN_MS[t]; n++) {
+            if(n >= TREND_COLUMNS) {            //away longer than the whole chart
+                tier.start = now;
+                break;
+            }
+            close(tier);
+            tier.start += COLUMN_MS[t];
+        }
+    }
+}
+
+void TrendLog::close(Tier &tier)
+{
+    TrendColumn &column = tier.ring[tier.head];
+    if(tier.count == 0) {
+        column.min = column.max = column.avg = TREND_EMPTY;
+    } else {
+        column.min = tier.min;
+        column.max = tier.max;
+        column.avg = tier.sum / tier.count;
+    }
+    tier.head = (tier.head + 1) % (TREND_COLUMNS - 1);
+    tier.count = 0;
+}
+
+TrendColumn TrendLog::column(byte tier, byte index) const
+{
+    const Tier &t = this->_tiers[tier];
+    if(index < TREND_COLUMNS - 1) {
+        return t.ring[(t.head + index) % (TREND_COLUMNS - 1)];
+    }
+    TrendColumn open = {TREND_EMPTY, TREND_EMPTY, TREND_EMPTY};
+    if(t.count > 0) {
+        open.min = t.min;
+        open.max = t.max;
+        open.avg = t.sum / t.count;
+    }
+    return open;
+}
+
+bool TrendLog::range(byte tier, int16_t &low, int16_t &high) const
+{
+    low = INT16_MAX;
+    high = INT16_MIN;
+    for(byte i = 0; i < TREND_COLUMNS; i++) {
+        TrendColumn c = column(tier, i);
+        if(c.min != TREND_EMPTY) {
+            low = min(low, c.min);
+            high = max(high, c.max);
+        }
+    }
+    return low <= high;
+}
+
+unsigned long TrendLog::columnMs(byte tier)
+{
+    return COLUMN_MS[tier];
+}
+
+const char *TrendLog::tierName(byte tier)
+{
+    return TIER_NAMES[tier];
+}
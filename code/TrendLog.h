@@ -0,0 +1,57 @@
+#ifndef _TRENDLOG_H_
+#define _TRENDLOG_H_
+
+#include <Arduino.h>
+
+#define TREND_COLUMNS 128           //one column per OLED pixel
+#define TREND_EMPTY INT16_MIN       //no sample fell into the column
+
+enum TrendTier
+{
+    TREND_HOUR = 0,
+    TREND_DAY,
+    TREND_WEEK,
+    TREND_TIERS
+};
+
+struct TrendColumn                  //pH x100
+{
+    int16_t min;
+    int16_t max;
+    int16_t avg;
+};
+
+//min/max/avg of the pH per column for the last hour, day and week. Every
+//sample updates the open column of each tier, a column is closed into a
+//fixed ring when its time is up, so drawing never looks at raw samples.
+class TrendLog
+{
+public:
+    TrendLog();
+
+    void add(unsigned long now, float ph);
+    void update(unsigned long now);                         //close columns whose time is up, call before drawing
+    TrendColumn column(byte tier, byte index) const;        //0 is the oldest, TREND_COLUMNS - 1 the open one
+    bool range(byte tier, int16_t &low, int16_t &high) const;   //false when the tier has no sample yet
+    static unsigned long columnMs(byte tier);
+    static const char *tierName(byte tier);
+
+private:
+    struct Tier
+    {
+        TrendColumn ring[TREND_COLUMNS - 1];    //closed columns, ring[head] is the oldest
+        byte head;
+        unsigned long start;                    //millis() the open column began
+        int16_t min;
+        int16_t max;
+        int32_t sum;
+        uint16_t count;
+    };
+
+    void close(Tier &tier);
+
+    Tier _tiers[TREND_TIERS];
+    bool _started = false;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "WarmState.h"
+#include <esp_system.h>
+#include <stddef.h>
+
+#define WARMSTATE_MAGIC 0x5741524D
+
+struct WarmRecord
+{
+    uint32_t magic;
+    DosingSnapshot dosing;
+    bool pumpRunning;                       //the dose was cut short by the reset
+    float ph;
+    float temperature;
+    uint32_t check;
+};
+
+RTC_NOINIT_ATTR static WarmRecord warmRecord;
+static_assert(sizeof(DosingSnapshot) == 28, "a new DosingSnapshot field goes into checksum() too");
+
+static uint32_t mix(uint32_t sum, const void *field, size_t size)
+{
+    const byte *p = (const byte*)field;
+    for(size_t i = 0; i < size; i++) {
+        sum = (sum ^ p[i]) * 0x01000193;    //FNV-1a
+    }
+    return sum;
+}
+
+//field by field, padding is left out: struct copies need not carry it over
+static uint32_t checksum(const WarmRecord &record)     //a brownout can leave RTC memory half written
+{
+    const DosingSnapshot &d = record.dosing;
+    uint32_t sum = 0x811C9DC5;
+    sum = mix(sum, &record.magic, sizeof(record.magic));
+    sum = mix(sum, &d.dosing, sizeof(d.dosing));
+    sum = mix(sum, &d.restart, sizeof(d.restart));
+    sum = mix(sum, &d.sinceMeasuredMs, sizeof(d.sinceMeasuredMs));
+    sum = mix(sum, &d.dosed, sizeof(d.dosed));
+    sum = mix(sum, &d.sinceDoseEndMs, sizeof(d.sinceDoseEndMs));
+    sum = mix(sum, &d.doseWait, sizeof(d.doseWait));
+    sum = mix(sum, &d.doseMl, sizeof(d.doseMl));
+    sum = mix(sum, &d.dosePh, sizeof(d.dosePh));
+    sum = mix(sum, &record.pumpRunning, sizeof(record.pumpRunning));
+    sum = mix(sum, &record.ph, sizeof(record.ph));
+    sum = mix(sum, &record.temperature, sizeof(record.temperature));
+    return sum;
+}
+
+WarmState::WarmState()
+{
+}
+
+bool WarmState::begin()
+{
+    this->_warm = esp_reset_reason() != ESP_RST_POWERON && warmRecord.magic == WARMSTATE_MAGIC
+               && warmRecord.check == checksum(warmRecord);
+    return this->_warm;
+}
+
+bool WarmState::resume(unsigned long now, DosingController &dosing, SampleGate &gate, float &ph, float &temperature) const
+{
+    if(!this->_warm) {
+        return false;
+    }
+    DosingSnapshot snapshot = warmRecord.dosing;
+    if(warmRecord.pumpRunning) {
+        snapshot.doseMl = 0;                //how much went in is unknown, do not learn from it
+        gate.resume(now);
+    }
+    dosing.resume(now, snapshot);
+    ph = warmRecord.ph;
+    temperature = warmRecord.temperature;
+    return true;
+}
+
+void WarmState::save(unsigned long now, const DosingController &dosing, bool pumpRunning, float ph, float temperature)
+{
+    WarmRecord record;
+    record.magic = WARMSTATE_MAGIC;
+    dosing.snapshot(now, record.dosing);
+    record.pumpRunning = pumpRunning;
+    record.ph = ph;
+    record.temperature = temperature;
+    record.check = checksum(record);
+    warmRecord = record;
+}
@@ -0,0 +1,26 @@
+#ifndef _WARMSTATE_H_
+#define _WARMSTATE_H_
+
+#include <Arduino.h>
+#include "DosingController.h"
+#include "SampleGate.h"
+
+//Dosing and sampling state in RTC memory. It is saved every loop, so after a
+//watchdog, brownout or software reset the controller carries on with the
+//wait it was in instead of measuring and dosing again straight away. A power
+//on or a record that fails its check starts fresh.
+class WarmState
+{
+public:
+    WarmState();
+
+    bool begin();                           //true when a saved state survived the reset
+    bool resume(unsigned long now, DosingController &dosing, SampleGate &gate, float &ph, float &temperature) const;
+                                            //false on a cold boot, nothing is touched
+    void save(unsigned long now, const DosingController &dosing, bool pumpRunning, float ph, float temperature);
+
+private:
+    bool _warm = false;
+};
+
+#endif
@@ -29,48 +29,109 @@
  *   19            - pcals   -> Save pump flow rate (one click on SET)
  *   12     - 5gp
  *   20         - s5pg       -> Confirm pure 1 ml test
+ *   23     - 6gp
+ *   24         - buff       -> enter pH buffer window
+ *   25     - 7gp
+ *   26         - diag       -> Learned dose model (one click on SET)
+ *   31         - stats      -> Doses, acid used, pump time and calibrations (one more click on SET)
+ *   27     - 8gp
+ *   28-30      - trendh/trendd/trendw -> pH trend of the last hour/day/week (each click on SET shows the next)
  *   0    - target      -> Open target pH window (one click on SET)
  *   4      - mt        -> Decrease pH target (one click on DOWN)
  *   4      - pt        -> Increase pH target (one click on UP)
  *   4      - st        -> Save pH target (long click on SET)
  *   0    - tt          -> Change Temp C/F (one click on UP) 
+ *        - EXPORT      -> print every setting and the flow curve as SETTINGS <base64 blob> (serial only)
+ *        - IMPORT <blob> -> check and save a blob from EXPORT in one commit (serial only, tools/provision.py)
+ *        - SET TARGET=6.1;AMNT=0.5;WAIT=30 -> set values directly, also BUFF, FRATE, SPEED (same side of 90) and ISF, one commit (serial only)
+ *        - STATS       -> lifetime doses, aborted doses, ml, pump time, samples and calibrations, STATS RESET zeroes them (serial only)
+ *        - TRACE       -> recent loop stages, pump runs, menu modes and commands, TRACE_ENABLE 1 only (tools/trace.py)
+ *        - BUS         -> I2C clock and per-device transactions, busy time, longest hold and display pages held back for the ADC (serial only)
+ *        - HEAP        -> free heap, low-water mark, largest block and blocks allocated since setup (serial only)
+ *        - CAPTURE <s> -> stream raw ADS1115 conversions for s seconds as COBS frames, CAPTURE STOP ends it (tools/capture.py)
+ *        - MIRROR [ms] -> stream the changed OLED pages every ms (default 50), MIRROR STOP ends it (tools/mirror.py)
+ *        - FLOW        -> flow rate and the calibrated flow curve (serial only)
+ *        - PUMPCAL <speed>      -> run the pump 15 s at a servo speed into a measuring cup (serial only)
+ *        - PUMPCAL <speed> <ml> -> add the ml collected as a flow curve point, doses then run fast and finish slowly
+ *
+ * Holding UP or DOWN in the target, flow rate, amount, wait time, calibration ml and buffer
+ * windows repeats the step, faster the longer it is held.
  * 
+ * Modbus RTU (MODBUS_ENABLE 1): slave MODBUS_ADDRESS on MODBUS_SERIAL, register map in ModbusSlave.h
+ *
  */
 
+#include "BoardProfile.h"
 #include "DFRobot_PH.h"
-#include <EEPROM.h>
+#include "Settings.h"
 #include <OneWire.h>
 #include <DallasTemperature.h>
-#include <ezButton.h>
+#include "PushButton.h"
 #include <string.h>
 #include "GravityPump.h"
 #include <Adafruit_ADS1X15.h>
+#include "AdsAutoRange.h"
+#include "EspAdc.h"
+#include "ModbusSlave.h"
+#include "DoseModel.h"
+#include "DosingController.h"
+#include "TrendLog.h"
+#include "LoopMonitor.h"
+#include "I2cBus.h"
+#include "SampleGate.h"
+#include "WarmState.h"
+#include "PhEstimator.h"
+#include "HeapMonitor.h"
+#include "FlowCurve.h"
+#include "AdcCapture.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "ScreenMirror.h"
 
-#define ONE_WIRE_BUS 4
-#define PH_PIN 34
-#define UP_PIN 19
-#define SET_PIN 5
-#define DOWN_PIN 18
-#define PUMP_PIN 16
 #define PUMP_MOMENTARY 0.1
-#define ESPADC 4095.0   //the esp Analog Digital Convertion value
-#define ESPVOLTAGE 3300 //the esp voltage supply value
-#define WAIT_BETWEEN_DOSE 0.17
+#define MAX_ML_PER_HOUR 100.0       //dosing budget, the pump refuses anything beyond it
+#define ADS_DATA_RATE RATE_ADS1115_128SPS //ADS1115 samples per second, lower rates average longer and read quieter
+#define PUMP_BLANKING_MS 3000 //no pH reading while the pump runs and this long after it stops, ms
+#define LIVE_PERIOD_MS 500   //pH and temperature on the screen, dosing keeps its own pumpWait cadence
+#define TEMPERATURE_CONVERSION_MS 750 //DS18B20 at 12 bits, read without waiting for it
+#define BOOT_BUDGET_MS 150   //setup() should be done within this, the boot report flags anything slower
+#define MIRROR_SERIAL Serial //where MIRROR frames go, any UART Modbus is not using
+#define MODBUS_ENABLE 0     //1 = answer Modbus RTU requests from a PLC/SCADA master
+#define MODBUS_SERIAL Serial2
+#define MODBUS_ADDRESS 1
+#define MODBUS_BAUD 19200
 
 float voltage,phValue,temperature = 25;
+Settings settings;
+DoseModel doseModel;
+FlowCurve flowCurve;
+DosingController dosing;
+PhEstimator estimator;
+SampleGate gate;
+WarmState warmState;
+unsigned long bootStepAt;
+unsigned long liveAt = 0;
+unsigned long temperatureAt = 0;
+bool temperatureReady = false;
+TrendLog trend;
+LoopMonitor monitor;
 DFRobot_PH ph;
 GravityPump pump;
 
-OneWire oneWire(ONE_WIRE_BUS);
+OneWire oneWire(Board::oneWireBus);
 DallasTemperature sensors(&oneWire);
  Adafruit_ADS1115 ads;
+AdsAutoRange adc(ads);
+EspAdc espAdc(Board::phPin);
+PhAdc *phAdc = &adc;                // the ADS1115, or the ESP32 ADC on boards without one
+ModbusSlave modbus;
 
 
 const int SHORT_PRESS_TIME = 1000; // 1000 milliseconds
 const int LONG_PRESS_TIME  = 2000; // 1000 milliseconds
-ezButton setButton(SET_PIN); 
-ezButton upButton(UP_PIN); 
-ezButton downButton(DOWN_PIN); 
+PushButton setButton(Board::setPin);
+PushButton upButton(Board::upPin);
+PushButton downButton(Board::downPin);
 unsigned long pressedTimeSet  = 0;
 unsigned long releasedTimeSet = 0;
 unsigned long pressedTimeUp  = 0;
@@ -83,73 +144,127 @@ bool isPressingDown = false;
 bool isLongDetected = false;
 int cmdType = 0; 
 char cmd[10];
-float pump_amount = 1.0;
-float pump_wait = 60.0;
-float target_ph = 6.3;
-float phBuff = 0.1;
-float isF = 0.0; 
-bool first_run = true;
-bool isDosing = false;
-
-#define PHVALUEADDR 0x00
-
-float readFloatFromEEPROM(int address) {
-    union {
-        byte b[4];
-        float f;
-    } u;
-
-    // Read 4 bytes from EEPROM
-    for (int i = 0; i < 4; i++) {
-        u.b[i] = EEPROM.read(PHVALUEADDR+ address + i);
-    }
-    return u.f;
-}
-
 
 void setup()
 {
     Serial.begin(115200); 
-    ads.setGain(GAIN_TWOTHIRDS); 
-    ads.begin();
-    ads.startComparator_SingleEnded(0, 1000);
-    EEPROM.begin(512);
-    pump.setPin(PUMP_PIN);
+    unsigned long bootStart = millis();
+    bootStepAt = bootStart;
+    Serial.print(F("Boot:"));
+    if(Board::hasAds1115) {
+      adc.begin(ADS_DATA_RATE);         // converts in the background while the rest starts
+      capture.begin(adc, Serial);
+    } else if(Board::hasInternalAdc) {
+      if(!espAdc.begin()) {             // DMA from here on, blocks of frames are averaged by service()
+        Serial.print(F(" adc DMA refused, polling"));   // service() falls back to ESP_ADC_POLLED reads
+      }
+      phAdc = &espAdc;
+    }
+    bootStep(F("adc"));
+    settings.begin();
+    settings.subscribe(onSettingsChanged);
+    bootStep(F("settings"));
+    pump.setSettings(settings);
+    pump.setPin(Board::pumpPin);
+    pump.setDoseBudget(MAX_ML_PER_HOUR);
+    flowCurve.begin();
+    pump.setFlowCurve(flowCurve);
+    settings.setFlowCurve(&flowCurve);  // EXPORT and IMPORT carry the curve too
+    stats.begin();
+    pump.setStats(stats);
     setButton.setDebounceTime(50);
     upButton.setDebounceTime(50);
     downButton.setDebounceTime(20);
-    ph.begin();
-    pump.getFlowRateAndSpeed();
-    target_ph = readFloatFromEEPROM(8);
-    isF = readFloatFromEEPROM(12);
-    pump_amount = readFloatFromEEPROM(16);
-    pump_wait = readFloatFromEEPROM(20);
-    phBuff = readFloatFromEEPROM(40);
+    setButton.begin();
+    upButton.begin();
+    downButton.begin();
+    bootStep(F("io"));
+    doseModel.begin();
+    dosing.setDoseModel(&doseModel);
+    estimator.setDoseModel(&doseModel);
+    gate.setBlanking(PUMP_BLANKING_MS);
+    bootStep(F("model"));
+    ph.begin(settings);
+    mirror.begin(MIRROR_SERIAL, Board::screenWidth, Board::screenHeight);
+    ph.setDoseModel(doseModel);
+    ph.setTrendLog(trend);
+    ph.setPump(pump);
+    i2cBus.begin(Board::i2cClock);      // after the ADC and display have started Wire
+    sensors.setWaitForConversion(false);
+    sensors.requestTemperatures();      // first reading is picked up by the loop
+    temperatureAt = millis();
+    bootStep(F("display"));
+    if(warmState.begin() && warmState.resume(millis(), dosing, gate, phValue, temperature)) {
+      ph.showReading(phValue, temperature, dosing.isDosing());    // carry on with the wait, no fresh reading and dose
+      bootStep(F("resumed"));
+    }
+#if MODBUS_ENABLE
+    updateModbusSettings(settings.get());
+    MODBUS_SERIAL.begin(MODBUS_BAUD, SERIAL_8N1, Board::modbusRxPin, Board::modbusTxPin);
+    modbus.begin(MODBUS_SERIAL, MODBUS_ADDRESS, MODBUS_BAUD, Board::modbusDePin);
+    modbus.setWriteHandler(modbusWrite);
+    bootStep(F("modbus"));
+#endif
+    monitor.begin(LOOP_DEADLINE_MS, loopFailsafe);
+    unsigned long bootMs = millis() - bootStart;
+    Serial.print(F(", total "));
+    Serial.print(bootMs);
+    Serial.println(bootMs > BOOT_BUDGET_MS ? F(" ms, over budget") : F(" ms"));
+    monitor.report(Serial);
+    heapMonitor.seal();                 // nothing below allocates, HEAP_ASSERT holds the loop to that
+}
+
+void bootStep(const __FlashStringHelper *name)
+{
+    unsigned long now = millis();
+    Serial.print(' ');
+    Serial.print(name);
+    Serial.print(' ');
+    Serial.print(now - bootStepAt);
+    bootStepAt = now;
+}
+
+
+void loopFailsafe()
+{
+    pump.emergencyStop();               // runs in the guard task, the loop may be stuck on I2C
 }
 
 void loop()
 {
+    monitor.beginLoop();
+    monitor.stage(STAGE_PUMP);
     pump.update();
+    gate.update(millis(), pump.isRunning());
+    if(gate.takeReport() && gate.rejectedLastDose() > 0) {
+      Serial.print(F("Blanked "));
+      Serial.print(gate.rejectedLastDose());
+      Serial.print(F(" samples over "));
+      Serial.print(gate.heldLastDoseMs());
+      Serial.println(F(" ms"));
+    }
+    monitor.stage(STAGE_BUTTONS);
     setButton.loop(); // MUST call the loop() function first
     upButton.loop();
     downButton.loop();
     if(setButton.isPressed()){
-      pressedTimeSet = millis();
+      pressedTimeSet = setButton.pressedAt();
       isPressingSet = true;
       isLongDetected = false;
     } else if(upButton.isPressed()){
-      pressedTimeUp = millis();
+      pressedTimeUp = upButton.pressedAt();
       isPressingUp = true;
       isLongDetected = false;
     } else if(downButton.isPressed()){
-      pressedTimeDown = millis();
+      pressedTimeDown = downButton.pressedAt();
       isPressingDown = true;
       isLongDetected = false;
     }
 
     if(setButton.isReleased()) {
+      TRACE_INSTANT(TRACK_MENU, "set", cmdType);
       isPressingSet = false;
-      releasedTimeSet = millis();
+      releasedTimeSet = setButton.releasedAt();
 
       long pressDuration = releasedTimeSet - pressedTimeSet;
 
@@ -175,14 +290,12 @@ void loop()
           char cmd[] = "sfrate";
           cmdType=9;
           ph.calibration(voltage,temperature,cmd);
-          pump.getFlowRateAndSpeed();
           strcpy(cmd, "1gp");
           ph.calibration(voltage,temperature,cmd);
         } else if(cmdType == 14) {
           char cmd[] = "samnt";
           cmdType=10;
           ph.calibration(voltage,temperature,cmd);
-          pump_amount = readFloatFromEEPROM(16);
           strcpy(cmd, "2gp");
           ph.calibration(voltage,temperature,cmd);
         } else if(cmdType == 11) {
@@ -193,7 +306,6 @@ void loop()
           char cmd[] = "swtime";
           cmdType=11;
           ph.calibration(voltage,temperature,cmd);
-          pump_wait = readFloatFromEEPROM(20);
           strcpy(cmd, "3gp");
           ph.calibration(voltage,temperature,cmd);
         } else if(cmdType == 12) {
@@ -219,7 +331,6 @@ void loop()
           cmdType=9;
           ph.calibration(voltage,temperature,cmd);
           pump.pumpCalibration(3);
-          pump.getFlowRateAndSpeed();
           char cmd2[] = "4gp";
           ph.calibration(voltage,temperature,cmd2);
         } else if(cmdType == 20) {
@@ -227,7 +338,7 @@ void loop()
            cmdType=21;
            ph.calibration(voltage,temperature,cmd);
         } else if(cmdType == 21) {
-           pump.flowPump(2.0);
+           pump.flowPump(2.0, DOSE_CALIBRATION);
            cmdType=20;
            char cmd2[] = "5gp";
            ph.calibration(voltage,temperature,cmd2);
@@ -239,33 +350,55 @@ void loop()
           char cmd[] = "buff";
           cmdType=24;
           ph.calibration(voltage,temperature,cmd);
+        } else if(cmdType == 25) {
+          char cmd[] = "diag";
+          cmdType = 26;
+          ph.calibration(voltage,temperature,cmd);
+        } else if(cmdType == 26) {
+          char cmd[] = "stats";
+          cmdType = 31;
+          ph.calibration(voltage,temperature,cmd);
+        } else if(cmdType == 31) {
+          char cmd[] = "7gp";
+          cmdType = 25;
+          ph.calibration(voltage,temperature,cmd);
+        } else if(cmdType == 27) {
+          char cmd[] = "trendh";
+          cmdType = 28;
+          ph.calibration(voltage,temperature,cmd);
+        } else if(cmdType == 28) {
+          char cmd[] = "trendd";
+          cmdType = 29;
+          ph.calibration(voltage,temperature,cmd);
+        } else if(cmdType == 29) {
+          char cmd[] = "trendw";
+          cmdType = 30;
+          ph.calibration(voltage,temperature,cmd);
+        } else if(cmdType == 30) {
+          char cmd[] = "8gp";
+          cmdType = 27;
+          ph.calibration(voltage,temperature,cmd);
         } else if(cmdType == 24) {
             char cmd[] = "sbuff";
             cmdType = 23;
             ph.calibration(voltage,temperature,cmd);
             char cmd2[] = "6gp";
             ph.calibration(voltage,temperature,cmd2);
-            phBuff = readFloatFromEEPROM(40);
          }
       }
     }
 
     if(upButton.isReleased()) {
+      TRACE_INSTANT(TRACK_MENU, "up", cmdType);
       isPressingUp = false;
-      releasedTimeUp = millis();
+      releasedTimeUp = upButton.releasedAt();
 
       long pressDuration = releasedTimeUp - pressedTimeUp;
 
-      if( pressDuration < SHORT_PRESS_TIME ) {
+      if( pressDuration < SHORT_PRESS_TIME && upButton.repeatCount() == 0 ) {
           if(cmdType == 0){
-            if(isF == 1.0) {
-              isF=0.0;
-            } else {
-              isF=1.0;
-            }
             strcpy(cmd, "tt");
             ph.calibration(voltage,temperature,cmd);
-            first_run = true;
           } else if(cmdType == 4){
             strcpy(cmd, "pt");
             ph.calibration(voltage,temperature,cmd);
@@ -308,18 +441,27 @@ void loop()
           } else if(cmdType == 24) {
             strcpy(cmd, "pbuff");
             ph.calibration(voltage,temperature,cmd);
+          } else if(cmdType == 25) {
+            strcpy(cmd, "6gp");
+            cmdType=23;
+            ph.calibration(voltage,temperature,cmd);
+          } else if(cmdType == 27) {
+            strcpy(cmd, "7gp");
+            cmdType=25;
+            ph.calibration(voltage,temperature,cmd);
           }
         }
       }
 
 
     if(downButton.isReleased()) {
+      TRACE_INSTANT(TRACK_MENU, "down", cmdType);
       isPressingDown = false;
-      releasedTimeDown = millis();
+      releasedTimeDown = downButton.releasedAt();
 
       long pressDuration = releasedTimeDown - pressedTimeDown;
 
-      if( pressDuration < SHORT_PRESS_TIME ) {
+      if( pressDuration < SHORT_PRESS_TIME && downButton.repeatCount() == 0 ) {
          if(cmdType == 4){
               strcpy(cmd, "mt");
               ph.calibration(voltage,temperature,cmd);
@@ -344,7 +486,7 @@ void loop()
               cmdType=20;
               ph.calibration(voltage,temperature,cmd);
         } else if(cmdType == 0) {
-            pump.stop();
+            pump.release(DOSE_MANUAL);           // a control dose queued behind the top-up runs on
         } else if(cmdType == 13) {
           strcpy(cmd, "mfrate");
           ph.calibration(voltage,temperature,cmd);
@@ -355,7 +497,7 @@ void loop()
           strcpy(cmd, "mwtime");
           ph.calibration(voltage,temperature,cmd);
         }  else if(cmdType == 17) {
-          pump.stop();
+          pump.release(DOSE_MANUAL);
         } else if(cmdType == 19) {
           strcpy(cmd, "pcalm");
           ph.calibration(voltage,temperature,cmd);
@@ -363,6 +505,14 @@ void loop()
           cmdType=23;
           strcpy(cmd, "6gp");
           ph.calibration(voltage,temperature,cmd);
+        } else if(cmdType == 23) {
+          cmdType=25;
+          strcpy(cmd, "7gp");
+          ph.calibration(voltage,temperature,cmd);
+        } else if(cmdType == 25) {
+          cmdType=27;
+          strcpy(cmd, "8gp");
+          ph.calibration(voltage,temperature,cmd);
         } else if(cmdType == 24) {
             strcpy(cmd, "mbuff");
             ph.calibration(voltage,temperature,cmd);
@@ -370,12 +520,21 @@ void loop()
       }
     }
 
+    if(valueStep(cmdType, true) != NULL) {
+      if(isPressingUp == true && upButton.isRepeat()) {
+        strcpy(cmd, valueStep(cmdType, true));
+        ph.calibration(voltage,temperature,cmd);
+      } else if(isPressingDown == true && downButton.isRepeat()) {
+        strcpy(cmd, valueStep(cmdType, false));
+        ph.calibration(voltage,temperature,cmd);
+      }
+    }
+
     if(isPressingSet == true && isLongDetected == false) {
       long pressDuration = millis() - pressedTimeSet;
       if( pressDuration > LONG_PRESS_TIME ) {
-        isDosing = false;
+        dosing.stop();
         pump.stop();
-        pump_wait = readFloatFromEEPROM(20);
         if(cmdType == 0) {
           strcpy(cmd, "enterph");
           cmdType=1;
@@ -384,13 +543,11 @@ void loop()
           strcpy(cmd, "exitph");
           cmdType=0;
           ph.calibration(voltage,temperature,cmd);
-          first_run = true;
+          dosing.restart();
         } else if(cmdType == 4) {
           strcpy(cmd, "st");
           cmdType=0;
           ph.calibration(voltage,temperature,cmd);
-          target_ph = readFloatFromEEPROM(8);
-          first_run = true;
         } 
         isLongDetected = true;
         
@@ -399,76 +556,217 @@ void loop()
 
     if(isPressingDown == true) {
       if(cmdType == 0 || cmdType == 17) {
-        pump.flowPump(PUMP_MOMENTARY);
+        pump.flowPump(PUMP_MOMENTARY, DOSE_MANUAL, cmdType == 0 ? onManualDose : NULL);   // tops up while held
       } 
     }
 
 
 
-    static unsigned long timepoint = millis();
-    if ((isPressingSet == false && isPressingDown == false && isPressingUp == false && cmdType == 0) || first_run == true || cmdType == 2) {
-      if (millis()-timepoint> pump_wait * 60000UL  || first_run == true || cmdType == 2 ) {                  //time interval: 1s
-          first_run = false;
-          timepoint = millis();
-          temperature = readTemperature();         // read your temperature sensor to execute temperature compensation
-          //voltage = analogRead(PH_PIN)/4096.0*5000;  // read the voltage
-          //voltage = analogRead(PH_PIN) / ESPADC * ESPVOLTAGE;
-          voltage = ads_read(); // / ESPADC * ESPVOLTAGE;
-          if(cmdType == 2) {
-            strcpy(cmd, "calph");
-            ph.calibration(voltage,temperature,cmd);
-          } else {
-            phValue = ph.readPH(voltage,temperature, isDosing);  // convert voltage to pH with temperature compensation
-          }
-          if(phValue - phBuff > target_ph && cmdType != 2) {
-            isDosing = true;
-            pump_wait = WAIT_BETWEEN_DOSE;
-            pump.flowPump(pump_amount);
-          } else {
-            if(isDosing == true) {
-              isDosing = false;
-              pump.stop();
-              Serial.println(F("Reached Target"));
-              pump_wait = readFloatFromEEPROM(20);
-              first_run = true;
+    const SettingsData &config = settings.get();
+    bool idle = isPressingSet == false && isPressingDown == false && isPressingUp == false && cmdType == 0;
+    monitor.stage(STAGE_ADC);
+    if(capture.active()) {
+      capture.service();                       // owns the ADC and the serial port until it ends
+    } else {
+      phAdc->service();
+    }
+    monitor.stage(STAGE_TEMPERATURE);
+    updateTemperature();
+    bool liveDue = millis() - liveAt >= LIVE_PERIOD_MS;
+    bool decide = dosing.due(millis(), idle, config);
+    bool live = liveDue && (cmdType == 0 || cmdType == 2);
+    if (!capture.active() && temperatureReady && (live || decide) && (decide ? gate.accept(millis()) : gate.open())) {
+      liveAt = millis();
+      if(decide) {                             // only dosing readings count, in STATS and in the gate's held off samples
+        stats.sampled();
+      }
+      monitor.stage(STAGE_ADC);
+      voltage = phAdc->readMillivolts();       // LSB size follows the auto-ranged gain on the ADS1115
+      monitor.stage(STAGE_DISPLAY);
+      if(cmdType == 2) {
+        strcpy(cmd, "calph");
+        ph.calibration(voltage,temperature,cmd);
+      } else {
+        float probePh = ph.toPH(voltage, temperature);  // convert voltage to pH with temperature compensation
+        trend.add(millis(), probePh);
+        estimator.update(millis(), probePh, temperature);
+        phValue = estimator.ph();                // the dosing decision, display and Modbus follow the estimate
+        ph.showReading(phValue, temperature, dosing.isDosing(), estimator.uncertainty());
+        if(decide) {                             // the live view runs at LIVE_PERIOD_MS, dosing every pumpWait
+          float ml = dosing.measured(millis(), phValue, probePh, config);   // the dose model learns from the probe, not its own prediction
+          if(ml > 0) {
+            float runTime = pump.flowPump(ml, DOSE_CONTROL, onControlDose);
+            if(runTime > 0) {
+              dosing.doseStarted(pump.lastDoseMl(), probePh, runTime);   // the budget may have shortened it
             }
+          } else if(dosing.reachedTarget()) {
+            pump.stop();
+            Serial.println(F("Reached Target"));
+            doseModel.save();
+            stats.flush();                     // end of a dosing run, a good time for the counters too
           }
-          // Serial.print(F("temperature:"));
-          // Serial.print(temperature,1);
-          // if(isF == 1) {
-          //   Serial.print(F("^F  pH:"));
-          // } else {
-          //   Serial.print(F("^C  pH:"));
-          // }
-          //Serial.println(phValue,2);
+        }
       }
+      // Serial.print(F("temperature:"));
+      // Serial.print(temperature,1);
+      // if(isF == 1) {
+      //   Serial.print(F("^F  pH:"));
+      // } else {
+      //   Serial.print(F("^C  pH:"));
+      // }
+      //Serial.println(phValue,2);
     }
+    if(!capture.active()) {
+      monitor.stage(STAGE_DISPLAY);
+      if(Board::hasAds1115 && (cmdType == 0 || cmdType == 2)) {
+        i2cBus.due(BUS_ADC, liveAt + LIVE_PERIOD_MS);   // a page that would still be sending then waits for the reading
+      }
+      ph.serviceDisplay();                     // one OLED page per loop, the ADC never waits for a whole frame
+    }
+    monitor.stage(STAGE_SERIAL);
     ph.calibration(voltage,temperature);           // calibration process by Serail CMD
+#if MODBUS_ENABLE
+    monitor.stage(STAGE_MODBUS);
+    updateModbus();
+    modbus.poll();
+#endif
+    stats.service(millis());
+    warmState.save(millis(), dosing, pump.isRunning(), phValue, temperature);
+    monitor.endLoop();
+}
+
+
+const char *valueStep(int type, bool up)
+{
+  // windows where UP/DOWN change a value and may auto-repeat
+  switch(type) {
+    case 4:  return up ? "pt" : "mt";
+    case 13: return up ? "pfrate" : "mfrate";
+    case 14: return up ? "pamnt" : "mamnt";
+    case 15: return up ? "pwtime" : "mwtime";
+    case 19: return up ? "pcalp" : "pcalm";
+    case 24: return up ? "pbuff" : "mbuff";
+  }
+  return NULL;
+}
+
+
+void onControlDose(const DoseJob &job)
+{
+  estimator.dose(job.delivered);
+  if(job.state == DOSE_CANCELLED) {
+    dosing.delivered(job.delivered);    // learn from what went in, not what was asked for
+  }
+}
+
+
+void onManualDose(const DoseJob &job)
+{
+  estimator.dose(job.delivered);
 }
 
 
-int16_t ads_read(){ 
-  int16_t adc0;
-  int16_t mv=0;
-  adc0 = ads.getLastConversionResults();
-  mv = adc0 * 0.1875;
-  //Serial.print(mv); Serial.println(" mV");
-  return mv;
+void onSettingsChanged(const SettingsData &config, uint16_t changed)
+{
+  if(changed & (SETTING_TARGET | SETTING_ISF)) {
+    dosing.restart();                   // measure again against the new target or unit
+  }
+  if(changed & (SETTING_NEUTRAL | SETTING_ACID | SETTING_ISF)) {
+    estimator.reset();                  // readings before the calibration are on another scale
+  }
+  if(changed & (SETTING_NEUTRAL | SETTING_ACID)) {
+    stats.calibrated();
+  }
+#if MODBUS_ENABLE
+  updateModbusSettings(config);
+#endif
 }
 
 
-float readTemperature()
+void updateModbus()
 {
-  sensors.requestTemperatures(); 
+  modbus.setInput(MB_IN_PH, round(phValue * 100));
+  modbus.setInput(MB_IN_TEMPERATURE, round(temperature * 10));
+  modbus.setInput(MB_IN_VOLTAGE, round(voltage));
+  modbus.setInput(MB_IN_DOSING, dosing.isDosing());
+  modbus.setInput(MB_IN_PUMP_RUNNING, pump.isRunning());
+  modbus.setInput(MB_IN_MENU, cmdType);
+}
+
+
+void updateModbusSettings(const SettingsData &config)
+{
+  modbus.setHolding(MB_HOLD_TARGET, round(config.targetPh * 100));
+  modbus.setHolding(MB_HOLD_AMOUNT, round(config.pumpAmount * 100));
+  modbus.setHolding(MB_HOLD_WAIT, round(config.pumpWait * 10));
+  modbus.setHolding(MB_HOLD_BUFFER, round(config.phBuff * 100));
+  modbus.setHolding(MB_HOLD_FLOW_RATE, round(config.flowRate * 100));
+  modbus.setHolding(MB_HOLD_TEMP_UNIT, config.isF == 1.0);
+  modbus.setHolding(MB_HOLD_CALIBRATE, 0);
+}
+
+
+// the settings field behind each holding register below MB_HOLD_CALIBRATE and its scale,
+// written through Settings::setField() so the bounds are the ones SET and the menus use
+const uint16_t MODBUS_FIELDS[] = {SETTING_TARGET, SETTING_AMOUNT, SETTING_WAIT, SETTING_PHBUFF, SETTING_FLOWRATE, SETTING_ISF};
+const float MODBUS_SCALES[] = {100, 100, 10, 100, 100, 1};
+
+
+bool modbusWrite(uint16_t start, const uint16_t *values, uint16_t count)
+{
+  // every register is checked before anything changes, then one settings commit
+  SettingsData config = settings.get();
+  int16_t calibrate = 0;
+  for(uint16_t i = 0; i < count; i++) {
+    uint16_t reg = start + i;
+    int16_t v = (int16_t)values[i];
+    if(reg < MB_HOLD_CALIBRATE) {
+      if(!settings.setField(config, MODBUS_FIELDS[reg], v / MODBUS_SCALES[reg])) return false;
+    } else if(reg == MB_HOLD_CALIBRATE) {
+      bool inCalibration = cmdType == 1 || cmdType == 2;
+      if(!(v == MB_CAL_ENTER && cmdType == 0) && !((v == MB_CAL_CALIBRATE || v == MB_CAL_EXIT) && inCalibration)) {
+        return false;
+      }
+      calibrate = v;
+    }
+  }
+  if(!Settings::valid(config)) {
+    return false;
+  }
+  settings.commit(config);
+  if(calibrate == MB_CAL_ENTER) {
+    dosing.stop();
+    pump.stop();
+    strcpy(cmd, "enterph");
+    cmdType = 1;
+    ph.calibration(voltage,temperature,cmd);
+  } else if(calibrate == MB_CAL_CALIBRATE) {
+    cmdType = 2;
+  } else if(calibrate == MB_CAL_EXIT) {
+    strcpy(cmd, "exitph");
+    cmdType = 0;
+    ph.calibration(voltage,temperature,cmd);
+    dosing.restart();
+  }
+  return true;
+}
+
+
+void updateTemperature()
+{
+  if(millis() - temperatureAt < TEMPERATURE_CONVERSION_MS) {
+    return;
+  }
   // Serial.print("Celsius temperature: ");
   // Serial.print(sensors.getTempCByIndex(0)); 
   // Serial.print(" - Fahrenheit temperature: ");
   // Serial.println(sensors.getTempFByIndex(0));
-  // delay(1000);
-  if(isF == 1.0) {
-    return sensors.getTempFByIndex(0);
+  if(settings.get().isF == 1.0) {
+    temperature = sensors.getTempFByIndex(0);
   } else {
-    return sensors.getTempCByIndex(0);
+    temperature = sensors.getTempCByIndex(0);
   }
-  
+  temperatureReady = true;
+  sensors.requestTemperatures();       // returns at once, read on the next call
+  temperatureAt = millis();
 }
@@ -0,0 +1,132 @@
+//Noise and CPU cost of a probe reading from the ADS1115 and from the
+//ESP32's own ADC through EspAdc, on a simulated probe at a fixed voltage.
+//
+//The ADS1115 and the ESP32 converter are models with the numbers below.
+//The EspAdc block averaging is the controller code, its cost is measured on
+//the host. Conversion and I2C times are taken from the datasheets, not
+//measured. Offset and gain errors left by the eFuse calibration are not
+//modelled, the two buffer pH calibration takes them out.
+//
+//  g++ -std=c++17 -O2 -Itools/sweep/host -Icode -o adc_bench
+//      tools/bench/adc.cpp code/EspAdc.cpp
+//  ./adc_bench [readings]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "EspAdc.h"
+
+#define PROBE_MV 1700.0             //between the pH 7 and pH 4 buffers
+#define PH_PER_MV (3.0 / (2032.44 - 1500.0))    //the default calibration's slope
+
+#define ADS_LSB_MV 0.125            //+-4.096 V range, where AdsAutoRange puts 1.7 V
+#define ADS_NOISE_MV 0.0625         //rms at 128 SPS on that range, datasheet table
+#define ADS_READ_US 150             //I2C pointer write and 2 byte read at 400 kHz, the loop waits for it
+
+#define ESP_LSB_MV 0.806            //12 bits at 11 dB
+#define ESP_NOISE_MV 6.0            //rms of a single conversion, typical for a DevKit
+#define ESP_POLLED_US 12            //one analogReadMilliVolts()
+
+static std::mt19937 rng(1);
+
+static int espConversion()          //one conversion through the eFuse calibration, whole mV
+{
+    std::normal_distribution<double> noise(0, ESP_NOISE_MV);
+    double counts = std::round((PROBE_MV + noise(rng)) / ESP_LSB_MV);
+    return (int)std::lround(counts * ESP_LSB_MV);
+}
+
+uint32_t analogReadMilliVolts(uint8_t)
+{
+    return espConversion();
+}
+
+void analogSetPinAttenuation(uint8_t, adc_attenuation_t)
+{
+}
+
+static int espFrame()               //what the DMA driver hands over: the mean of ESP_ADC_OVERSAMPLE conversions, whole mV
+{
+    long sum = 0;
+    for(int i = 0; i < ESP_ADC_OVERSAMPLE; i++) {
+        sum += espConversion();
+    }
+    return (int)std::lround((double)sum / ESP_ADC_OVERSAMPLE);
+}
+
+struct Result
+{
+    const char *name;
+    double rmsMv;
+    double cpuUs;                   //per reading
+    double conversions;             //per reading
+};
+
+static double rms(const std::vector<float> &readings)
+{
+    double sum = 0;
+    for(float r : readings) {
+        sum += (r - PROBE_MV) * (r - PROBE_MV);
+    }
+    return sqrt(sum / readings.size());
+}
+
+static void print(const Result &r)
+{
+    printf("%-22s %8.3f mV %8.4f pH %10.1f us %8.0f\n", r.name, r.rmsMv, r.rmsMv * PH_PER_MV, r.cpuUs, r.conversions);
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000;
+    std::vector<float> readings(count);
+
+    std::normal_distribution<double> adsNoise(0, ADS_NOISE_MV);
+    for(float &r : readings) {
+        r = std::round((PROBE_MV + adsNoise(rng)) / ADS_LSB_MV) * ADS_LSB_MV;
+    }
+    Result ads = {"ADS1115 128 SPS", rms(readings), ADS_READ_US, 1};
+
+    for(float &r : readings) {
+        r = espConversion();
+    }
+    Result single = {"ESP32 analogRead", rms(readings), ESP_POLLED_US, 1};
+
+    //DMA: frames are made outside the timed part, only EspAdc's own work is timed
+    std::vector<int> frames(count * ESP_ADC_BLOCK);
+    for(int &f : frames) {
+        f = espFrame();
+    }
+    EspAdc dma(34);
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < count; i++) {
+        for(int b = 0; b < ESP_ADC_BLOCK; b++) {
+            dma.add(frames[i * ESP_ADC_BLOCK + b]);
+        }
+        readings[i] = dma.readMillivolts();
+    }
+    double dmaUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / count;
+    Result continuous = {"ESP32 DMA EspAdc", rms(readings), dmaUs, ESP_ADC_OVERSAMPLE * ESP_ADC_BLOCK};
+
+    EspAdc polled(34);
+    for(size_t i = 0; i < count; i++) {
+        for(int b = 0; b < ESP_ADC_BLOCK; b++) {
+            polled.service();       //the path for cores without analogContinuous()
+        }
+        readings[i] = polled.readMillivolts();
+    }
+    Result fallback = {"ESP32 polled EspAdc", rms(readings), ESP_POLLED_US * ESP_ADC_POLLED * ESP_ADC_BLOCK, ESP_ADC_POLLED * ESP_ADC_BLOCK};
+
+    printf("%zu readings of a %.0f mV probe\n", count, PROBE_MV);
+    printf("%-22s %11s %11s %13s %8s\n", "", "noise", "as pH", "CPU/reading", "conv.");
+    print(ads);
+    print(single);
+    print(continuous);
+    print(fallback);
+    printf("DMA conversions take no CPU, the DMA figure is EspAdc's averaging on this host\n");
+    return 0;
+}
@@ -0,0 +1,88 @@
+//Dose volume error and time of the pump across dose sizes on the host,
+//single speed against the flow curve with a fast phase and a slow finish.
+//The simulated pump has a nonlinear speed to flow curve, a spin-up delay,
+//a stop lag and the loop period as jitter on every phase change.
+//
+//  g++ -std=c++17 -O2 -Itools/sweep/host -Icode -o dose_bench
+//      tools/bench/dose_volume.cpp code/FlowCurve.cpp
+//  ./dose_bench [trials]
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "FlowCurve.h"
+
+#define SPIN_UP_MS 100.0        //no flow yet after a start, not quite what FlowCurve assumes
+#define STOP_LAG_MS 50.0        //still flowing after the stop
+#define LOOP_MS 20.0            //phases end on the next loop pass
+
+static const int SPEEDS[] = {110, 130, 160, 180};
+static const int SINGLE_SPEED = 160;    //the settings default
+
+static double trueRate(int speed)       //ml/s, dead band near stop, saturating at full speed
+{
+    double offset = abs(speed - FLOW_SERVO_STOP);
+    return offset <= 8 ? 0 : 2.4 * tanh((offset - 8) / 40);
+}
+
+//ml delivered by phases run back to back, the pump only starts and stops once
+static double deliver(const int *speed, const double *ms, int phases, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<double> jitter(0, LOOP_MS);
+    double ml = 0;
+    double lost = SPIN_UP_MS;
+    for(int i = 0; i < phases; i++) {
+        double run = ms[i] + jitter(rng) - lost;
+        lost = 0;
+        ml += trueRate(speed[i]) * std::max(0.0, run) / 1000;
+    }
+    return ml + trueRate(speed[phases - 1]) * STOP_LAG_MS / 1000;
+}
+
+int main(int argc, char **argv)
+{
+    int trials = argc > 1 ? atoi(argv[1]) : 1000;
+    std::mt19937 rng(1);
+
+    //calibrate as PUMPCAL does, 15 s into a measuring cup
+    FlowCurve curve;
+    double singleRate = 0;
+    for(int speed : SPEEDS) {
+        double ms = 15000;
+        double rate = deliver(&speed, &ms, 1, rng) / 15;
+        curve.setPoint(speed, rate);
+        if(speed == SINGLE_SPEED) {
+            singleRate = rate;
+        }
+    }
+
+    static const double SIZES[] = {0.1, 0.15, 0.2, 0.5, 1, 2, 5, 10, 20};
+    printf("%8s | %22s | %22s\n", "", "single speed", "fast + slow finish");
+    printf("%8s | %10s %11s | %10s %11s\n", "ml", "rms err %", "time s", "rms err %", "time s");
+    for(double ml : SIZES) {
+        double singleError = 0, curveError = 0, singleTime = 0, curveTime = 0;
+        for(int t = 0; t < trials; t++) {
+            double ms = 1000 * ml / singleRate;
+            double got = deliver(&SINGLE_SPEED, &ms, 1, rng);
+            singleError += (got - ml) * (got - ml);
+            singleTime += ms / 1000;
+
+            DosePlan plan;
+            if(!curve.plan(ml, SINGLE_SPEED, plan)) {   //below FLOW_PLAN_MIN_ML, GravityPump doses at pumpSpeed
+                plan.coarseMs = 0;
+                plan.fineSpeed = SINGLE_SPEED;
+                plan.fineMs = 1000 * ml / singleRate;
+            }
+            int speeds[2] = {plan.coarseSpeed, plan.fineSpeed};
+            double phases[2] = {(double)plan.coarseMs, (double)plan.fineMs};
+            got = plan.coarseMs > 0 ? deliver(speeds, phases, 2, rng) : deliver(&speeds[1], &phases[1], 1, rng);
+            curveError += (got - ml) * (got - ml);
+            curveTime += (plan.coarseMs + plan.fineMs) / 1000.0;
+        }
+        printf("%8.2f | %10.1f %11.2f | %10.1f %11.2f\n", ml, 100 * sqrt(singleError / trials) / ml, singleTime / trials,
+               100 * sqrt(curveError / trials) / ml, curveTime / trials);
+    }
+    return 0;
+}
@@ -0,0 +1,80 @@
+//Per-update cost of PhEstimator on the host, and how far its estimate is
+//from the true pH compared to the raw probe on a simulated tank.
+//
+//  g++ -std=c++17 -O2 -Itools/sweep/host -Icode -o estimator_bench
+//      tools/bench/estimator.cpp code/PhEstimator.cpp code/DoseModel.cpp
+//  ./estimator_bench [updates]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "PhEstimator.h"
+#include "DoseModel.h"
+
+struct Sample
+{
+    unsigned long now;
+    float ph;                   //what the probe reads
+    float truth;
+    float temperature;
+    float doseMl;               //given right after this reading
+};
+
+static std::vector<Sample> simulate(size_t count)
+{
+    std::mt19937 rng(1);
+    std::normal_distribution<double> noise(0, 0.03);
+    std::vector<Sample> samples(count);
+    double ph = 7.5;
+    for(size_t i = 0; i < count; i++) {
+        double minute = i * 1.0;
+        ph += 0.002;                                    //drift up, one reading a minute
+        double temperature = 25 + 2 * sin(minute / 1440 * 2 * M_PI);
+        Sample &s = samples[i];
+        s.now = (unsigned long)(minute * 60000);
+        s.truth = ph;
+        s.ph = ph + noise(rng);
+        s.temperature = temperature;
+        s.doseMl = ph > 6.6 && i % 10 == 0 ? 1.0 : 0;
+        ph -= 0.1 * s.doseMl;
+    }
+    return samples;
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    std::vector<Sample> samples = simulate(count);
+
+    DoseModel model;
+    for(int i = 0; i < 5; i++) {
+        model.update(1.0, -0.1);                        //a model that has seen a few doses
+    }
+    PhEstimator estimator;
+    estimator.setDoseModel(&model);
+
+    double rawError = 0;
+    double estimateError = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(const Sample &s : samples) {
+        estimator.update(s.now, s.ph, s.temperature);
+        if(s.doseMl > 0) {
+            estimator.dose(s.doseMl);
+        }
+        estimateError += (estimator.ph() - s.truth) * (estimator.ph() - s.truth);
+    }
+    auto end = std::chrono::steady_clock::now();
+    for(const Sample &s : samples) {
+        rawError += (s.ph - s.truth) * (s.ph - s.truth);
+    }
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / count;
+    printf("%zu updates, %.1f ns per update (host)\n", count, ns);
+    printf("rms error: probe %.4f pH, estimate %.4f pH, last uncertainty %.4f pH\n",
+           sqrt(rawError / count), sqrt(estimateError / count), estimator.uncertainty());
+    return 0;
+}
@@ -0,0 +1,244 @@
+//Time to put each static OLED screen into the frame buffer, rasterized the
+//way Adafruit_GFX does it against copying its template from ScreenTemplates.h.
+//
+//The screens and their drawing calls come from tools/render_screens.py, so
+//they are the ones DFRobot_PH.cpp draws. The rasterizer follows the library:
+//clearDisplay(), then write() per character, drawChar() with the classic
+//5x7 font and transparent background, and SSD1306 drawPixel() with its
+//bounds and rotation checks. Text size 2 goes through drawPixel() per pixel
+//here, where the library uses fillRect(), so those screens come out a little
+//slow. Sending the buffer to the OLED is not timed. It is the same 1 KB
+//for both paths, sent one page per loop by BoardDisplay::service().
+//
+//  python3 tools/render_screens.py --font glcdfont.c --output /tmp/ScreenTemplates.h --ops screens.ops
+//  g++ -std=c++17 -O2 -o screens_bench tools/bench/screens.cpp
+//  ./screens_bench glcdfont.c screens.ops [repeats]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define WIDTH 128
+#define HEIGHT 64
+#define FRAME_SIZE (WIDTH * HEIGHT / 8)
+
+struct Op
+{
+    char kind;                      //'C' cursor, 'S' text size, 'T' text
+    int x, y;
+    std::string text;
+};
+
+struct Screen
+{
+    std::string name;
+    std::vector<Op> ops;
+    uint8_t frame[FRAME_SIZE];      //rasterized once, the template
+};
+
+static uint8_t font[256 * 5];
+
+static bool loadFont(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if(f == NULL) {
+        return false;
+    }
+    std::string text;
+    char chunk[4096];
+    size_t n;
+    while((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        text.append(chunk, n);
+    }
+    fclose(f);
+    size_t at = text.find('{');
+    int count = 0;
+    while(at != std::string::npos && count < 256 * 5) {
+        at = text.find("0x", at);
+        if(at == std::string::npos) {
+            break;
+        }
+        font[count++] = strtoul(text.c_str() + at, NULL, 16);
+        at += 2;
+    }
+    return count == 256 * 5;
+}
+
+static bool loadScreens(const char *path, std::vector<Screen> &screens)
+{
+    FILE *f = fopen(path, "r");
+    if(f == NULL) {
+        return false;
+    }
+    char line[512];
+    while(fgets(line, sizeof(line), f) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        if(strncmp(line, "SCREEN ", 7) == 0) {
+            screens.push_back(Screen());
+            screens.back().name = line + 7;
+            continue;
+        }
+        if(screens.empty()) {
+            continue;
+        }
+        Op op = {line[0], 0, 0, ""};
+        if(op.kind == 'C') {
+            sscanf(line + 2, "%d %d", &op.x, &op.y);
+        } else if(op.kind == 'S') {
+            op.x = atoi(line + 2);
+        } else if(op.kind == 'T') {
+            for(const char *h = line + 2; h[0] && h[1]; h += 2) {
+                char pair[3] = {h[0], h[1], 0};
+                op.text += (char)strtoul(pair, NULL, 16);
+            }
+        }
+        screens.back().ops.push_back(op);
+    }
+    fclose(f);
+    return !screens.empty();
+}
+
+//the parts of Adafruit_GFX and Adafruit_SSD1306 a static screen goes through
+class Display
+{
+public:
+    uint8_t buffer[FRAME_SIZE];
+
+    void clearDisplay() { memset(buffer, 0, sizeof(buffer)); }
+    void setCursor(int x, int y) { _x = x; _y = y; }
+    void setTextSize(int size) { _size = size; }
+    void print(const std::string &text)
+    {
+        for(char c : text) {
+            write((uint8_t)c);
+        }
+    }
+
+    virtual size_t write(uint8_t c)         //virtual as in Print
+    {
+        if(c == '\n') {
+            _x = 0;
+            _y += _size * 8;
+        } else if(c != '\r') {
+            if(_x + _size * 6 > WIDTH) {
+                _x = 0;
+                _y += _size * 8;
+            }
+            drawChar(_x, _y, c);
+            _x += _size * 6;
+        }
+        return 1;
+    }
+
+    virtual ~Display() {}
+
+private:
+    void drawChar(int x, int y, uint8_t c)
+    {
+        if(x >= WIDTH || y >= HEIGHT || x + 6 * _size - 1 < 0 || y + 8 * _size - 1 < 0) {
+            return;
+        }
+        if(c >= 176) {
+            c++;                            //cp437(false)
+        }
+        for(int i = 0; i < 5; i++) {
+            uint8_t line = font[c * 5 + i];
+            for(int j = 0; j < 8; j++, line >>= 1) {
+                if(line & 1) {
+                    for(int dx = 0; dx < _size; dx++) {
+                        for(int dy = 0; dy < _size; dy++) {
+                            drawPixel(x + i * _size + dx, y + j * _size + dy);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void drawPixel(int x, int y)
+    {
+        if(x >= 0 && x < WIDTH && y >= 0 && y < HEIGHT) {
+            switch(_rotation) {
+            case 1: std::swap(x, y); x = WIDTH - x - 1; break;
+            case 2: x = WIDTH - x - 1; y = HEIGHT - y - 1; break;
+            case 3: std::swap(x, y); y = HEIGHT - y - 1; break;
+            }
+            buffer[x + (y / 8) * WIDTH] |= 1 << (y & 7);
+        }
+    }
+
+    int _x = 0;
+    int _y = 0;
+    int _size = 1;
+    volatile int _rotation = 0;
+};
+
+static void rasterize(Display &display, const Screen &screen)
+{
+    display.clearDisplay();
+    display.setTextSize(1);
+    display.setCursor(0, 0);
+    for(const Op &op : screen.ops) {
+        if(op.kind == 'C') {
+            display.setCursor(op.x, op.y);
+        } else if(op.kind == 'S') {
+            display.setTextSize(op.x);
+        } else if(op.kind == 'T') {
+            display.print(op.text);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 3) {
+        fprintf(stderr, "usage: %s glcdfont.c screens.ops [repeats]\n", argv[0]);
+        return 2;
+    }
+    if(!loadFont(argv[1])) {
+        fprintf(stderr, "%s does not look like the GFX classic font\n", argv[1]);
+        return 1;
+    }
+    std::vector<Screen> screens;
+    if(!loadScreens(argv[2], screens)) {
+        fprintf(stderr, "no screens in %s\n", argv[2]);
+        return 1;
+    }
+    int repeats = argc > 3 ? atoi(argv[3]) : 20000;
+
+    Display display;
+    for(Screen &screen : screens) {
+        rasterize(display, screen);
+        memcpy(screen.frame, display.buffer, FRAME_SIZE);
+    }
+
+    using clock = std::chrono::steady_clock;
+    double rasterTotal = 0, blitTotal = 0, rasterWorst = 0;
+    unsigned long check = 0;
+    printf("%-20s %12s %12s %8s\n", "screen", "raster us", "blit us", "ratio");
+    for(const Screen &screen : screens) {
+        auto start = clock::now();
+        for(int r = 0; r < repeats; r++) {
+            rasterize(display, screen);
+            check += display.buffer[r % FRAME_SIZE];
+        }
+        double raster = std::chrono::duration<double, std::micro>(clock::now() - start).count() / repeats;
+        start = clock::now();
+        for(int r = 0; r < repeats; r++) {
+            memcpy(display.buffer, screen.frame, FRAME_SIZE);   //memcpy_P on the ESP32, flash is mapped
+            check += display.buffer[r % FRAME_SIZE];
+        }
+        double blit = std::chrono::duration<double, std::micro>(clock::now() - start).count() / repeats;
+        printf("%-20s %12.3f %12.3f %7.1fx\n", screen.name.c_str(), raster, blit, raster / blit);
+        rasterTotal += raster;
+        blitTotal += blit;
+        rasterWorst = std::max(rasterWorst, raster);
+    }
+    printf("%zu screens, mean %.3f us rasterized, %.3f us blitted, worst raster %.3f us (%lu)\n",
+           screens.size(), rasterTotal / screens.size(), blitTotal / screens.size(), rasterWorst, check & 1);
+    return 0;
+}
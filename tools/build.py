@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""Build the firmware with arduino-cli, screen templates first.
+
+  python3 tools/build.py [--fqbn esp32:esp32:esp32] [--profile BoardRevB] [-- extra arduino-cli args]
+  python3 tools/build.py --sizes
+
+Runs tools/render_screens.py with the glcdfont.c of the Adafruit_GFX that
+arduino-cli builds against, so code/ScreenTemplates.h always matches both
+DFRobot_PH.cpp and the installed font, then compiles the sketch. Without
+this step the firmware still builds but rasterizes every screen.
+--profile picks a board profile from code/BoardProfile.h. --sizes builds
+every profile and prints its flash and RAM use against BoardRevA's, what a
+board saves by leaving a subsystem out.
+"""
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SKETCH = os.path.join(ROOT, "code")
+RENDER = os.path.join(ROOT, "tools", "render_screens.py")
+FONT = os.path.join("libraries", "Adafruit_GFX_Library", "glcdfont.c")
+PROFILES = ["BoardRevA", "BoardRevB", "BoardRevC"]
+FLASH = re.compile(r"Sketch uses (\d+) bytes")
+RAM = re.compile(r"Global variables use (\d+) bytes")
+
+
+def user_dir():
+    out = subprocess.run(["arduino-cli", "config", "dump", "--format", "json"],
+                         check=True, capture_output=True, text=True).stdout
+    config = json.loads(out)
+    config = config.get("config", config)       # newer arduino-cli nests it
+    return os.path.expanduser(config["directories"]["user"])
+
+
+def compile_command(fqbn, profile, extra):
+    command = ["arduino-cli", "compile", "--fqbn", fqbn]
+    if profile:
+        command += ["--build-property", "compiler.cpp.extra_flags=-DBOARD_PROFILE=%s" % profile]
+    return command + extra + [SKETCH]
+
+
+def sizes(fqbn, extra):
+    rows = []
+    for profile in PROFILES:
+        result = subprocess.run(compile_command(fqbn, profile, extra), capture_output=True, text=True)
+        flash, ram = FLASH.search(result.stdout), RAM.search(result.stdout)
+        if result.returncode != 0 or not flash or not ram:
+            sys.stderr.write(result.stdout + result.stderr)
+            return 1
+        rows.append((profile, int(flash.group(1)), int(ram.group(1))))
+    print("%-10s %10s %8s %10s %8s" % ("profile", "flash", "vs A", "RAM", "vs A"))
+    for profile, flash, ram in rows:
+        print("%-10s %10d %+8d %10d %+8d" % (profile, flash, flash - rows[0][1], ram, ram - rows[0][2]))
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--fqbn", default="esp32:esp32:esp32")
+    parser.add_argument("--profile", help="BoardRevA, BoardRevB or BoardRevC")
+    parser.add_argument("--sizes", action="store_true", help="build every profile, print flash and RAM")
+    parser.add_argument("extra", nargs="*", help="passed on to arduino-cli compile")
+    args = parser.parse_args()
+
+    font = os.path.join(user_dir(), FONT)
+    if not os.path.exists(font):
+        sys.exit("%s not found, arduino-cli lib install \"Adafruit GFX Library\"" % font)
+    subprocess.run([sys.executable, RENDER, "--font", font], check=True)
+
+    if args.sizes:
+        return sizes(args.fqbn, args.extra)
+    return subprocess.run(compile_command(args.fqbn, args.profile, args.extra)).returncode
+
+
+if __name__ == "__main__":
+    sys.exit(main())
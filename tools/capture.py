@@ -0,0 +1,207 @@
+#!/usr/bin/env python3
+"""Record the raw ADS1115 stream of a controller and decode it.
+
+  python3 tools/capture.py record /dev/ttyUSB0 60 probe.csv [--npy probe.npy] [--save probe.bin]
+  python3 tools/capture.py decode probe.bin probe.csv [--npy probe.npy]
+
+`record` sends CAPTURE <seconds>, reads until the end frame and writes one
+row per conversion: index, time in s, counts, mV. The index counts
+conversion periods since the start, so missing indexes are samples the
+controller missed or frames it dropped, both are reported. `decode` does
+the same for bytes kept with --save. The frame format is documented in
+code/AdcCapture.h. Needs pyserial to record, numpy for --npy.
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+BAUD = 115200
+FRAME_DATA = 0x01
+FRAME_END = 0x02
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data) + 1:
+            raise ValueError("bad COBS")
+        out += data[i + 1:i + code]
+        i += code
+        if i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def decode_data(payload):
+    index, rng, count = struct.unpack_from("<IBB", payload, 1)
+    samples = [struct.unpack_from("<h", payload, 7)[0]]
+    pos = 9
+    while len(samples) < count:
+        delta = struct.unpack_from("<b", payload, pos)[0]
+        pos += 1
+        if delta == -128:
+            samples.append(struct.unpack_from("<h", payload, pos)[0])
+            pos += 2
+        else:
+            samples.append(samples[-1] + delta)
+    if pos != len(payload):
+        raise ValueError("length")
+    return index, rng, samples
+
+
+class Decoder:
+    def __init__(self):
+        self.header = None          # sps, range, uV per count
+        self.rows = []              # (index, counts)
+        self.frames = 0
+        self.bad = 0
+        self.device = None          # samples read, missed, frames dropped as the controller counted them
+        self._text = bytearray()
+        self._frame = bytearray()
+
+    def feed(self, data):
+        """Bytes from the port, returns True once the end frame is in."""
+        for byte in data:
+            if self.header is None:
+                self._line(byte)
+            elif byte == 0:
+                self._decode(bytes(self._frame))
+                self._frame.clear()
+                if self.device is not None:
+                    return True
+            else:
+                self._frame.append(byte)
+        return False
+
+    def _line(self, byte):
+        if byte != ord("\n"):
+            self._text.append(byte)
+            return
+        line = self._text.decode("ascii", "replace").strip()
+        self._text.clear()
+        if line.startswith("CAPTURE START "):
+            sps, rng, uv = line.split()[2:5]
+            self.header = (int(sps), int(rng), float(uv))
+        elif line.startswith("CAPTURE ERROR"):
+            raise RuntimeError("controller refused the capture, no ADS1115 or already running")
+
+    def _decode(self, frame):
+        if not frame:
+            return
+        try:
+            payload = cobs_decode(frame)
+            if len(payload) < 3 or crc16(payload[:-2]) != struct.unpack_from("<H", payload, len(payload) - 2)[0]:
+                raise ValueError("CRC")
+            payload = payload[:-2]
+            if payload[0] == FRAME_DATA:
+                index, _, samples = decode_data(payload)
+                self.rows.extend((index + i, s) for i, s in enumerate(samples))
+            elif payload[0] == FRAME_END:
+                self.device = struct.unpack_from("<III", payload, 1)
+            else:
+                raise ValueError("type")
+            self.frames += 1
+        except (ValueError, struct.error):
+            self.bad += 1
+
+    def gaps(self):
+        missing = 0
+        runs = 0
+        last = -1
+        for index, _ in self.rows:
+            if index > last + 1:
+                missing += index - last - 1
+                runs += 1
+            last = index
+        return missing, runs
+
+
+def read_port(path, seconds, save):
+    import serial
+    port = serial.Serial(path, BAUD, timeout=0.5)
+    port.dtr = False
+    port.rts = False
+    time.sleep(0.1)
+    port.reset_input_buffer()
+    port.write(b"CAPTURE %d\n" % seconds)
+    decoder = Decoder()
+    deadline = time.monotonic() + seconds + 5
+    raw = open(save, "wb") if save else None
+    try:
+        while time.monotonic() < deadline:
+            data = port.read(4096)
+            if raw:
+                raw.write(data)
+            if decoder.feed(data):
+                break
+        else:
+            port.write(b"CAPTURE STOP\n")
+    finally:
+        port.close()
+        if raw:
+            raw.close()
+    return decoder
+
+
+def main():
+    parser = argparse.ArgumentParser(description="raw ADS1115 capture over serial")
+    sub = parser.add_subparsers(dest="action", required=True)
+    p = sub.add_parser("record")
+    p.add_argument("port")
+    p.add_argument("seconds", type=int)
+    p.add_argument("csv", help="output, index,time_s,counts,mv")
+    p.add_argument("--npy", help="also write an N x 4 float64 array")
+    p.add_argument("--save", help="keep the bytes read from the port")
+    p = sub.add_parser("decode")
+    p.add_argument("raw", help="bytes kept by record --save")
+    p.add_argument("csv")
+    p.add_argument("--npy")
+    args = parser.parse_args()
+
+    if args.action == "record":
+        decoder = read_port(args.port, args.seconds, args.save)
+    else:
+        decoder = Decoder()
+        with open(args.raw, "rb") as f:
+            decoder.feed(f.read())
+    if decoder.header is None:
+        print("no CAPTURE START seen", file=sys.stderr)
+        return 1
+
+    sps, rng, uv = decoder.header
+    rows = [(i, i / sps, c, c * uv / 1000) for i, c in decoder.rows]
+    with open(args.csv, "w") as f:
+        f.write("index,time_s,counts,mv\n")
+        for row in rows:
+            f.write("%d,%.6f,%d,%.4f\n" % row)
+    if args.npy:
+        import numpy
+        numpy.save(args.npy, numpy.array(rows, dtype=numpy.float64).reshape(-1, 4))
+
+    missing, runs = decoder.gaps()
+    print("%d samples at %d SPS, range %d, %.4f uV per count" % (len(rows), sps, rng, uv))
+    print("%d frames, %d damaged, %d samples missing in %d gaps" % (decoder.frames, decoder.bad, missing, runs))
+    if decoder.device is None:
+        print("no end frame, the capture was cut short")
+        return 1
+    samples, missed, dropped = decoder.device
+    print("controller: %d samples read, %d missed by the loop, %d frames dropped on a full serial port"
+          % (samples, missed, dropped))
+    return 1 if decoder.bad else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
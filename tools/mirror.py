@@ -0,0 +1,216 @@
+#!/usr/bin/env python3
+"""Show a controller's OLED on the PC, rebuilt from its MIRROR stream.
+
+  python3 tools/mirror.py view /dev/ttyUSB0 [--period 50] [--save screen.bin] [--pgm screen.pgm]
+  python3 tools/mirror.py decode screen.bin screen.pgm
+
+`view` sends MIRROR <ms>, draws the screen in the terminal as it changes and
+sends MIRROR STOP on Ctrl-C. `decode` replays bytes kept with --save and
+writes the last screen as a PGM image. Frames carry only the changed pages,
+XORed with what was sent before, so a lost frame leaves a page wrong until
+the controller's periodic whole pages have gone round; `view` asks for a
+fresh start instead when it sees a gap. The frame format is documented in
+code/ScreenMirror.h. Needs pyserial to view.
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+from capture import BAUD, crc16, cobs_decode
+
+FRAME_DIFF = 0x11
+FRAME_PAGE = 0x12
+RESTART_S = 1.0                 # at most one MIRROR restart per this after a lost frame
+
+
+def rle_decode(data, width):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        c = data[i]
+        if c & 0x80:
+            out += bytes([data[i + 1]]) * ((c & 0x7F) + 1)
+            i += 2
+        else:
+            out += data[i + 1:i + 2 + c]
+            i += c + 2
+    if len(out) != width or i != len(data):
+        raise ValueError("length")
+    return out
+
+
+class Screen:
+    def __init__(self):
+        self.width = 0
+        self.height = 0
+        self.pages = []             # one bytearray per 8 rows, bit 0 the top row
+        self.known = []             # page has been sent whole since the last loss
+        self.sequence = None        # expected next
+        self.frames = 0
+        self.bad = 0
+        self.lost = 0
+        self.ended = False
+        self.error = False
+        self._chunk = bytearray()
+
+    def feed(self, data):
+        """Bytes from the port, returns True when the screen changed."""
+        changed = False
+        for byte in data:
+            if byte == 0:
+                changed |= self._frame(bytes(self._chunk))
+                self._chunk.clear()
+            elif byte == ord("\n"):
+                self._chunk.append(byte)
+                self._text()
+            else:
+                self._chunk.append(byte)
+        return changed
+
+    def stale(self):
+        return self.width > 0 and not all(self.known)
+
+    def _text(self):
+        # text lines come between frames, only the MIRROR ones matter
+        line = self._chunk.rsplit(b"\n", 2)[-2].decode("ascii", "replace").strip()
+        if line.startswith("MIRROR START "):
+            width, height = [int(v) for v in line.split()[2:4]]
+            if (width, height) != (self.width, self.height):
+                self.width = width
+                self.height = height
+                self.pages = [bytearray(width) for _ in range(height // 8)]
+            self.known = [False] * (height // 8)
+            self.sequence = 0
+            self._chunk.clear()
+        elif line.startswith("MIRROR END"):
+            self.ended = True
+        elif line.startswith("MIRROR ERROR"):
+            self.error = True
+
+    def _frame(self, chunk):
+        if not chunk or not self.pages:
+            return False
+        try:
+            payload = cobs_decode(chunk)
+            if len(payload) < 6 or crc16(payload[:-2]) != struct.unpack_from("<H", payload, len(payload) - 2)[0]:
+                raise ValueError("CRC")
+        except ValueError:
+            if not all(32 <= b < 127 or b in b"\r\n" for b in chunk):
+                self.bad += 1       # a damaged frame, the sequence gap marks the loss
+            return False
+        kind, sequence, page = struct.unpack_from("<BHB", payload)
+        try:
+            if kind not in (FRAME_DIFF, FRAME_PAGE) or page >= len(self.pages):
+                raise ValueError("type")
+            data = rle_decode(payload[4:-2], self.width)
+        except (ValueError, IndexError):
+            self.bad += 1
+            return False
+        if sequence != self.sequence:
+            self._lose()
+        self.sequence = (sequence + 1) & 0xFFFF
+        if kind == FRAME_PAGE:
+            self.pages[page][:] = data
+            self.known[page] = True
+        else:
+            self.pages[page][:] = bytes(a ^ b for a, b in zip(self.pages[page], data))
+        self.frames += 1
+        return True
+
+    def _lose(self):
+        self.lost += 1
+        self.known = [False] * len(self.known)
+
+    def pixel(self, x, y):
+        return self.pages[y // 8][x] >> (y % 8) & 1
+
+    def text(self):
+        """The screen as half block characters, two rows per line."""
+        blocks = " ▀▄█"
+        lines = []
+        for y in range(0, self.height, 2):
+            lines.append("".join(blocks[self.pixel(x, y) | self.pixel(x, y + 1) << 1] for x in range(self.width)))
+        return "\n".join(lines)
+
+    def pgm(self, path):
+        with open(path, "wb") as f:
+            f.write(b"P5 %d %d 255\n" % (self.width, self.height))
+            f.write(bytes(255 * self.pixel(x, y) for y in range(self.height) for x in range(self.width)))
+
+
+def draw(screen):
+    state = "stale, waiting for whole pages" if screen.stale() else "ok"
+    sys.stdout.write("\x1b[H\x1b[J%s\n%d frames, %d damaged, %d losses, %s\n"
+                     % (screen.text(), screen.frames, screen.bad, screen.lost, state))
+    sys.stdout.flush()
+
+
+def view(path, period, save):
+    import serial
+    port = serial.Serial(path, BAUD, timeout=0.05)
+    port.dtr = False
+    port.rts = False
+    time.sleep(0.1)
+    port.reset_input_buffer()
+    port.write(b"MIRROR %d\n" % period)
+    screen = Screen()
+    raw = open(save, "wb") if save else None
+    lost = 0
+    restart_at = 0
+    try:
+        while not screen.error:
+            data = port.read(4096)
+            if raw:
+                raw.write(data)
+            if screen.feed(data):
+                draw(screen)
+            if screen.lost > lost and time.monotonic() - restart_at > RESTART_S:
+                port.write(b"MIRROR %d\n" % period)     # every page again rather than waiting for the refresh
+                lost = screen.lost
+                restart_at = time.monotonic()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        port.write(b"MIRROR STOP\n")
+        port.close()
+        if raw:
+            raw.close()
+    return screen
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="action", required=True)
+    p = sub.add_parser("view", help="live screen in the terminal")
+    p.add_argument("port")
+    p.add_argument("--period", type=int, default=50, help="ms between pages")
+    p.add_argument("--save", help="keep the bytes read from the port")
+    p.add_argument("--pgm", help="write the last screen as an image")
+    p = sub.add_parser("decode", help="replay bytes kept with --save")
+    p.add_argument("raw")
+    p.add_argument("pgm")
+    args = parser.parse_args()
+
+    if args.action == "view":
+        screen = view(args.port, args.period, args.save)
+    else:
+        screen = Screen()
+        with open(args.raw, "rb") as f:
+            screen.feed(f.read())
+    if screen.error:
+        print("controller refused MIRROR, no OLED on this board", file=sys.stderr)
+        return 1
+    if not screen.pages:
+        print("no MIRROR START seen", file=sys.stderr)
+        return 1
+    if args.pgm:
+        screen.pgm(args.pgm)
+    print("%d frames, %d damaged, %d losses%s" % (screen.frames, screen.bad, screen.lost,
+                                                   ", screen may be off" if screen.stale() else ""))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
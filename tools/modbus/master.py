@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+"""Check the controller's Modbus RTU slave from a local master.
+
+  python3 tools/modbus/master.py ./modbus_slave
+
+Starts the host slave built from tools/modbus/slave.cpp, opens the pty it
+prints and runs the requests below against it, failing on the first wrong
+answer. The slave answers the number of settings commits in MB_IN_MENU, so
+the multiple register writes are checked for one commit when accepted and
+none, with every register unchanged, when one value is out of range. Uses
+only the standard library, the frames are built here.
+"""
+
+import os
+import struct
+import subprocess
+import sys
+import termios
+import time
+import tty
+
+ADDRESS = 1
+TIMEOUT_S = 0.3
+
+IN_MENU = 5                     # commit count on the host slave
+HOLD_TARGET = 0
+HOLD_AMOUNT = 1
+HOLD_WAIT = 2
+HOLD_FLOW_RATE = 4
+HOLD_COUNT = 7
+EX_ILLEGAL_ADDRESS = 2
+EX_ILLEGAL_VALUE = 3
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return crc
+
+
+def frame(body):
+    return body + struct.pack("<H", crc16(body))
+
+
+class Master:
+    def __init__(self, path):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        tty.setraw(self.fd)
+        termios.tcflush(self.fd, termios.TCIOFLUSH)
+        os.set_blocking(self.fd, False)
+
+    def transact(self, request, answered=True):
+        os.write(self.fd, request)
+        reply = b""
+        deadline = time.monotonic() + TIMEOUT_S
+        while time.monotonic() < deadline:
+            try:
+                reply += os.read(self.fd, 256)
+            except BlockingIOError:
+                time.sleep(0.005)
+        if not answered:
+            if reply:
+                raise AssertionError("unexpected reply %s" % reply.hex())
+            return None
+        if len(reply) < 5 or crc16(reply[:-2]) != struct.unpack("<H", reply[-2:])[0]:
+            raise AssertionError("bad reply %s" % reply.hex())
+        if reply[1] & 0x80:
+            return reply[2]         # exception code
+        return reply[:-2]
+
+    def read(self, function, start, count):
+        reply = self.transact(frame(struct.pack(">BBHH", ADDRESS, function, start, count)))
+        if isinstance(reply, int):
+            raise AssertionError("read exception %d" % reply)
+        return list(struct.unpack(">%dh" % count, reply[3:]))
+
+    def holding(self):
+        return self.read(0x03, 0, HOLD_COUNT)
+
+    def commits(self):
+        return self.read(0x04, IN_MENU, 1)[0]
+
+    def write_single(self, reg, value, address=ADDRESS):
+        return self.transact(frame(struct.pack(">BBHh", address, 0x06, reg, value)), address != 0)
+
+    def write_multiple(self, start, values, address=ADDRESS):
+        body = struct.pack(">BBHHB", address, 0x10, start, len(values), 2 * len(values))
+        body += struct.pack(">%dh" % len(values), *values)
+        return self.transact(frame(body), address != 0)
+
+
+def check(name, ok):
+    print("%-48s %s" % (name, "ok" if ok else "FAILED"))
+    if not ok:
+        sys.exit(1)
+
+
+def run(master):
+    before = master.holding()
+    commits = master.commits()
+    check("read holding and input registers", len(before) == HOLD_COUNT)
+
+    reply = master.write_single(HOLD_TARGET, 650)
+    check("single write echoed", isinstance(reply, bytes) and reply[1] == 0x06)
+    check("single write applied, one commit", master.holding()[HOLD_TARGET] == 650 and master.commits() == commits + 1)
+    commits += 1
+
+    values = [620, 75, 300, 15, 120]
+    reply = master.write_multiple(0, values)
+    check("multiple write acknowledged", isinstance(reply, bytes) and reply[1] == 0x10)
+    check("multiple write applied", master.holding()[:5] == values)
+    check("multiple write, one commit", master.commits() == commits + 1)
+    commits += 1
+
+    before = master.holding()
+    reply = master.write_multiple(0, [600, 50, 200, 20, 0])    # flow rate below the minimum
+    check("multiple write with a bad last value refused", reply == EX_ILLEGAL_VALUE)
+    check("refused write left every register", master.holding() == before)
+    check("refused write, no commit", master.commits() == commits)
+
+    refused = [(HOLD_TARGET, 0), (HOLD_AMOUNT, 5100), (HOLD_WAIT, 14410), (HOLD_FLOW_RATE, 1001)]    # past SET's bounds
+    check("values SET would refuse refused", all(master.write_single(r, v) == EX_ILLEGAL_VALUE for r, v in refused))
+    check("no commit for them", master.holding() == before and master.commits() == commits)
+
+    check("write past the table refused", master.write_multiple(HOLD_COUNT - 1, [0, 0]) == EX_ILLEGAL_ADDRESS)
+
+    request = bytearray(frame(struct.pack(">BBHh", ADDRESS, 0x06, HOLD_TARGET, 700)))
+    request[-1] ^= 0xFF
+    master.transact(bytes(request), answered=False)
+    check("bad CRC dropped without reply", master.holding()[HOLD_TARGET] == before[HOLD_TARGET])
+
+    master.write_single(HOLD_TARGET, 710, address=0)
+    check("broadcast applied without reply", master.holding()[HOLD_TARGET] == 710)
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(__doc__.strip(), file=sys.stderr)
+        return 2
+    slave = subprocess.Popen([sys.argv[1]], stdout=subprocess.PIPE, text=True)
+    try:
+        master = Master(slave.stdout.readline().strip())
+        run(master)
+    finally:
+        slave.kill()
+        slave.wait()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
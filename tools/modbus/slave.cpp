@@ -0,0 +1,149 @@
+//The controller's Modbus RTU slave on a pseudo terminal, for master.py or
+//any other local master. It runs ModbusSlave::poll() with the settings store
+//and a write handler that checks and commits the registers the way the
+//sketch's modbusWrite() does. There is no menu on the PC, so MB_IN_MENU
+//answers the number of settings commits instead: a master can check that a
+//multiple register write made exactly one, and a rejected one none.
+//
+//  g++ -std=c++17 -O2 -Itools/sweep/host -Icode -o modbus_slave
+//      tools/modbus/slave.cpp code/ModbusSlave.cpp code/Settings.cpp code/FlowCurve.cpp
+//  ./modbus_slave          prints the pty path, then serves until killed
+
+#define _XOPEN_SOURCE 600
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "ModbusSlave.h"
+#include "Settings.h"
+
+#define ADDRESS 1
+#define BAUD 9600
+
+class PtyStream : public Stream
+{
+public:
+    explicit PtyStream(int fd) : _fd(fd) {}
+    int available() override
+    {
+        int count = 0;
+        return ioctl(_fd, FIONREAD, &count) == 0 ? count : 0;
+    }
+    int read() override
+    {
+        uint8_t c;
+        return ::read(_fd, &c, 1) == 1 ? c : -1;
+    }
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        ssize_t n = ::write(_fd, buffer, size);
+        return n > 0 ? n : 0;
+    }
+
+private:
+    int _fd;
+};
+
+static const auto start = std::chrono::steady_clock::now();
+
+unsigned long micros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t, uint8_t) {}
+
+static Settings settings;
+static FlowCurve flowCurve;
+static ModbusSlave modbus;
+static int16_t commits = 0;
+static int16_t cmdType = 0;
+
+static void updateModbusSettings(const SettingsData &config)
+{
+    modbus.setHolding(MB_HOLD_TARGET, round(config.targetPh * 100));
+    modbus.setHolding(MB_HOLD_AMOUNT, round(config.pumpAmount * 100));
+    modbus.setHolding(MB_HOLD_WAIT, round(config.pumpWait * 10));
+    modbus.setHolding(MB_HOLD_BUFFER, round(config.phBuff * 100));
+    modbus.setHolding(MB_HOLD_FLOW_RATE, round(config.flowRate * 100));
+    modbus.setHolding(MB_HOLD_TEMP_UNIT, config.isF == 1.0);
+    modbus.setHolding(MB_HOLD_CALIBRATE, 0);
+}
+
+static void settingsChanged(const SettingsData &config, uint16_t)
+{
+    modbus.setInput(MB_IN_MENU, ++commits);
+    updateModbusSettings(config);
+}
+
+//the sketch's register to settings field table
+static const uint16_t MODBUS_FIELDS[] = {SETTING_TARGET, SETTING_AMOUNT, SETTING_WAIT, SETTING_PHBUFF, SETTING_FLOWRATE, SETTING_ISF};
+static const float MODBUS_SCALES[] = {100, 100, 10, 100, 100, 1};
+
+
+//the sketch's modbusWrite(), with the calibration steps only tracked
+static bool modbusWrite(uint16_t start, const uint16_t *values, uint16_t count)
+{
+    SettingsData config = settings.get();
+    int16_t calibrate = 0;
+    for(uint16_t i = 0; i < count; i++) {
+        uint16_t reg = start + i;
+        int16_t v = (int16_t)values[i];
+        if(reg < MB_HOLD_CALIBRATE) {
+            if(!settings.setField(config, MODBUS_FIELDS[reg], v / MODBUS_SCALES[reg])) return false;
+        } else if(reg == MB_HOLD_CALIBRATE) {
+            bool inCalibration = cmdType == 1 || cmdType == 2;
+            if(!(v == MB_CAL_ENTER && cmdType == 0) && !((v == MB_CAL_CALIBRATE || v == MB_CAL_EXIT) && inCalibration)) {
+                return false;
+            }
+            calibrate = v;
+        }
+    }
+    if(!Settings::valid(config)) {
+        return false;
+    }
+    settings.commit(config);
+    if(calibrate == MB_CAL_ENTER) {
+        cmdType = 1;
+    } else if(calibrate == MB_CAL_CALIBRATE) {
+        cmdType = 2;
+    } else if(calibrate == MB_CAL_EXIT) {
+        cmdType = 0;
+    }
+    return true;
+}
+
+int main()
+{
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if(fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+        perror("pty");
+        return 1;
+    }
+    const char *path = ptsname(fd);
+    int keep = open(path, O_RDWR | O_NOCTTY);          //keeps the pty up between masters, and makes it raw
+    struct termios tio;
+    tcgetattr(keep, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(keep, TCSANOW, &tio);
+
+    settings.setFlowCurve(&flowCurve);
+    settings.begin();
+    settings.subscribe(settingsChanged);
+    updateModbusSettings(settings.get());
+    PtyStream port(fd);
+    modbus.begin(port, ADDRESS, BAUD);
+    modbus.setWriteHandler(modbusWrite);
+
+    printf("%s\n", path);
+    fflush(stdout);
+    for(;;) {
+        modbus.poll();
+        usleep(200);
+    }
+}
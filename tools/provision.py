@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""Copy the settings of one controller to many over their serial ports.
+
+  python3 tools/provision.py export /dev/ttyUSB0 > golden.txt
+  python3 tools/provision.py import golden.txt /dev/ttyUSB1 /dev/ttyUSB2 ...
+
+`export` prints the blob of one controller (EXPORT command). `import`
+pushes a blob to every port at the same time (IMPORT command), then reads
+the settings back to check them. Exit status is the number of failed ports.
+The blob format is documented in code/Settings.h. Needs pyserial.
+"""
+
+import argparse
+import sys
+import threading
+import time
+
+import serial
+
+BAUD = 115200
+ERRORS = {
+    "1": "not a settings blob",
+    "2": "blob from a newer firmware",
+    "3": "CRC mismatch",
+    "4": "value out of range",
+}
+
+
+def open_port(path, boot_wait):
+    port = serial.Serial()
+    port.port = path
+    port.baudrate = BAUD
+    port.timeout = 0.2
+    port.dtr = False        # keep the auto-reset circuit of dev boards quiet
+    port.rts = False
+    port.open()
+    time.sleep(boot_wait)
+    port.reset_input_buffer()
+    return port
+
+
+def command(port, line, prefixes, timeout):
+    port.write((line + "\n").encode("ascii"))
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        reply = port.readline().decode("ascii", "replace").strip()
+        for prefix in prefixes:
+            if reply.startswith(prefix):
+                return reply
+    raise TimeoutError("no answer to %s" % line.split()[0])
+
+
+def export(port, timeout):
+    return command(port, "EXPORT", ["SETTINGS "], timeout).split(" ", 1)[1]
+
+
+def provision(path, blob, args, results):
+    try:
+        port = open_port(path, args.boot_wait)
+        try:
+            reply = command(port, "IMPORT " + blob, ["IMPORT OK", "IMPORT ERROR"], args.timeout)
+            if reply != "IMPORT OK":
+                code = reply.split()[-1]
+                raise RuntimeError(ERRORS.get(code, reply))
+            if export(port, args.timeout) != blob:
+                raise RuntimeError("read back differs")
+        finally:
+            port.close()
+        results[path] = None
+    except Exception as error:          # one bad unit must not stop the others
+        results[path] = str(error)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="settings export/import over serial")
+    parser.add_argument("--boot-wait", type=float, default=2.0, help="seconds to wait after opening a port")
+    parser.add_argument("--timeout", type=float, default=3.0, help="seconds to wait for each answer")
+    sub = parser.add_subparsers(dest="action", required=True)
+    p = sub.add_parser("export")
+    p.add_argument("port")
+    p = sub.add_parser("import")
+    p.add_argument("blob", help="file written by export, or - for stdin")
+    p.add_argument("ports", nargs="+")
+    args = parser.parse_args()
+
+    if args.action == "export":
+        port = open_port(args.port, args.boot_wait)
+        print(export(port, args.timeout))
+        port.close()
+        return 0
+
+    source = sys.stdin if args.blob == "-" else open(args.blob)
+    blob = source.read().strip()
+    results = {}
+    threads = [threading.Thread(target=provision, args=(path, blob, args, results)) for path in args.ports]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    for path in args.ports:
+        print("%s: %s" % (path, results[path] or "ok"))
+    return sum(1 for error in results.values() if error)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
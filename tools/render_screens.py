@@ -0,0 +1,274 @@
+#!/usr/bin/env python3
+"""Pre-render the static OLED screens into code/ScreenTemplates.h.
+
+The layouts are read from code/DFRobot_PH.cpp, so the rasterizing fallback
+in the firmware stays the only description of each screen:
+
+  * every `if(!showTemplate(SCREEN(NAME))) { ... }` block
+  * every `drawValueScreen(SCREEN(NAME), F("label"), ...)` call (label only)
+  * the pump menu, one screen per selection (MENU_0 .. MENU_n)
+
+Text is drawn the way Adafruit_GFX does with the built-in 5x7 font, so the
+font table is taken from the installed library:
+
+  python3 tools/render_screens.py --font ~/Arduino/libraries/Adafruit_GFX_Library/glcdfont.c
+
+tools/build.py runs it before every arduino-cli compile. The header is
+generated, not kept in git; the firmware warns at compile time and falls
+back to rasterizing when it is missing. --check exits 1 when the header is
+missing or no longer matches DFRobot_PH.cpp, without writing it.
+"""
+
+import argparse
+import glob
+import os
+import re
+import sys
+
+WIDTH = 128
+HEIGHT = 64
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SOURCE = os.path.join(ROOT, "code", "DFRobot_PH.cpp")
+OUTPUT = os.path.join(ROOT, "code", "ScreenTemplates.h")
+FONT_SEARCH = [
+    "~/Arduino/libraries/Adafruit_GFX_Library/glcdfont.c",
+    "~/Documents/Arduino/libraries/Adafruit_GFX_Library/glcdfont.c",
+    "~/.pio/libdeps/*/Adafruit GFX Library/glcdfont.c",
+]
+
+
+def load_font(path):
+    text = open(path).read()
+    text = re.sub(r"//.*", "", text)
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+    body = text[text.index("{") + 1:text.rindex("}")]
+    font = [int(v, 16) for v in re.findall(r"0x[0-9A-Fa-f]+", body)]
+    if len(font) < 256 * 5:
+        sys.exit("%s does not look like the GFX classic font" % path)
+    return font
+
+
+def find_font():
+    for pattern in FONT_SEARCH:
+        found = glob.glob(os.path.expanduser(pattern))
+        if found:
+            return found[0]
+    sys.exit("glcdfont.c not found, pass --font")
+
+
+def c_string(literal):
+    return bytes(literal, "utf-8").decode("unicode_escape")
+
+
+class Canvas:
+    """The subset of Adafruit_GFX text drawing the screens use."""
+
+    def __init__(self, font):
+        self.font = font
+        self.pixels = [[0] * WIDTH for _ in range(HEIGHT)]
+        self.x = 0
+        self.y = 0
+        self.size = 1
+        self.ops = []                   # the drawing calls, for tools/bench/screens.cpp
+
+    def cursor(self, x, y):
+        self.x, self.y = x, y
+        self.ops.append("C %d %d" % (x, y))
+
+    def text_size(self, size):
+        self.size = size
+        self.ops.append("S %d" % size)
+
+    def char(self, c):
+        if c == "\n":
+            self.x = 0
+            self.y += self.size * 8
+            return
+        if c == "\r":
+            return
+        if self.x + self.size * 6 > WIDTH:     # wrap, as setTextWrap(true)
+            self.x = 0
+            self.y += self.size * 8
+        code = ord(c)
+        if code >= 176:                         # cp437(false) quirk of the library
+            code += 1
+        for i in range(5):
+            line = self.font[code * 5 + i]
+            for j in range(8):
+                if line & (1 << j):
+                    for dx in range(self.size):
+                        for dy in range(self.size):
+                            px, py = self.x + i * self.size + dx, self.y + j * self.size + dy
+                            if 0 <= px < WIDTH and 0 <= py < HEIGHT:
+                                self.pixels[py][px] = 1
+        self.x += self.size * 6
+
+    def print(self, text):
+        if text:
+            self.ops.append("T " + text.encode("latin-1").hex())
+        for c in text:
+            self.char(c)
+
+    def println(self, text=""):
+        self.print(text + "\r\n")
+
+    def pages(self):
+        """SSD1306 frame buffer layout: byte x + (y / 8) * WIDTH, bit y & 7."""
+        frame = bytearray(WIDTH * HEIGHT // 8)
+        for y in range(HEIGHT):
+            for x in range(WIDTH):
+                if self.pixels[y][x]:
+                    frame[x + (y // 8) * WIDTH] |= 1 << (y & 7)
+        return frame
+
+
+CALL = re.compile(r"display\.(\w+)\((.*)\);")
+
+
+def run(canvas, statements):
+    for line in statements:
+        if line.strip().startswith("//"):
+            continue
+        m = CALL.search(line)
+        if not m:
+            continue
+        name, args = m.groups()
+        text = re.match(r'F\("(.*)"\)$', args)
+        if name == "setTextSize":
+            canvas.text_size(int(args))
+        elif name == "setCursor":
+            canvas.cursor(*(int(v) for v in args.split(",")))
+        elif name in ("print", "println") and (text or not args):
+            getattr(canvas, name)(c_string(text.group(1)) if text else "")
+        elif name == "setTextColor":
+            pass
+        else:
+            sys.exit("cannot pre-render display.%s(%s)" % (name, args))
+
+
+def menu_screens(source, font):
+    names = re.search(r"MENU_ITEMS\[\] PROGMEM = \{(.*?)\};", source, re.S).group(1)
+    labels = dict(re.findall(r'static const char (MENU_\w+)\[\]\s+PROGMEM = "(.*)";', source))
+    items = [c_string(labels[n.strip()]) for n in names.split(",") if n.strip()]
+    rows = int(re.search(r"#define MENU_ROWS (\d+)", source).group(1))
+    screens = []
+    for selected in range(len(items)):      # mirrors DFRobot_PH::drawPumpMenu()
+        canvas = Canvas(font)
+        canvas.cursor(0, 5)
+        canvas.println("Pump Settings")
+        canvas.cursor(0, 15)
+        first = 0 if selected < rows else selected - rows + 1
+        for i in range(first, min(first + rows, len(items))):
+            canvas.print("> " if i == selected else "  ")
+            canvas.println(items[i])
+        screens.append(("MENU_%d" % selected, canvas))
+    return screens
+
+
+def collect(source, font):
+    screens = []
+    lines = source.split("\n")
+    i = 0
+    while i < len(lines):
+        line = lines[i]
+        block = re.search(r"if\(!showTemplate\(SCREEN\((\w+)\)\)\) \{", line)
+        value = re.search(r'drawValueScreen\(SCREEN\((\w+)\), F\("(.*?)"\)', line)
+        if block:
+            depth = line.count("{") - line.count("}")
+            body = []
+            i += 1
+            while depth > 0:
+                depth += lines[i].count("{") - lines[i].count("}")
+                if depth > 0:
+                    body.append(lines[i])
+                i += 1
+            canvas = Canvas(font)
+            run(canvas, body)
+            screens.append((block.group(1), canvas))
+            continue
+        if value:                               # mirrors DFRobot_PH::drawValueScreen()
+            canvas = Canvas(font)
+            canvas.cursor(0, 5)
+            canvas.print(c_string(value.group(2)))
+            screens.append((value.group(1), canvas))
+        elif "SCREEN(MENU_0)" in line and "showTemplate" in line:
+            screens.extend(menu_screens(source, font))
+        i += 1
+    unique = []
+    for name, canvas in screens:
+        frame = canvas.pages()
+        previous = [f for n, f, _ in unique if n == name]
+        if previous and previous[0] != frame:
+            sys.exit("screen %s is drawn two different ways" % name)
+        if not previous:
+            unique.append((name, frame, canvas.ops))
+    return unique
+
+
+def write_ops(screens, path):
+    """One screen per block: its name, then C x y, S size and T hex-text lines."""
+    with open(path, "w") as f:
+        for name, _, ops in screens:
+            f.write("SCREEN %s\n" % name)
+            for op in ops:
+                f.write(op + "\n")
+
+
+def header(screens):
+    out = []
+    out.append("//generated by tools/render_screens.py from DFRobot_PH.cpp, do not edit")
+    out.append("#ifndef _SCREENTEMPLATES_H_")
+    out.append("#define _SCREENTEMPLATES_H_")
+    out.append("")
+    out.append("#include <Arduino.h>")
+    out.append("")
+    out.append("#define SCREEN_TEMPLATE_WIDTH %d" % WIDTH)
+    out.append("#define SCREEN_TEMPLATE_HEIGHT %d" % HEIGHT)
+    out.append("#define SCREEN_TEMPLATE_SIZE %d" % (WIDTH * HEIGHT // 8))
+    out.append("#define SCREEN_TEMPLATE_COUNT %d" % len(screens))
+    out.append("")
+    for index, (name, _, _) in enumerate(screens):
+        out.append("#define SCREEN_TEMPLATE_%s %d" % (name, index))
+    out.append("")
+    out.append("static const uint8_t SCREEN_TEMPLATE_DATA[SCREEN_TEMPLATE_COUNT][SCREEN_TEMPLATE_SIZE] PROGMEM = {")
+    for name, frame, _ in screens:
+        out.append("    {   //%s" % name)
+        for row in range(0, len(frame), 16):
+            out.append("        " + ", ".join("0x%02X" % b for b in frame[row:row + 16]) + ",")
+        out.append("    },")
+    out.append("};")
+    out.append("")
+    out.append("#endif")
+    out.append("")
+    return "\n".join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--font", help="path to Adafruit_GFX glcdfont.c")
+    parser.add_argument("--source", default=SOURCE)
+    parser.add_argument("--output", default=OUTPUT)
+    parser.add_argument("--check", action="store_true", help="only compare with the existing header")
+    parser.add_argument("--ops", help="also write the drawing calls of every screen, for tools/bench/screens.cpp")
+    args = parser.parse_args()
+
+    font = load_font(args.font or find_font())
+    screens = collect(open(args.source).read(), font)
+    if args.ops:
+        write_ops(screens, args.ops)
+    text = header(screens)
+    if args.check:
+        current = open(args.output).read() if os.path.exists(args.output) else None
+        if current != text:
+            print("%s is %s, run tools/build.py" % (args.output, "stale" if current else "missing"), file=sys.stderr)
+            return 1
+        print("%s is up to date" % args.output)
+        return 0
+    open(args.output, "w").write(text)
+    print("%d screens, %d bytes of flash -> %s" % (len(screens), len(screens) * WIDTH * HEIGHT // 8, args.output))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,207 @@
+//A hung I2C read against the loop guard on the host. loop() passes run on
+//the main thread and LoopMonitor's guard task on its own, both on a
+//simulated clock that only the "loop" moves, so the run is the same every
+//time. A read that stalls past LOOP_DEADLINE_MS must get the servo stopped
+//by emergencyStop() from the guard task and the queued jobs dropped on the
+//next pass. One that never returns must trip the task watchdog at
+//LOOP_WDT_TIMEOUT_MS and not before.
+//
+//  g++ -std=c++17 -O2 -pthread -Itools/sweep/host -Icode -o hang tools/soak/hang.cpp
+//      code/LoopMonitor.cpp code/GravityPump.cpp code/Settings.cpp code/FlowCurve.cpp code/Stats.cpp code/Trace.cpp
+//  ./hang
+
+#include <climits>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
+#include "GravityPump.h"
+#include "LoopMonitor.h"
+#include "Stats.h"
+#include <esp_system.h>
+#include <esp_task_wdt.h>
+
+#define READ_STEP_MS 10             //the stuck read moves the clock this much at a time
+
+class NullSerial : public Stream
+{
+public:
+    int available() override { return 0; }
+    int read() override { return -1; }
+    size_t write(const uint8_t *, size_t size) override { return size; }
+};
+
+static NullSerial serial;
+Stream &Serial = serial;
+
+static std::mutex lock;
+static std::condition_variable tick;
+static unsigned long now = 0;              //simulated ms, only advance() moves it
+static unsigned long guardWakes = 0;        //0 = guard task running, not yet back in vTaskDelay()
+static unsigned long wdtTimeout = 0;
+static unsigned long wdtFedAt = 0;
+static bool wdtWatching = false;
+static unsigned long wdtTrippedAt = 0;      //0 = not tripped
+
+unsigned long millis()
+{
+    std::lock_guard<std::mutex> hold(lock);
+    return now;
+}
+
+unsigned long micros()
+{
+    return millis() * 1000;
+}
+
+esp_reset_reason_t esp_reset_reason()
+{
+    return ESP_RST_POWERON;
+}
+
+esp_err_t esp_task_wdt_init(const esp_task_wdt_config_t *config)
+{
+    wdtTimeout = config->timeout_ms;
+    return ESP_OK;
+}
+
+esp_err_t esp_task_wdt_reconfigure(const esp_task_wdt_config_t *config)
+{
+    return esp_task_wdt_init(config);
+}
+
+esp_err_t esp_task_wdt_add(TaskHandle_t)
+{
+    std::lock_guard<std::mutex> hold(lock);
+    wdtWatching = true;
+    wdtFedAt = now;
+    return ESP_OK;
+}
+
+esp_err_t esp_task_wdt_reset()
+{
+    std::lock_guard<std::mutex> hold(lock);
+    wdtFedAt = now;
+    return ESP_OK;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char *, uint32_t, void *arg,
+                                   UBaseType_t, TaskHandle_t *, BaseType_t)
+{
+    std::thread(task, arg).detach();
+    return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    std::unique_lock<std::mutex> hold(lock);
+    guardWakes = now + ticks;
+    tick.notify_all();
+    tick.wait(hold, [&] { return now >= guardWakes; });
+    guardWakes = 0;
+}
+
+//the clock moves on, and the guard task gets to run everything due by then
+static void advance(unsigned long ms)
+{
+    std::unique_lock<std::mutex> hold(lock);
+    now += ms;
+    if(wdtWatching && wdtTrippedAt == 0 && now - wdtFedAt >= wdtTimeout) {
+        wdtTrippedAt = now;
+    }
+    tick.notify_all();
+    tick.wait(hold, [] { return guardWakes > now; });
+}
+
+static bool wdtTripped()
+{
+    std::lock_guard<std::mutex> hold(lock);
+    return wdtTrippedAt != 0;
+}
+
+static GravityPump pump;
+static LoopMonitor monitor;
+static byte cancelled = 0;
+
+static void onControlDose(const DoseJob &job)
+{
+    cancelled += job.state == DOSE_CANCELLED;
+}
+
+static void loopFailsafe()
+{
+    pump.emergencyStop();
+}
+
+//a Wire read with the bus held low, returns after ms or once the watchdog has reset the board
+static void hungRead(unsigned long ms)
+{
+    for(unsigned long waited = 0; waited < ms && !wdtTripped(); waited += READ_STEP_MS) {
+        advance(READ_STEP_MS);
+    }
+}
+
+static int failures = 0;
+
+static void check(const char *name, bool ok)
+{
+    printf("%-56s %s\n", name, ok ? "ok" : "FAILED");
+    failures += !ok;
+}
+
+int main()
+{
+    Settings settings;
+    settings.begin();
+    FlowCurve flowCurve;
+    flowCurve.begin();
+    stats.begin();
+    pump.setSettings(settings);
+    pump.setPin(16);
+    pump.setFlowCurve(flowCurve);
+    pump.setStats(stats);
+    monitor.begin(LOOP_DEADLINE_MS, loopFailsafe);
+    advance(0);                             //the guard task is up and waiting
+
+    //a dose running and one queued behind it when the read hangs
+    pump.flowPump(5, DOSE_CONTROL, onControlDose);
+    monitor.beginLoop();
+    monitor.stage(STAGE_PUMP);
+    pump.update();
+    pump.flowPump(5, DOSE_CONTROL, onControlDose);     //not merged into the running one
+    bool ran = pump.isRunning() && Servo::written == settings.get().pumpSpeed;
+    monitor.stage(STAGE_ADC);
+    hungRead(LOOP_DEADLINE_MS - LOOP_GUARD_PERIOD_MS);
+    check("pump runs until the deadline", ran && Servo::written == settings.get().pumpSpeed);
+    hungRead(2 * LOOP_GUARD_PERIOD_MS);
+    check("guard task stops the servo past the deadline", Servo::written == 90);
+    check("overrun recorded in the stuck stage", monitor.overruns() == 1 && monitor.lastOverrunStage() == STAGE_ADC);
+    hungRead(LOOP_DEADLINE_MS);
+    check("jobs left to the loop while it is stuck", pump.queued() == 2 && cancelled == 0);
+    monitor.endLoop();
+
+    monitor.beginLoop();
+    monitor.stage(STAGE_PUMP);
+    pump.update();
+    check("next pass drops the running and the queued job", pump.queued() == 0 && cancelled == 2 && !pump.isRunning());
+    check("servo stays stopped", Servo::written == 90);
+    monitor.endLoop();
+    check("a pass that comes back does not trip the watchdog", !wdtTripped());
+
+    //a read that never returns
+    pump.flowPump(5, DOSE_CONTROL, onControlDose);
+    monitor.beginLoop();
+    monitor.stage(STAGE_PUMP);
+    pump.update();
+    unsigned long stuckAt = millis();
+    monitor.stage(STAGE_ADC);
+    hungRead(LOOP_WDT_TIMEOUT_MS - READ_STEP_MS);
+    check("watchdog holds off until its timeout", !wdtTripped() && Servo::written == 90 && monitor.overruns() == 2);
+    hungRead(LOOP_WDT_TIMEOUT_MS);
+    check("watchdog trips at LOOP_WDT_TIMEOUT_MS", wdtTripped() && wdtTrippedAt - stuckAt == LOOP_WDT_TIMEOUT_MS);
+
+    fflush(stdout);
+    _exit(failures == 0 ? 0 : 1);           //the guard task is still in vTaskDelay(), skip the static destructors
+}
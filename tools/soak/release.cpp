@@ -0,0 +1,108 @@
+//DOWN let go in the middle of a manual top-up on the host. The top-up has
+//interrupted a control dose, as it does when DOWN is pressed while the loop
+//is dosing. Letting go must end the top-up as done with what it delivered,
+//count no abort, and leave the control dose to run on to the end.
+//
+//  g++ -std=c++17 -O2 -Itools/sweep/host -Icode -o release tools/soak/release.cpp
+//      code/GravityPump.cpp code/Settings.cpp code/FlowCurve.cpp code/Stats.cpp code/Trace.cpp
+//  ./release
+
+#include <cmath>
+#include <cstdio>
+
+#include "GravityPump.h"
+#include "Stats.h"
+
+#define PUMP_MOMENTARY 0.1          //as in the sketch
+#define LOOP_MS 10
+#define HELD_MS 2000
+
+class NullSerial : public Stream
+{
+public:
+    int available() override { return 0; }
+    int read() override { return -1; }
+    size_t write(const uint8_t *, size_t size) override { return size; }
+};
+
+static NullSerial serial;
+Stream &Serial = serial;
+
+static unsigned long now = 0;
+
+unsigned long millis()
+{
+    return now;
+}
+
+unsigned long micros()
+{
+    return now * 1000;
+}
+
+static DoseJob manual = {};
+static DoseJob control = {};
+static byte manualReports = 0;
+static byte controlReports = 0;
+
+static void onManualDose(const DoseJob &job)
+{
+    manual = job;
+    manualReports++;
+}
+
+static void onControlDose(const DoseJob &job)
+{
+    control = job;
+    controlReports++;
+}
+
+static int failures = 0;
+
+static void check(const char *name, bool ok)
+{
+    printf("%-56s %s\n", name, ok ? "ok" : "FAILED");
+    failures += !ok;
+}
+
+int main()
+{
+    Settings settings;
+    settings.begin();
+    FlowCurve flowCurve;
+    flowCurve.begin();
+    stats.begin();
+    GravityPump pump;
+    pump.setSettings(settings);
+    pump.setPin(16);
+    pump.setFlowCurve(flowCurve);
+    pump.setStats(stats);
+    float rate = settings.get().flowRate;
+
+    pump.flowPump(5, DOSE_CONTROL, onControlDose);
+    pump.update();
+    for(; now < 1000; now += LOOP_MS) {
+        pump.update();
+    }
+    unsigned long pressedAt = now;
+    for(; now < pressedAt + HELD_MS; now += LOOP_MS) {      //the loop while DOWN is held
+        pump.flowPump(PUMP_MOMENTARY, DOSE_MANUAL, onManualDose);
+        pump.update();
+    }
+    check("top-up runs while held", pump.isRunning() && manualReports == 0 && pump.queued() == 2);
+    pump.release(DOSE_MANUAL);
+    pump.update();
+    float expected = rate * HELD_MS / 1000;
+    check("let go ends the top-up once, as done", manualReports == 1 && manual.state == DOSE_DONE);
+    check("top-up reports what it delivered", fabs(manual.delivered - expected) < rate * 2 * LOOP_MS / 1000);
+    check("servo stops when let go", Servo::written == 90);
+    check("no abort counted", stats.get().aborted == 0 && stats.get().doses == 2);
+    check("control dose still queued", controlReports == 0 && pump.queued() == 1);
+
+    unsigned long releasedAt = now;
+    for(; now < releasedAt + 60000 && controlReports == 0; now += LOOP_MS) {
+        pump.update();
+    }
+    check("control dose runs on to the end", controlReports == 1 && control.state == DOSE_DONE && control.delivered == 5);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,212 @@
+//30 day soak of the controller logic on the host, failing if anything
+//allocates once the simulated setup() is done. It runs the same calls the
+//loop makes: sample gate, dosing, estimator, trend log, dose model, the
+//pump's dose queue, budget and stats, and the settings export/import, one
+//pass per simulated second. DOWN is held for a manual top-up once a day and
+//the menu's timed and volume calibration runs go every week.
+//
+//Not covered: DFRobot_PH, so none of its serial commands (cmdParse()) or menu
+//steps (calibration()). They need the display and the serial command stack,
+//which have no host build; their allocation freedom rests on HEAP_ASSERT on
+//the board.
+//
+//  g++ -std=c++17 -O2 -Itools/sweep/host -Icode -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+//      -o soak tools/soak/soak.cpp code/DosingController.cpp code/DoseModel.cpp
+//      code/PhEstimator.cpp code/SampleGate.cpp code/Settings.cpp code/FlowCurve.cpp code/TrendLog.cpp
+//      code/GravityPump.cpp code/Stats.cpp code/Trace.cpp
+//  ./soak [days]
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+
+#include "DosingController.h"
+#include "DoseModel.h"
+#include "GravityPump.h"
+#include "PhEstimator.h"
+#include "SampleGate.h"
+#include "Settings.h"
+#include "Stats.h"
+#include "TrendLog.h"
+
+static bool sealed = false;
+static unsigned long allocations = 0;   //after sealed
+
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    allocations += sealed;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    allocations += sealed;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    allocations += sealed;
+    return __real_realloc(ptr, size);
+}
+}
+
+void *operator new(size_t size)
+{
+    allocations += sealed;
+    void *ptr = __real_malloc(size);
+    if(ptr == NULL) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+#define MAX_ML_PER_HOUR 100.0       //as in the sketch
+#define PUMP_MOMENTARY 0.1
+#define TIMER_PUMP_S 15
+
+class NullSerial : public Stream            //the pump's messages, nothing is typed
+{
+public:
+    int available() override { return 0; }
+    int read() override { return -1; }
+    size_t write(const uint8_t *, size_t size) override { return size; }
+};
+
+static NullSerial serial;
+Stream &Serial = serial;
+
+static unsigned long clock = 0;
+
+unsigned long millis()
+{
+    return clock;
+}
+
+unsigned long micros()
+{
+    return clock * 1000;
+}
+
+static double ph = 7.6;                     //the tank mixes at once, this is about allocations, see tools/sweep for control
+static PhEstimator estimator;
+static DosingController dosing;
+
+static void onControlDose(const DoseJob &job)
+{
+    ph -= 0.1 * job.delivered;
+    estimator.dose(job.delivered);
+    if(job.state == DOSE_CANCELLED) {
+        dosing.delivered(job.delivered);
+    }
+}
+
+static void onManualDose(const DoseJob &job)
+{
+    ph -= 0.1 * job.delivered;
+    estimator.dose(job.delivered);
+}
+
+int main(int argc, char **argv)
+{
+    double days = argc > 1 ? atof(argv[1]) : 30;
+    unsigned long loops = (unsigned long)(days * 86400);
+
+    //setup()
+    Settings settings;
+    settings.begin();
+    DoseModel model;
+    model.begin();
+    dosing.setDoseModel(&model);
+    estimator.setDoseModel(&model);
+    FlowCurve flowCurve;
+    flowCurve.begin();
+    settings.setFlowCurve(&flowCurve);
+    GravityPump pump;
+    pump.setSettings(settings);
+    pump.setPin(16);
+    pump.setDoseBudget(MAX_ML_PER_HOUR);
+    pump.setFlowCurve(flowCurve);
+    stats.begin();
+    pump.setStats(stats);
+    SampleGate gate;
+    TrendLog trend;
+    std::mt19937 rng(1);
+    std::normal_distribution<double> noise(0, 0.03);
+    char text[SETTINGS_TEXT_LENGTH];
+    printf("soaking %.0f days, %lu loops\n", days, loops);
+    fflush(stdout);
+    sealed = true;
+
+    for(unsigned long i = 0; i < loops; i++) {
+        unsigned long now = i * 1000;       //wraps after 49.7 days, as millis() does
+        clock = now;
+        pump.update();
+        const SettingsData &config = settings.get();
+        gate.update(now, pump.isRunning());
+        gate.takeReport();
+        if(i % 86400 >= 43200 && i % 86400 < 43210) {      //DOWN held for ten seconds at noon
+            pump.flowPump(PUMP_MOMENTARY, DOSE_MANUAL, onManualDose);
+        }
+        if(i % 604800 == 7200) {            //the pump menu's timed run, then its 2 ml check
+            pump.timerPump(TIMER_PUMP_S);
+        } else if(i % 604800 == 7200 + TIMER_PUMP_S + 5) {
+            pump.pumpCalibration(3);
+            pump.flowPump(2.0, DOSE_CALIBRATION);
+        }
+        if(dosing.due(now, true, config) && gate.accept(now)) {
+            stats.sampled();
+            float temperature = 25 + 2 * sin(i / 86400.0 * 2 * M_PI);
+            float probe = ph + noise(rng);
+            trend.add(now, probe);
+            estimator.update(now, probe, temperature);
+            float ml = dosing.measured(now, estimator.ph(), probe, config);
+            if(ml > 0) {
+                float runTime = pump.flowPump(ml, DOSE_CONTROL, onControlDose);
+                if(runTime > 0) {
+                    dosing.doseStarted(pump.lastDoseMl(), probe, runTime);
+                }
+            } else if(dosing.reachedTarget()) {
+                pump.stop();
+                model.save();
+                stats.flush();
+            }
+        }
+        stats.service(now);
+        ph += 0.02 / 3600;
+        if(i % 60 == 0) {                   //the trend screen
+            trend.update(now);
+            int16_t low, high;
+            trend.range(i / 60 % TREND_TIERS, low, high);
+        }
+        if(i % 3600 == 0) {                 //a provisioning round trip every hour
+            if(settings.exportText(text, sizeof(text)) == 0 || settings.importText(text) != SETTINGS_IMPORT_OK) {
+                sealed = false;
+                printf("settings round trip failed\n");
+                return 1;
+            }
+        }
+    }
+    sealed = false;
+
+    const StatsData &counted = stats.get();
+    printf("%lu doses, %.1f ml, final pH %.2f, %lu allocations after setup\n",
+           (unsigned long)counted.doses, counted.ml, ph, allocations);
+    return allocations == 0 ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+//just enough of Arduino.h to build the controller logic on a PC
+#ifndef _HOST_ARDUINO_H_
+#define _HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define PROGMEM
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR
+typedef enum { ADC_0db, ADC_2_5db, ADC_6db, ADC_11db } adc_attenuation_t;
+uint32_t analogReadMilliVolts(uint8_t pin);                 //defined by the tools that need an ADC
+void analogSetPinAttenuation(uint8_t pin, adc_attenuation_t attenuation);
+
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+#define OUTPUT 1
+#define LOW 0
+#define HIGH 1
+unsigned long millis();                                     //defined by the tools that run the pump or talk to a port
+unsigned long micros();
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+
+inline char *strupr(char *text)
+{
+    for(char *c = text; *c; c++) {
+        if(*c >= 'a' && *c <= 'z') *c -= 'a' - 'A';
+    }
+    return text;
+}
+
+class __FlashStringHelper;
+#define F(text) (reinterpret_cast<const __FlashStringHelper *>(text))
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(const uint8_t *buffer, size_t size) = 0;
+
+    size_t print(const char *text) { return write((const uint8_t *)text, strlen(text)); }
+    size_t print(const __FlashStringHelper *text) { return print((const char *)text); }
+    size_t print(char c) { return write((const uint8_t *)&c, 1); }
+    size_t print(int value) { return format("%d", value); }
+    size_t print(unsigned int value) { return format("%u", value); }
+    size_t print(long value) { return format("%ld", value); }
+    size_t print(unsigned long value) { return format("%lu", value); }
+    size_t print(double value, int digits = 2) { return format("%.*f", digits, value); }
+    template<typename T> size_t println(T value) { return print(value) + println(); }
+    size_t println(double value, int digits) { return print(value, digits) + println(); }
+    size_t println() { return print("\r\n"); }
+
+private:
+    template<typename... A> size_t format(const char *spec, A... args)
+    {
+        char text[32];
+        int n = snprintf(text, sizeof(text), spec, args...);
+        return write((const uint8_t *)text, n < (int)sizeof(text) ? n : sizeof(text) - 1);
+    }
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual void flush() {}
+};
+
+extern Stream &Serial;                                      //defined by the tools that print
+
+using std::min;
+using std::max;
+#define constrain(x, low, high) ((x) < (low) ? (low) : ((x) > (high) ? (high) : (x)))
+
+#endif
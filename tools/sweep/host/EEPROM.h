@@ -0,0 +1,18 @@
+//the simulated controllers never load or save, reads come back erased
+#ifndef _HOST_EEPROM_H_
+#define _HOST_EEPROM_H_
+
+#include <Arduino.h>
+
+class EEPROMClass
+{
+public:
+    bool begin(size_t) { return true; }
+    uint8_t read(int) { return 0xFF; }
+    void write(int, uint8_t) {}
+    bool commit() { return true; }
+};
+
+static EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,20 @@
+//the pump servo on a PC, remembers the last value written
+#ifndef _HOST_ESP32SERVO_H_
+#define _HOST_ESP32SERVO_H_
+
+#include <Arduino.h>
+
+class Servo
+{
+public:
+    int attach(int pin) { return pin; }
+    void write(int value) { _value = value; written = value; }
+    int read() { return _value; }
+
+    static inline volatile int written = 90;                //last value any servo got, from any thread
+
+private:
+    int _value = 90;
+};
+
+#endif
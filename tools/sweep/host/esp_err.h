@@ -0,0 +1,8 @@
+//just enough of esp_err.h to build the loop monitor on a PC
+#ifndef _HOST_ESP_ERR_H_
+#define _HOST_ESP_ERR_H_
+
+typedef int esp_err_t;
+#define ESP_OK 0
+
+#endif
@@ -0,0 +1,7 @@
+//the loop monitor is built against the IDF 5 watchdog API on a PC
+#ifndef _HOST_ESP_IDF_VERSION_H_
+#define _HOST_ESP_IDF_VERSION_H_
+
+#define ESP_IDF_VERSION_MAJOR 5
+
+#endif
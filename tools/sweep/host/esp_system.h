@@ -0,0 +1,10 @@
+//just enough of esp_system.h to build the loop monitor on a PC
+#ifndef _HOST_ESP_SYSTEM_H_
+#define _HOST_ESP_SYSTEM_H_
+
+#include "esp_err.h"
+
+typedef enum { ESP_RST_UNKNOWN, ESP_RST_POWERON, ESP_RST_SW, ESP_RST_PANIC, ESP_RST_TASK_WDT } esp_reset_reason_t;
+esp_reset_reason_t esp_reset_reason();                      //defined by the tools that run the loop monitor
+
+#endif
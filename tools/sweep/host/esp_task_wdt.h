@@ -0,0 +1,14 @@
+//the task watchdog on a PC, defined by the tools that run the loop monitor
+#ifndef _HOST_ESP_TASK_WDT_H_
+#define _HOST_ESP_TASK_WDT_H_
+
+#include "esp_err.h"
+#include "freertos/task.h"
+
+typedef struct { uint32_t timeout_ms; uint32_t idle_core_mask; bool trigger_panic; } esp_task_wdt_config_t;
+esp_err_t esp_task_wdt_init(const esp_task_wdt_config_t *config);
+esp_err_t esp_task_wdt_reconfigure(const esp_task_wdt_config_t *config);
+esp_err_t esp_task_wdt_add(TaskHandle_t task);
+esp_err_t esp_task_wdt_reset();
+
+#endif
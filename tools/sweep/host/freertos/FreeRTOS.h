@@ -0,0 +1,15 @@
+//just enough of FreeRTOS to build the loop monitor on a PC
+#ifndef _HOST_FREERTOS_H_
+#define _HOST_FREERTOS_H_
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef void *TaskHandle_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+#define pdMS_TO_TICKS(ms) (ms)                              //1 kHz tick
+#define configMAX_PRIORITIES 25
+#define pdPASS 1
+
+#endif
@@ -0,0 +1,300 @@
+//Monte Carlo sweep of the dosing settings over simulated tanks.
+//
+//Every candidate (pump amount, wait time, pH buffer, target) drives its own
+//DosingController, DoseModel, PhEstimator and SampleGate through the same set
+//of random tanks, with the hourly dose budget of the sketch, so it decides
+//from the estimate as the firmware does. The candidates are spread over all
+//cores, and the settings that are Pareto optimal for time to target versus
+//acid used are printed.
+//
+//  g++ -std=c++17 -O2 -pthread -Itools/sweep/host -Icode -o sweep
+//      tools/sweep/sweep.cpp code/DosingController.cpp code/DoseModel.cpp
+//      code/PhEstimator.cpp code/SampleGate.cpp
+//  ./sweep --candidates 400 --tanks 100 --hours 24 --csv all.csv
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DosingController.h"
+#include "DoseModel.h"
+#include "PhEstimator.h"
+#include "SampleGate.h"
+#include "Settings.h"
+
+#define MAX_ML_PER_HOUR 100.0   //as in the sketch, refills evenly over the hour like GravityPump's budget
+
+struct Options
+{
+    int candidates = 400;
+    int tanks = 100;
+    double hours = 24;
+    double step = 10;           //simulation step, s
+    unsigned seed = 1;
+    int threads = 0;            //0 = one per core
+    const char *csv = NULL;
+};
+
+struct Tank                     //one random tank, shared by all candidates
+{
+    double startPh;
+    double gain;                //pH per ml once mixed, negative
+    double mixMinutes;          //time constant of the acid mixing in
+    double driftPerHour;        //pH rise from aeration, fish, top-up water
+    double noise;               //probe noise, pH standard deviation
+    double tempSwing;           //daily temperature swing, +/- C
+    double tempError;           //pH per C the compensation leaves behind
+    unsigned seed;
+};
+
+struct Result
+{
+    SettingsData config;
+    double hoursToTarget = 0;   //mean, the whole run when never reached
+    double acidMl = 0;          //mean
+    double lowestPh = 0;        //mean of the lowest pH, overshoot
+    double reached = 0;         //part of the tanks that got to the target
+};
+
+static Tank randomTank(std::mt19937 &rng)
+{
+    std::uniform_real_distribution<double> u(0, 1);
+    Tank t;
+    t.startPh = 7.0 + u(rng) * 1.0;
+    t.gain = -(0.03 + u(rng) * 0.2);
+    t.mixMinutes = 1 + u(rng) * 9;
+    t.driftPerHour = 0.005 + u(rng) * 0.045;
+    t.noise = 0.01 + u(rng) * 0.04;
+    t.tempSwing = u(rng) * 5;
+    t.tempError = (u(rng) - 0.5) * 0.02;
+    t.seed = rng();
+    return t;
+}
+
+static SettingsData randomCandidate(std::mt19937 &rng)
+{
+    std::uniform_real_distribution<double> u(0, 1);
+    SettingsData c;
+    memset(&c, 0, sizeof(c));
+    c.flowRate = 0.6;
+    c.pumpSpeed = 160;
+    c.pumpAmount = 0.2 + u(rng) * 4.8;
+    c.pumpWait = 1 + u(rng) * 59;
+    c.phBuff = 0.02 + u(rng) * 0.28;
+    c.targetPh = 5.8 + u(rng) * 0.7;
+    return c;
+}
+
+//one controller on one tank, as loop() runs it, idle with no menu open
+static void simulate(const SettingsData &config, const Tank &tank, const Options &opt, Result &sum)
+{
+    std::mt19937 rng(tank.seed);
+    std::normal_distribution<double> noise(0, tank.noise);
+    DoseModel model;
+    DosingController dosing;
+    dosing.setDoseModel(&model);
+    PhEstimator estimator;
+    estimator.setDoseModel(&model);
+    SampleGate gate;
+
+    const double end = opt.hours * 3600;
+    double ph = tank.startPh;
+    double unmixed = 0;         //ml in the tank but not mixed in yet
+    double acid = 0;
+    double budget = MAX_ML_PER_HOUR;
+    double lowest = ph;
+    double reachedAt = -1;
+    unsigned long pumpUntil = 0;
+    for(double t = 0; t < end; t += opt.step) {
+        unsigned long now = (unsigned long)(t * 1000);
+        budget = std::min(MAX_ML_PER_HOUR, budget + MAX_ML_PER_HOUR * opt.step / 3600);
+        gate.update(now, now < pumpUntil);
+        if(dosing.due(now, true, config) && gate.accept(now)) {
+            double temperature = 25 + tank.tempSwing * sin(t / 86400 * 2 * M_PI);
+            float reading = ph + noise(rng) + tank.tempError * (temperature - 25);
+            estimator.update(now, reading, temperature);
+            float ml = dosing.measured(now, estimator.ph(), reading, config);
+            ml = std::min<double>(ml, budget < 0.01 ? 0 : budget);
+            if(ml > 0) {
+                unsigned long runTime = (unsigned long)(1000 * ml / config.flowRate);
+                budget -= ml;
+                unmixed += ml;
+                acid += ml;
+                pumpUntil = now + runTime;
+                dosing.doseStarted(ml, reading, runTime);
+                estimator.dose(ml);
+            }
+            dosing.reachedTarget();
+        }
+        double mixed = unmixed * std::min(1.0, opt.step / (tank.mixMinutes * 60));
+        unmixed -= mixed;
+        ph += tank.gain * mixed + tank.driftPerHour * opt.step / 3600;
+        lowest = std::min(lowest, ph);
+        if(reachedAt < 0 && ph <= config.targetPh + config.phBuff) {
+            reachedAt = t;
+        }
+    }
+    sum.hoursToTarget += (reachedAt < 0 ? end : reachedAt) / 3600;
+    sum.acidMl += acid;
+    sum.lowestPh += lowest;
+    sum.reached += reachedAt >= 0;
+}
+
+//each worker drains its own deque from the back and steals from the front of the others
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(int workers) : _queues(workers) {}
+
+    template <class Job> void run(size_t jobs, Job job)
+    {
+        for(size_t i = 0; i < jobs; i++) {
+            _queues[i % _queues.size()].jobs.push_back(i);
+        }
+        std::vector<std::thread> threads;
+        for(size_t w = 0; w < _queues.size(); w++) {
+            threads.emplace_back([this, w, &job]() {
+                size_t index;
+                while(take(w, index)) {
+                    job(index);
+                }
+            });
+        }
+        for(auto &thread : threads) {
+            thread.join();
+        }
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<size_t> jobs;
+    };
+
+    bool take(size_t worker, size_t &index)
+    {
+        {
+            std::lock_guard<std::mutex> guard(_queues[worker].lock);
+            if(!_queues[worker].jobs.empty()) {
+                index = _queues[worker].jobs.back();
+                _queues[worker].jobs.pop_back();
+                return true;
+            }
+        }
+        for(size_t i = 1; i < _queues.size(); i++) {
+            Queue &victim = _queues[(worker + i) % _queues.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if(!victim.jobs.empty()) {
+                index = victim.jobs.front();
+                victim.jobs.pop_front();
+                return true;
+            }
+        }
+        return false;           //jobs are never added while running, so empty everywhere means done
+    }
+
+    std::vector<Queue> _queues;
+};
+
+static bool dominates(const Result &a, const Result &b)
+{
+    return a.hoursToTarget <= b.hoursToTarget && a.acidMl <= b.acidMl
+        && (a.hoursToTarget < b.hoursToTarget || a.acidMl < b.acidMl);
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: sweep [--candidates N] [--tanks N] [--hours H] [--step S] [--seed N] [--threads N] [--csv FILE]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    Options opt;
+    for(int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if(i + 1 >= argc) usage();
+        const char *value = argv[++i];
+        if(arg == "--candidates") opt.candidates = atoi(value);
+        else if(arg == "--tanks") opt.tanks = atoi(value);
+        else if(arg == "--hours") opt.hours = atof(value);
+        else if(arg == "--step") opt.step = atof(value);
+        else if(arg == "--seed") opt.seed = atoi(value);
+        else if(arg == "--threads") opt.threads = atoi(value);
+        else if(arg == "--csv") opt.csv = value;
+        else usage();
+    }
+    if(opt.candidates < 1 || opt.tanks < 1 || opt.hours <= 0 || opt.step <= 0) usage();
+    int workers = opt.threads > 0 ? opt.threads : std::max(1u, std::thread::hardware_concurrency());
+
+    std::mt19937 rng(opt.seed);
+    std::vector<Tank> tanks;
+    for(int i = 0; i < opt.tanks; i++) {
+        tanks.push_back(randomTank(rng));
+    }
+    std::vector<Result> results(opt.candidates);
+    for(auto &result : results) {
+        result.config = randomCandidate(rng);
+    }
+
+    std::atomic<int> done(0);
+    WorkStealingPool pool(workers);
+    pool.run(results.size(), [&](size_t index) {
+        Result &result = results[index];        //each job owns its slot
+        for(const Tank &tank : tanks) {
+            simulate(result.config, tank, opt, result);
+        }
+        result.hoursToTarget /= tanks.size();
+        result.acidMl /= tanks.size();
+        result.lowestPh /= tanks.size();
+        result.reached /= tanks.size();
+        int n = ++done;
+        if(n % 50 == 0) {
+            fprintf(stderr, "%d/%d\n", n, opt.candidates);
+        }
+    });
+
+    std::vector<Result> front;
+    for(const Result &a : results) {
+        bool dominated = false;
+        for(const Result &b : results) {
+            dominated = dominated || dominates(b, a);
+        }
+        if(!dominated) {
+            front.push_back(a);
+        }
+    }
+    std::sort(front.begin(), front.end(), [](const Result &a, const Result &b) { return a.acidMl < b.acidMl; });
+
+    printf("%d candidates x %d tanks, %.0f h each, %d threads\n", opt.candidates, opt.tanks, opt.hours, workers);
+    printf("Pareto front, time to target vs acid used:\n");
+    printf("%8s %8s %8s %8s | %10s %8s %8s %8s\n", "amount", "wait", "buffer", "target", "to target", "acid ml", "lowest", "reached");
+    for(const Result &r : front) {
+        printf("%8.2f %8.1f %8.2f %8.2f | %9.2fh %8.1f %8.2f %7.0f%%\n", r.config.pumpAmount, r.config.pumpWait,
+               r.config.phBuff, r.config.targetPh, r.hoursToTarget, r.acidMl, r.lowestPh, r.reached * 100);
+    }
+
+    if(opt.csv != NULL) {
+        FILE *f = fopen(opt.csv, "w");
+        if(f == NULL) {
+            perror(opt.csv);
+            return 1;
+        }
+        fprintf(f, "pump_amount,pump_wait,ph_buff,target_ph,hours_to_target,acid_ml,lowest_ph,reached\n");
+        for(const Result &r : results) {
+            fprintf(f, "%.3f,%.2f,%.3f,%.3f,%.3f,%.2f,%.3f,%.3f\n", r.config.pumpAmount, r.config.pumpWait,
+                    r.config.phBuff, r.config.targetPh, r.hoursToTarget, r.acidMl, r.lowestPh, r.reached);
+        }
+        fclose(f);
+    }
+    return 0;
+}
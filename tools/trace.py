@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""Turn the TRACE dump of a controller into Chrome trace JSON.
+
+  python3 tools/trace.py record /dev/ttyUSB0 trace.json [--save trace.txt]
+  python3 tools/trace.py convert trace.txt trace.json
+
+Needs TRACE_ENABLE 1, in code/Trace.h or as -DTRACE_ENABLE=1. `record`
+sends TRACE and reads the dump, `convert` does the same for a dump copied
+from a serial monitor. Open the JSON in chrome://tracing or
+https://ui.perfetto.dev: loop stages, pump runs and menu events are one
+row each. Spans whose begin was overwritten in the ring are dropped, spans
+still open at the dump end with the last event. Needs pyserial to record.
+"""
+
+import argparse
+import json
+import sys
+import time
+
+BAUD = 115200
+TRACKS = ["loop", "pump", "menu"]
+
+
+def parse(lines):
+    """Events from the dump lines as (us, phase, track, name, arg), time unwrapped.
+
+    Writers on other tasks can land a few us out of order, so only a step
+    back of more than half the 32 bit range counts as micros() wrapping."""
+    events = []
+    inside = False
+    offset = 0
+    last = None
+    for line in lines:
+        line = line.strip()
+        if line.startswith("TRACE ERROR"):
+            raise RuntimeError("tracing is not compiled in, set TRACE_ENABLE 1 in code/Trace.h or build with -DTRACE_ENABLE=1")
+        if line.startswith("TRACE END"):
+            break
+        if line.startswith("TRACE "):
+            inside = True
+            continue
+        if not inside or not line:
+            continue
+        fields = line.split()
+        if len(fields) != 5:
+            continue
+        raw = int(fields[0])
+        if last is not None and last - raw > 1 << 31:
+            offset += 1 << 32           # micros() wrapped
+        elif last is not None and raw - last > 1 << 31:
+            offset -= 1 << 32           # a late writer's stamp from just before the wrap
+        last = raw
+        us = raw + offset
+        events.append((us, fields[1], fields[2], fields[3], int(fields[4])))
+    return events
+
+
+def chrome(events):
+    out = []
+    for tid, track in enumerate(TRACKS):
+        out.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": tid, "args": {"name": track}})
+    if not events:
+        return {"traceEvents": out, "displayTimeUnit": "ms"}
+    start = events[0][0]
+    stacks = {track: [] for track in TRACKS}
+    dropped = 0
+    for us, phase, track, name, arg in events:
+        stack = stacks.setdefault(track, [])
+        tid = TRACKS.index(track) if track in TRACKS else len(TRACKS)
+        event = {"name": name, "ph": phase, "pid": 1, "tid": tid, "ts": us - start}
+        if phase == "B":
+            stack.append(name)
+        elif phase == "E":
+            if name not in stack:
+                dropped += 1            # begun before the oldest event in the ring
+                continue
+            while stack.pop() != name:
+                pass
+        elif phase == "i":
+            event["s"] = "t"
+            event["args"] = {"arg": arg}
+        out.append(event)
+    end = events[-1][0] - start
+    for track, stack in stacks.items():
+        tid = TRACKS.index(track) if track in TRACKS else len(TRACKS)
+        for name in reversed(stack):
+            out.append({"name": name, "ph": "E", "pid": 1, "tid": tid, "ts": end})
+    if dropped:
+        print("%d span ends without a begin dropped" % dropped, file=sys.stderr)
+    return {"traceEvents": out, "displayTimeUnit": "ms"}
+
+
+def read_port(path, timeout):
+    import serial
+    port = serial.Serial(path, BAUD, timeout=0.5)
+    port.dtr = False
+    port.rts = False
+    time.sleep(0.1)
+    port.reset_input_buffer()
+    port.write(b"TRACE\n")
+    lines = []
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        line = port.readline().decode("ascii", "replace")
+        if line:
+            lines.append(line)
+            if line.startswith("TRACE END") or line.startswith("TRACE ERROR"):
+                return lines
+    raise RuntimeError("no TRACE END from the controller within %d s" % timeout)
+
+
+def write(events, path):
+    with open(path, "w") as f:
+        json.dump(chrome(events), f)
+    span = (events[-1][0] - events[0][0]) / 1e6 if events else 0
+    print("%d events over %.3f s to %s" % (len(events), span, path))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command", required=True)
+    record = sub.add_parser("record", help="dump a controller's trace")
+    record.add_argument("port")
+    record.add_argument("json")
+    record.add_argument("--save", help="keep the dump text")
+    record.add_argument("--timeout", type=int, default=10)
+    convert = sub.add_parser("convert", help="convert a dump kept as text")
+    convert.add_argument("text")
+    convert.add_argument("json")
+    args = parser.parse_args()
+
+    try:
+        if args.command == "record":
+            lines = read_port(args.port, args.timeout)
+            if args.save:
+                with open(args.save, "w") as f:
+                    f.writelines(lines)
+        else:
+            with open(args.text) as f:
+                lines = f.readlines()
+        write(parse(lines), args.json)
+    except RuntimeError as error:
+        print(error, file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())